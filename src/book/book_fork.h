@@ -0,0 +1,332 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef book_fork_h
+#define book_fork_h
+
+#include "order_book.h"
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief fork of an order book, for asking what would happen if an order
+///        were sent.  The fork matches with the book's own code, in a book
+///        of its own which holds only the price levels of its parent that
+///        the fork's orders reach, copied as they are first reached, with
+///        the parent's pegged orders and untriggered stops.  So a fork
+///        costs little to make, a speculative add or cancel costs about as
+///        much as in the parent plus the copy of the levels it reaches, and
+///        the parent and its orders are never changed.  A copy of a fork is
+///        a fork of the fork.
+///
+///        Orders match as in the parent: by its MatchPolicy, with its
+///        self-trade prevention, against its pegged orders, and triggering
+///        its stops.  The orders of the fork rest behind those of the
+///        parent at the same price.  An auction in the parent plays no
+///        part, and time does not advance in the fork.
+///
+///        The fork holds the location of its parent's orders, so it must
+///        not be used once the parent changes.
+template <class OrderPtr = Order*, class MatchPolicy = FifoMatch>
+class BookFork {
+public:
+  typedef OrderBook<OrderPtr, MatchPolicy> ParentBook;
+  typedef typename ParentBook::Tracker Tracker;
+
+  /// @brief a speculative fill in the fork
+  struct Fill {
+    OrderPtr inbound_order;
+    OrderPtr resting_order;
+    Price price;
+    Quantity qty;
+  };
+  typedef std::vector<Fill> Fills;
+
+  /// @brief construct a fork of a book
+  explicit BookFork(const ParentBook& parent);
+
+  /// @brief add an order to the fork, matching it against the orders of
+  ///        the parent and the fork.  What is left rests in the fork, as it
+  ///        would in the parent.
+  /// @param order the order, which is not changed
+  /// @param conditions special conditions on the order
+  /// @return true if the add resulted in a fill
+  bool add(const OrderPtr& order, OrderConditions conditions = 0);
+
+  /// @brief cancel an order of the parent or the fork, in the fork only
+  /// @return true if the order was open in the fork
+  bool cancel(const OrderPtr& order);
+
+  /// @brief get the open quantity of an order in the fork
+  /// @return the open quantity, or 0 if the order is not open in the fork
+  Quantity open_qty(const OrderPtr& order) const;
+
+  /// @brief get the best bid price in the fork, or 0 if none
+  Price best_bid() const;
+
+  /// @brief get the best ask price in the fork, or 0 if none
+  Price best_ask() const;
+
+  /// @brief access the fills of the fork, in the order they happened
+  const Fills& fills() const;
+
+  /// @brief access the parent book
+  const ParentBook& parent() const;
+
+private:
+  typedef typename ParentBook::Bids Bids;
+  typedef typename ParentBook::Asks Asks;
+  typedef typename ParentBook::TypedCallback TypedCallback;
+
+  /// @brief the book of the fork.  Before an order matches, the levels of
+  ///        the parent it reaches are copied in, so the book's own
+  ///        matching sees them.
+  class ForkBook : public ParentBook {
+  public:
+    explicit ForkBook(const ParentBook& parent);
+
+    /// @brief access the parent book
+    const ParentBook& parent() const { return *parent_; }
+
+    using ParentBook::best_bid;
+    using ParentBook::best_ask;
+
+    /// @brief is the level of an order's price copied from the parent?
+    bool copied(const OrderPtr& order) const;
+
+    /// @brief copy the parent's levels of an order's side, up to its price
+    void copy_levels(const OrderPtr& order);
+
+    /// @brief record the fills and cancels of the fork
+    virtual void perform_callback(TypedCallback& cb);
+
+    Fills fills_;
+    bool cancelled_;
+
+  protected:
+    virtual bool match_order(Tracker& inbound_order,
+                             const Price& inbound_price,
+                             Bids& bids);
+    virtual bool match_order(Tracker& inbound_order,
+                             const Price& inbound_price,
+                             Asks& asks);
+
+  private:
+    const ParentBook* parent_;
+    // The first level of each side of the parent not yet copied
+    typename Bids::const_iterator bids_copied_;
+    typename Asks::const_iterator asks_copied_;
+
+    /// @brief copy the levels of a side of the parent at or better than a
+    ///        price, and the level after them, so the fork's best price
+    ///        stays right as the levels it reached are taken
+    template <class Side>
+    void copy_side(const Side& side,
+                   typename Side::const_iterator& copied,
+                   Price price);
+
+    /// @brief is the level of a price copied from a side of the parent?
+    template <class Side>
+    static bool side_copied(const Side& side,
+                            typename Side::const_iterator copied,
+                            Price price);
+  };
+
+  ForkBook book_;
+};
+
+template <class OrderPtr, class MatchPolicy>
+BookFork<OrderPtr, MatchPolicy>::BookFork(const ParentBook& parent)
+: book_(parent)
+{
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+BookFork<OrderPtr, MatchPolicy>::add(const OrderPtr& order,
+                                     OrderConditions conditions)
+{
+  const bool matched = book_.add(order, conditions);
+  book_.perform_callbacks();
+  return matched;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+BookFork<OrderPtr, MatchPolicy>::cancel(const OrderPtr& order)
+{
+  book_.copy_levels(order);
+  book_.cancelled_ = false;
+  book_.cancel(order);
+  book_.perform_callbacks();
+  return book_.cancelled_;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline Quantity
+BookFork<OrderPtr, MatchPolicy>::open_qty(const OrderPtr& order) const
+{
+  const Tracker* tracker = book_.copied(order) ?
+      book_.find_resting(order) : book_.parent().find_resting(order);
+  return tracker ? tracker->open_qty() : 0;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline Price
+BookFork<OrderPtr, MatchPolicy>::best_bid() const
+{
+  return book_.best_bid();
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline Price
+BookFork<OrderPtr, MatchPolicy>::best_ask() const
+{
+  return book_.best_ask();
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline const typename BookFork<OrderPtr, MatchPolicy>::Fills&
+BookFork<OrderPtr, MatchPolicy>::fills() const
+{
+  return book_.fills_;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline const typename BookFork<OrderPtr, MatchPolicy>::ParentBook&
+BookFork<OrderPtr, MatchPolicy>::parent() const
+{
+  return book_.parent();
+}
+
+template <class OrderPtr, class MatchPolicy>
+BookFork<OrderPtr, MatchPolicy>::ForkBook::ForkBook(const ParentBook& parent)
+: cancelled_(false),
+  parent_(&parent),
+  bids_copied_(parent.bids().begin()),
+  asks_copied_(parent.asks().begin())
+{
+  this->copy_held(parent);
+  // Pegged orders are priced from the best bid and offer
+  if (bids_copied_ != parent.bids().end()) {
+    copy_side(parent.bids(), bids_copied_, bids_copied_->first);
+  }
+  if (asks_copied_ != parent.asks().end()) {
+    copy_side(parent.asks(), asks_copied_, asks_copied_->first);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+BookFork<OrderPtr, MatchPolicy>::ForkBook::copied(const OrderPtr& order) const
+{
+  // Pegged orders are all copied
+  if (order->peg_type() != peg_none) {
+    return true;
+  }
+  const Price price = this->sort_price(order);
+  if (order->is_buy()) {
+    return side_copied(parent_->bids(), bids_copied_, price);
+  } else {
+    return side_copied(parent_->asks(), asks_copied_, price);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+BookFork<OrderPtr, MatchPolicy>::ForkBook::copy_levels(const OrderPtr& order)
+{
+  if (order->peg_type() != peg_none) {
+    return;
+  }
+  const Price price = this->sort_price(order);
+  if (order->is_buy()) {
+    copy_side(parent_->bids(), bids_copied_, price);
+  } else {
+    copy_side(parent_->asks(), asks_copied_, price);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+BookFork<OrderPtr, MatchPolicy>::ForkBook::perform_callback(TypedCallback& cb)
+{
+  if (cb.type == TypedCallback::cb_order_fill) {
+    Fill fill;
+    fill.inbound_order = cb.order;
+    fill.resting_order = cb.matched_order;
+    fill.price = cb.fill_price;
+    fill.qty = cb.fill_qty;
+    fills_.push_back(fill);
+  } else if (cb.type == TypedCallback::cb_order_cancel) {
+    cancelled_ = true;
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+BookFork<OrderPtr, MatchPolicy>::ForkBook::match_order(
+  Tracker& inbound_order,
+  const Price& inbound_price,
+  Bids& bids)
+{
+  // The inbound order matches the bids it reaches, and may rest among
+  // the asks at its price
+  copy_side(parent_->bids(), bids_copied_, inbound_price);
+  copy_side(parent_->asks(), asks_copied_, inbound_price);
+  return ParentBook::match_order(inbound_order, inbound_price, bids);
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+BookFork<OrderPtr, MatchPolicy>::ForkBook::match_order(
+  Tracker& inbound_order,
+  const Price& inbound_price,
+  Asks& asks)
+{
+  copy_side(parent_->asks(), asks_copied_, inbound_price);
+  copy_side(parent_->bids(), bids_copied_, inbound_price);
+  return ParentBook::match_order(inbound_order, inbound_price, asks);
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline void
+BookFork<OrderPtr, MatchPolicy>::ForkBook::copy_side(
+  const Side& side,
+  typename Side::const_iterator& copied,
+  Price price)
+{
+  // If a level past the price is copied, so is every level up to it
+  if (copied != side.begin()) {
+    typename Side::const_iterator last = copied;
+    --last;
+    if (side.key_comp()(price, last->first)) {
+      return;
+    }
+  }
+  // Copy whole levels, so the orders of the fork rest behind the parent's
+  bool past_price = false;
+  while (copied != side.end() && !past_price) {
+    const Price level_price = copied->first;
+    past_price = side.key_comp()(price, level_price);
+    for (; copied != side.end() && copied->first == level_price; ++copied) {
+      this->copy_resting(level_price, copied->second);
+    }
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline bool
+BookFork<OrderPtr, MatchPolicy>::ForkBook::side_copied(
+  const Side& side,
+  typename Side::const_iterator copied,
+  Price price)
+{
+  return copied == side.end() || side.key_comp()(price, copied->first);
+}
+
+} }
+
+#endif
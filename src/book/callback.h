@@ -5,11 +5,13 @@
 #define callback_h
 
 #include "order.h"
+#include "match_policy.h"
+#include "price_ladder.h"
 #include "types.h"
 
 namespace liquibook { namespace book {
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy = FifoMatch>
 class OrderBook;
 
 // Callback events
@@ -36,6 +38,32 @@ class OrderBook;
 //     - depth/bbo ?
 //   Order replace reject
 //     - order replace reject
+//   Stop order trigger
+//     - order trigger
+//     - fill (2) and/or quote (if not complete)
+//     - depth/bbo ?
+//   Iceberg order rest, fill or refresh
+//     - order display
+//     - depth/bbo ?
+//   Mass cancel
+//     - mass cancel
+//     - depth/bbo ?
+//   Mass quote
+//     - mass quote (the accepted replaces)
+//     - replace reject (for each rejected)
+//     - fill (2) and/or cancel
+//     - depth/bbo ?
+//   Pegged orders moved by a change in the best bid or offer
+//     - pegged depth (if enabled)
+//   Any order event during an auction
+//     - uncross update
+
+/// @brief the pegged orders of one side and peg type, at their pegged price
+struct PeggedDepth {
+  Price price;          // the pegged price, or 0 if not priced
+  uint32_t order_count;
+  Quantity qty;
+};
 
 /// @brief notification from OrderBook of an event
 template <class OrderPtr = Order*>
@@ -52,8 +80,14 @@ public:
     cb_order_cancel_reject,
     cb_order_replace,
     cb_order_replace_reject,
+    cb_order_trigger,
+    cb_order_display,
+    cb_mass_cancel,
+    cb_mass_quote,
+    cb_pegged_depth,
     cb_depth_update,
-    cb_bbo_update
+    cb_bbo_update,
+    cb_uncross_update
   };
 
   Callback();
@@ -87,6 +121,38 @@ public:
   static Callback<OrderPtr> replace_reject(const OrderPtr& order,
                                            const char* reason,
                                            const TransId& trans_id);
+  /// @brief create a new stop order trigger callback
+  static Callback<OrderPtr> trigger(const OrderPtr& order,
+                                    const TransId& trans_id);
+  /// @brief create a new iceberg order display callback
+  static Callback<OrderPtr> display(const OrderPtr& order,
+                                    const Quantity& visible_qty,
+                                    const TransId& trans_id);
+  /// @brief create a new mass cancel callback
+  /// @param cancel_begin the index of the first cancelled order in the book's
+  ///        mass cancelled orders
+  /// @param cancel_count the number of cancelled orders
+  static Callback<OrderPtr> mass_cancel(uint32_t cancel_begin,
+                                        uint32_t cancel_count,
+                                        const TransId& trans_id);
+  /// @brief create a new mass quote callback
+  /// @param quote_begin the index of the first replace in the book's mass
+  ///        quoted replaces
+  /// @param quote_count the number of replaces
+  static Callback<OrderPtr> mass_quote(uint32_t quote_begin,
+                                       uint32_t quote_count,
+                                       const TransId& trans_id);
+  /// @brief create a new pegged depth callback
+  /// @param is_buy the side of the pegged orders
+  /// @param prior the pegged orders as last published
+  /// @param pegged the pegged orders now
+  static Callback<OrderPtr> pegged_depth(bool is_buy,
+                                         const PeggedDepth& prior,
+                                         const PeggedDepth& pegged,
+                                         const TransId& trans_id);
+  /// @brief create a new indicative uncross update callback
+  static Callback<OrderPtr> uncross_update(const IndicativeUncross& uncross,
+                                           const TransId& trans_id);
 
   CbType type;
   OrderPtr order;
@@ -104,6 +170,28 @@ public:
       Quantity new_order_qty;
       Price new_price;
     };
+    struct {
+      Quantity visible_qty;
+    };
+    struct {
+      uint32_t cancel_begin;
+      uint32_t cancel_count;
+    };
+    struct {
+      uint32_t quote_begin;
+      uint32_t quote_count;
+    };
+    struct {
+      PeggedDepth prior_pegged;
+      PeggedDepth pegged;
+      bool pegged_is_buy;
+    };
+    struct {
+      Price uncross_price;
+      Quantity uncross_qty;
+      Quantity buy_surplus;
+      Quantity sell_surplus;
+    };
     const char* reject_reason;
   };
 };
@@ -111,6 +199,8 @@ public:
 template <class OrderPtr>
 Callback<OrderPtr>::Callback()
 : type(cb_unknown),
+  order(),
+  matched_order(),
   trans_id(0),
   fill_qty(0),
   fill_price(0)
@@ -217,6 +307,91 @@ Callback<OrderPtr> Callback<OrderPtr>::replace_reject(
   return result;
 }
 
+template <class OrderPtr>
+Callback<OrderPtr> Callback<OrderPtr>::trigger(
+  const OrderPtr& order,
+  const TransId& trans_id)
+{
+  Callback<OrderPtr> result;
+  result.type = cb_order_trigger;
+  result.order = order;
+  result.trans_id = trans_id;
+  return result;
+}
+
+template <class OrderPtr>
+Callback<OrderPtr> Callback<OrderPtr>::display(
+  const OrderPtr& order,
+  const Quantity& visible_qty,
+  const TransId& trans_id)
+{
+  Callback<OrderPtr> result;
+  result.type = cb_order_display;
+  result.order = order;
+  result.visible_qty = visible_qty;
+  result.trans_id = trans_id;
+  return result;
+}
+
+template <class OrderPtr>
+Callback<OrderPtr> Callback<OrderPtr>::mass_cancel(
+  uint32_t cancel_begin,
+  uint32_t cancel_count,
+  const TransId& trans_id)
+{
+  Callback<OrderPtr> result;
+  result.type = cb_mass_cancel;
+  result.cancel_begin = cancel_begin;
+  result.cancel_count = cancel_count;
+  result.trans_id = trans_id;
+  return result;
+}
+
+template <class OrderPtr>
+Callback<OrderPtr> Callback<OrderPtr>::mass_quote(
+  uint32_t quote_begin,
+  uint32_t quote_count,
+  const TransId& trans_id)
+{
+  Callback<OrderPtr> result;
+  result.type = cb_mass_quote;
+  result.quote_begin = quote_begin;
+  result.quote_count = quote_count;
+  result.trans_id = trans_id;
+  return result;
+}
+
+template <class OrderPtr>
+Callback<OrderPtr> Callback<OrderPtr>::pegged_depth(
+  bool is_buy,
+  const PeggedDepth& prior,
+  const PeggedDepth& pegged,
+  const TransId& trans_id)
+{
+  Callback<OrderPtr> result;
+  result.type = cb_pegged_depth;
+  result.prior_pegged = prior;
+  result.pegged = pegged;
+  result.pegged_is_buy = is_buy;
+  result.trans_id = trans_id;
+  return result;
+}
+
+template <class OrderPtr>
+Callback<OrderPtr> Callback<OrderPtr>::uncross_update(
+  const IndicativeUncross& uncross,
+  const TransId& trans_id)
+{
+  Callback<OrderPtr> result;
+  result.type = cb_uncross_update;
+  result.uncross_price = uncross.price;
+  result.uncross_qty = uncross.matched_qty;
+  result.buy_surplus = uncross.buy_surplus;
+  result.sell_surplus = uncross.sell_surplus;
+  result.trans_id = trans_id;
+  return result;
+}
+
 } }
 
 #endif
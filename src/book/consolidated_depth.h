@@ -0,0 +1,336 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef consolidated_depth_h
+#define consolidated_depth_h
+
+#include "depth.h"
+#include "types.h"
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief depth of one instrument merged across the depths of many venues.
+///        Each venue's levels are kept as last seen, and an update visits
+///        only the levels stamped since, moving their difference into the
+///        merged totals by price.  The best levels of the totals are then
+///        published as levels of this depth, stamped with its own change
+///        IDs when they differ from before.  A price among the best SIZE of
+///        the merged depth is among the best SIZE of every venue which has
+///        it, so the venues' visible levels are enough.
+template <int SIZE=5>
+class ConsolidatedDepth {
+public:
+  typedef Depth<SIZE> VenueDepth;
+
+  /// @brief construct with no venues
+  ConsolidatedDepth();
+
+  /// @brief add the depth of a venue.  The depth must outlive this.
+  /// @return the index of the venue, for update(venue)
+  uint32_t add_venue(const VenueDepth& depth);
+
+  /// @brief get the number of venues
+  uint32_t venue_count() const;
+
+  /// @brief merge the changes of every venue since the last update.  Venues
+  ///        with no new change ID are skipped.
+  /// @return true if the merged levels changed
+  bool update();
+
+  /// @brief merge the changes of one venue since the last update
+  /// @param venue the index of the venue
+  /// @return true if the merged levels changed
+  bool update(uint32_t venue);
+
+  /// @brief get the first bid level
+  const DepthLevel* bids() const;
+  /// @brief get the last bid level
+  const DepthLevel* last_bid_level() const;
+  /// @brief get the first ask level
+  const DepthLevel* asks() const;
+  /// @brief get the last ask level
+  const DepthLevel* last_ask_level() const;
+  /// @brief get one past the last ask level
+  const DepthLevel* end() const;
+
+  /// @brief has the merged depth changed since the last publish
+  bool changed() const;
+
+  /// @brief what was the last change?
+  ChangeId last_change() const;
+
+  /// @brief what was the last published change?
+  ChangeId last_published_change() const;
+
+  /// @brief note the id of the last published change
+  void published();
+
+private:
+  struct SeenLevel {
+    SeenLevel() : price(INVALID_LEVEL_PRICE), order_count(0), qty(0) {}
+    Price price;
+    uint32_t order_count;
+    Quantity qty;
+  };
+  struct Venue {
+    Venue() : depth(NULL), seen_change(0) {}
+    const VenueDepth* depth;
+    ChangeId seen_change;
+    SeenLevel levels[SIZE*2];
+  };
+  struct LevelTotal {
+    LevelTotal() : order_count(0), qty(0) {}
+    uint32_t order_count;
+    Quantity qty;
+  };
+  typedef std::vector<Venue> Venues;
+  typedef std::map<Price, LevelTotal, std::greater<Price> > BidTotals;
+  typedef std::map<Price, LevelTotal, std::less<Price> > AskTotals;
+
+  DepthLevel levels_[SIZE*2];
+  Venues venues_;
+  BidTotals bid_totals_;
+  AskTotals ask_totals_;
+  ChangeId last_change_;
+  ChangeId last_published_change_;
+
+  /// @brief merge a venue's changed levels into the totals
+  /// @return true if the totals changed
+  bool merge_venue(Venue& venue);
+
+  /// @brief add or remove a venue level's orders from the totals
+  template <class Totals>
+  void change_total(Totals& totals, const SeenLevel& level, bool add);
+
+  /// @brief publish the best totals of a side as its levels
+  template <class Totals>
+  void publish_side(const Totals& totals, DepthLevel* level);
+};
+
+template <int SIZE>
+ConsolidatedDepth<SIZE>::ConsolidatedDepth()
+: last_change_(0),
+  last_published_change_(0)
+{
+  for (int index = 0; index < SIZE * 2; ++index) {
+    levels_[index].init(INVALID_LEVEL_PRICE, false);
+    levels_[index].last_change(0);
+  }
+}
+
+template <int SIZE>
+inline uint32_t
+ConsolidatedDepth<SIZE>::add_venue(const VenueDepth& depth)
+{
+  venues_.push_back(Venue());
+  venues_.back().depth = &depth;
+  // Take in the levels the venue already has
+  update(venues_.size() - 1);
+  return venues_.size() - 1;
+}
+
+template <int SIZE>
+inline uint32_t
+ConsolidatedDepth<SIZE>::venue_count() const
+{
+  return venues_.size();
+}
+
+template <int SIZE>
+inline bool
+ConsolidatedDepth<SIZE>::update()
+{
+  bool merged = false;
+  for (typename Venues::iterator venue = venues_.begin();
+       venue != venues_.end(); ++venue) {
+    if (merge_venue(*venue)) {
+      merged = true;
+    }
+  }
+  if (!merged) {
+    return false;
+  }
+  const ChangeId prior_change = last_change_;
+  publish_side(bid_totals_, levels_);
+  publish_side(ask_totals_, levels_ + SIZE);
+  return last_change_ != prior_change;
+}
+
+template <int SIZE>
+inline bool
+ConsolidatedDepth<SIZE>::update(uint32_t venue)
+{
+  if (!merge_venue(venues_[venue])) {
+    return false;
+  }
+  const ChangeId prior_change = last_change_;
+  publish_side(bid_totals_, levels_);
+  publish_side(ask_totals_, levels_ + SIZE);
+  return last_change_ != prior_change;
+}
+
+template <int SIZE>
+inline const DepthLevel*
+ConsolidatedDepth<SIZE>::bids() const
+{
+  return levels_;
+}
+
+template <int SIZE>
+inline const DepthLevel*
+ConsolidatedDepth<SIZE>::last_bid_level() const
+{
+  return levels_ + (SIZE - 1);
+}
+
+template <int SIZE>
+inline const DepthLevel*
+ConsolidatedDepth<SIZE>::asks() const
+{
+  return levels_ + SIZE;
+}
+
+template <int SIZE>
+inline const DepthLevel*
+ConsolidatedDepth<SIZE>::last_ask_level() const
+{
+  return levels_ + (SIZE * 2 - 1);
+}
+
+template <int SIZE>
+inline const DepthLevel*
+ConsolidatedDepth<SIZE>::end() const
+{
+  return levels_ + (SIZE * 2);
+}
+
+template <int SIZE>
+inline bool
+ConsolidatedDepth<SIZE>::changed() const
+{
+  return last_change_ > last_published_change_;
+}
+
+template <int SIZE>
+inline ChangeId
+ConsolidatedDepth<SIZE>::last_change() const
+{
+  return last_change_;
+}
+
+template <int SIZE>
+inline ChangeId
+ConsolidatedDepth<SIZE>::last_published_change() const
+{
+  return last_published_change_;
+}
+
+template <int SIZE>
+inline void
+ConsolidatedDepth<SIZE>::published()
+{
+  last_published_change_ = last_change_;
+}
+
+template <int SIZE>
+inline bool
+ConsolidatedDepth<SIZE>::merge_venue(Venue& venue)
+{
+  const ChangeId venue_change = venue.depth->last_change();
+  if (venue_change == venue.seen_change) {
+    return false;
+  }
+  bool merged = false;
+  // Bid and ask levels are adjacent
+  const DepthLevel* level = venue.depth->bids();
+  for (int index = 0; index < SIZE * 2; ++index, ++level) {
+    if (!level->changed_since(venue.seen_change)) {
+      continue;
+    }
+    SeenLevel& seen = venue.levels[index];
+    if (seen.price == level->price() &&
+        seen.order_count == level->order_count() &&
+        seen.qty == level->aggregate_qty()) {
+      continue;
+    }
+    const bool is_bid = index < SIZE;
+    if (seen.price != INVALID_LEVEL_PRICE) {
+      if (is_bid) {
+        change_total(bid_totals_, seen, false);
+      } else {
+        change_total(ask_totals_, seen, false);
+      }
+    }
+    seen.price = level->price();
+    seen.order_count = level->order_count();
+    seen.qty = level->aggregate_qty();
+    if (seen.price != INVALID_LEVEL_PRICE) {
+      if (is_bid) {
+        change_total(bid_totals_, seen, true);
+      } else {
+        change_total(ask_totals_, seen, true);
+      }
+    }
+    merged = true;
+  }
+  venue.seen_change = venue_change;
+  return merged;
+}
+
+template <int SIZE>
+template <class Totals>
+inline void
+ConsolidatedDepth<SIZE>::change_total(Totals& totals,
+                                      const SeenLevel& level,
+                                      bool add)
+{
+  typename Totals::iterator total = totals.find(level.price);
+  if (total == totals.end()) {
+    total = totals.insert(std::make_pair(level.price, LevelTotal())).first;
+  }
+  if (add) {
+    total->second.order_count += level.order_count;
+    total->second.qty += level.qty;
+  } else {
+    total->second.order_count -= level.order_count;
+    total->second.qty -= level.qty;
+    // Remove a price no venue has
+    if (!total->second.order_count) {
+      totals.erase(total);
+    }
+  }
+}
+
+template <int SIZE>
+template <class Totals>
+inline void
+ConsolidatedDepth<SIZE>::publish_side(const Totals& totals, DepthLevel* level)
+{
+  // Stamp every level changed by this update with the same change ID
+  const ChangeId change = last_change_ + 1;
+  typename Totals::const_iterator total = totals.begin();
+  for (int index = 0; index < SIZE; ++index, ++level) {
+    if (total != totals.end()) {
+      if (level->price() != total->first ||
+          level->order_count() != total->second.order_count ||
+          level->aggregate_qty() != total->second.qty) {
+        level->init(total->first, false);
+        level->add_orders(total->second.order_count, total->second.qty);
+        level->last_change(change);
+        last_change_ = change;
+      }
+      ++total;
+    } else if (level->price() != INVALID_LEVEL_PRICE) {
+      level->init(INVALID_LEVEL_PRICE, false);
+      level->last_change(change);
+      last_change_ = change;
+    }
+  }
+}
+
+} }
+
+#endif
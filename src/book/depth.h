@@ -8,6 +8,7 @@
 #include "types.h"
 #include <map>
 #include <cmath>
+#include <stdexcept>
 #include <string.h>
 
 namespace liquibook { namespace book {
@@ -47,6 +48,13 @@ public:
   /// @param is_bid indicator of bid or ask
   void add_order(Price price, Quantity qty, bool is_bid);
 
+  /// @brief add several orders at one price level
+  /// @param price the price level of the orders
+  /// @param count the number of orders
+  /// @param qty the total open quantity of the orders
+  /// @param is_bid indicator of bid or ask
+  void add_orders(Price price, uint32_t count, Quantity qty, bool is_bid);
+
   /// @brief ignore future fill quantity on a side, due to a match at 
   ///        accept time for an order
   /// @param qty the open quantity to ignore
@@ -70,12 +78,33 @@ public:
   /// @return true if the close erased a visible level
   bool close_order(Price price, Quantity open_qty, bool is_bid);
 
+  /// @brief cancel several orders at one price level
+  /// @param price the price level of the orders
+  /// @param count the number of orders
+  /// @param open_qty the total open quantity of the orders
+  /// @param is_bid indicator of bid or ask
+  /// @return true if the close erased a visible level
+  bool close_orders(Price price, uint32_t count, Quantity open_qty, 
+                    bool is_bid);
+
   /// @brief change quantity of an order
   /// @param price the price level of the order
   /// @param qty_delta the change in open quantity of the order (+ or -)
   /// @param is_bid indicator of bid or ask
   void change_qty_order(Price price, int32_t qty_delta, bool is_bid);
 
+  /// @brief change the orders at one price level by a net number and
+  ///        quantity, such as those of the replaces of a mass quote
+  /// @param price the price level of the orders
+  /// @param count_delta the change in the number of orders (+ or -)
+  /// @param qty_delta the change in open quantity of the orders (+ or -)
+  /// @param is_bid indicator of bid or ask
+  /// @return true if the change erased a visible level
+  bool change_orders(Price price, 
+                     int32_t count_delta, 
+                     int32_t qty_delta, 
+                     bool is_bid);
+
   /// @brief replace a order
   /// @param current_price the current price level of the order
   /// @param new_price the new price level of the order
@@ -102,6 +131,9 @@ public:
   /// @brief has the depth changed since the last publish
   bool changed() const;
 
+  /// @brief what was the last change?
+  ChangeId last_change() const;
+
   /// @brief what was the last published change?
   ChangeId last_published_change() const;
 
@@ -227,6 +259,19 @@ Depth<SIZE>::add_order(Price price, Quantity qty, bool is_bid)
   }
 }
 
+template <int SIZE> 
+inline void
+Depth<SIZE>::add_orders(Price price, uint32_t count, Quantity qty, bool is_bid)
+{
+  ChangeId last_change_copy = last_change_;
+  DepthLevel* level = find_level(price, is_bid);
+  if (level) {
+    last_change_ = last_change_copy + 1; // Ensure incremented
+    level->add_orders(count, qty);
+    level->last_change(last_change_);
+  }
+}
+
 template <int SIZE> 
 inline void
 Depth<SIZE>::ignore_fill_qty(Quantity qty, bool is_bid)
@@ -281,6 +326,27 @@ Depth<SIZE>::close_order(Price price, Quantity open_qty, bool is_bid)
   return false;
 }
 
+template <int SIZE> 
+inline bool
+Depth<SIZE>::close_orders(Price price, 
+                          uint32_t count, 
+                          Quantity open_qty, 
+                          bool is_bid)
+{
+  DepthLevel* level = find_level(price, is_bid, false);
+  if (level) {
+    // If these are the last orders on the level
+    if (level->close_orders(count, open_qty)) {
+      erase_level(level, is_bid);
+      return true;
+    // Else, mark the level as changed
+    } else {
+      level->last_change(++last_change_);
+    }
+  }
+  return false;
+}
+
 template <int SIZE> 
 inline void
 Depth<SIZE>::change_qty_order(Price price, int32_t qty_delta, bool is_bid)
@@ -297,6 +363,43 @@ Depth<SIZE>::change_qty_order(Price price, int32_t qty_delta, bool is_bid)
   // Ignore if not found - may be beyond our depth size
 }
  
+template <int SIZE> 
+inline bool
+Depth<SIZE>::change_orders(Price price, 
+                           int32_t count_delta, 
+                           int32_t qty_delta, 
+                           bool is_bid)
+{
+  if (!count_delta && !qty_delta) {
+    return false;
+  }
+  ChangeId last_change_copy = last_change_;
+  // Create the level only if orders join it
+  DepthLevel* level = find_level(price, is_bid, count_delta > 0);
+  if (!level) {
+    return false;
+  }
+  if (count_delta > 0) {
+    level->add_orders(Quantity(count_delta), 0);
+  }
+  if (qty_delta > 0) {
+    level->increase_qty(Quantity(qty_delta));
+  }
+  if (count_delta < 0) {
+    // If these were the last orders on the level
+    if (level->close_orders(Quantity(-count_delta), 
+                            qty_delta < 0 ? Quantity(-qty_delta) : 0)) {
+      erase_level(level, is_bid);
+      return true;
+    }
+  } else if (qty_delta < 0) {
+    level->decrease_qty(Quantity(-qty_delta));
+  }
+  last_change_ = last_change_copy + 1; // Ensure incremented
+  level->last_change(last_change_);
+  return false;
+}
+
 template <int SIZE> 
 inline bool
 Depth<SIZE>::replace_order(
@@ -538,6 +641,14 @@ Depth<SIZE>::changed() const
 }
 
 
+template <int SIZE> 
+ChangeId
+Depth<SIZE>::last_change() const
+{
+  return last_change_;
+}
+
+
 template <int SIZE> 
 ChangeId
 Depth<SIZE>::last_published_change() const
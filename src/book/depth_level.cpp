@@ -64,6 +64,13 @@ DepthLevel::add_order(Quantity qty)
   aggregate_qty_ += qty;
 }
 
+void
+DepthLevel::add_orders(uint32_t count, Quantity qty)
+{
+  order_count_ += count;
+  aggregate_qty_ += qty;
+}
+
 bool
 DepthLevel::close_order(Quantity qty)
 {
@@ -89,6 +96,25 @@ DepthLevel::close_order(Quantity qty)
   return empty;
 }
 
+bool
+DepthLevel::close_orders(uint32_t count, Quantity qty)
+{
+  if (order_count_ < count) {
+      throw std::runtime_error("DepthLevel::close_orders "
+                               "order count too low");
+  } else if (order_count_ == count) {
+    order_count_ = 0;
+    aggregate_qty_ = 0;
+    return true;
+  } else if (aggregate_qty_ < qty) {
+      throw std::runtime_error("DepthLevel::close_orders "
+                               "level quantity too low");
+  }
+  order_count_ -= count;
+  aggregate_qty_ -= qty;
+  return false;
+}
+
 void
 DepthLevel::increase_qty(Quantity qty)
 {
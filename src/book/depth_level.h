@@ -32,6 +32,11 @@ public:
   /// @param qty open quantity of the order
   void add_order(Quantity qty);
 
+  /// @brief add several orders to the level
+  /// @param count the number of orders
+  /// @param qty the total open quantity of the orders
+  void add_orders(uint32_t count, Quantity qty);
+
   /// @brief increase the quantity of existing orders
   /// @param qty amount to increase the quantity by
   void increase_qty(Quantity qty);
@@ -45,6 +50,12 @@ public:
   /// @return true if the level is now empty
   bool close_order(Quantity qty);
 
+  /// @brief cancel several orders, decrease count and quantity
+  /// @param count the number of orders closed
+  /// @param qty the total closed quantity
+  /// @return true if the level is now empty
+  bool close_orders(uint32_t count, Quantity qty);
+
   /// @brief set last changed stamp on this level
   void last_change(ChangeId last_change) { last_change_ = last_change; }
 
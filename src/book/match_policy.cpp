@@ -0,0 +1,57 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "match_policy.h"
+#include <algorithm>
+
+namespace liquibook { namespace book {
+
+const bool FifoMatch::allocates_level;
+const bool ProRataMatch::allocates_level;
+
+void
+FifoMatch::allocate(Quantity inbound_qty,
+                    const std::vector<Quantity>& level_qtys,
+                    Quantity /*level_qty*/,
+                    std::vector<Quantity>& allocations)
+{
+  allocations.assign(level_qtys.size(), 0);
+  // Fill each order in turn until the inbound quantity is exhausted
+  for (size_t index = 0; inbound_qty && index < level_qtys.size(); ++index) {
+    allocations[index] = std::min(inbound_qty, level_qtys[index]);
+    inbound_qty -= allocations[index];
+  }
+}
+
+void
+ProRataMatch::allocate(Quantity inbound_qty,
+                       const std::vector<Quantity>& level_qtys,
+                       Quantity level_qty,
+                       std::vector<Quantity>& allocations)
+{
+  allocations.assign(level_qtys.begin(), level_qtys.end());
+  // If the inbound order takes the whole level, there is nothing to prorate
+  if (inbound_qty >= level_qty) {
+    return;
+  }
+
+  // Allocate each order its share, rounded down
+  Quantity allocated = 0;
+  for (size_t index = 0; index < level_qtys.size(); ++index) {
+    allocations[index] = Quantity(
+        uint64_t(inbound_qty) * level_qtys[index] / level_qty);
+    allocated += allocations[index];
+  }
+
+  // Allocate what remains - fewer lots than orders - in time priority.
+  // Rounding down leaves each order short of its full quantity.
+  for (size_t index = 0;
+       allocated < inbound_qty && index < level_qtys.size(); ++index) {
+    if (allocations[index] < level_qtys[index]) {
+      ++allocations[index];
+      ++allocated;
+    }
+  }
+}
+
+} }
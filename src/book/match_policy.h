@@ -0,0 +1,56 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef match_policy_h
+#define match_policy_h
+
+#include "types.h"
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief price-time priority matching.  An inbound order matches the
+///        resting orders at each price in the order in which they arrived.
+///        OrderBook matches order by order under this policy, as it need
+///        not see the whole of a level to allocate.
+class FifoMatch {
+public:
+  /// @brief does this policy allocate across a whole price level?
+  static const bool allocates_level = false;
+
+  /// @brief allocate an inbound quantity across the orders at a price level
+  /// @param inbound_qty the quantity to allocate
+  /// @param level_qtys the quantity of each order at the level, in time
+  ///        priority
+  /// @param level_qty the total of level_qtys
+  /// @param allocations the quantity allocated to each order (out)
+  static void allocate(Quantity inbound_qty,
+                       const std::vector<Quantity>& level_qtys,
+                       Quantity level_qty,
+                       std::vector<Quantity>& allocations);
+};
+
+/// @brief pro-rata matching.  An inbound order is split across the resting
+///        orders at each price in proportion to their size.  Each order is
+///        allocated its proportion rounded down, and the lots left over by
+///        rounding are allocated one at a time in time priority.
+class ProRataMatch {
+public:
+  /// @brief does this policy allocate across a whole price level?
+  static const bool allocates_level = true;
+
+  /// @brief allocate an inbound quantity across the orders at a price level
+  /// @param inbound_qty the quantity to allocate
+  /// @param level_qtys the quantity of each order at the level, in time
+  ///        priority
+  /// @param level_qty the total of level_qtys
+  /// @param allocations the quantity allocated to each order (out)
+  static void allocate(Quantity inbound_qty,
+                       const std::vector<Quantity>& level_qtys,
+                       Quantity level_qty,
+                       std::vector<Quantity>& allocations);
+};
+
+} }
+
+#endif
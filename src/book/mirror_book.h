@@ -0,0 +1,337 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef mirror_book_h
+#define mirror_book_h
+
+#include "depth.h"
+#include "order_id_index.h"
+#include "types.h"
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief an order resting in a mirror book
+struct MirrorOrder {
+  OrderId id;
+  Price price;
+  Quantity open_qty;
+  bool is_buy;
+};
+
+/// @brief book of another venue, rebuilt from that venue's order by order
+///        feed.  Nothing matches: each feed event (add, modify, replace,
+///        reduce, execute or remove) is applied to the order it names and
+///        to the depth.  Orders are found by the venue's order ID in O(1),
+///        and held in a pool which reuses the slots of removed orders.
+///        Events naming an unknown order, or quantities the order does not
+///        have, are refused and change nothing.
+template <int SIZE = 5>
+class MirrorBook {
+public:
+  typedef Depth<SIZE> MirrorDepth;
+
+  /// @brief construct an empty book
+  MirrorBook();
+
+  /// @brief add an order
+  /// @param id the venue's order ID
+  /// @param is_buy indicator of bid or ask
+  /// @param price the limit price of the order
+  /// @param qty the open quantity of the order
+  /// @return false if the ID is in use, or the price or quantity is 0
+  bool add(OrderId id, bool is_buy, Price price, Quantity qty);
+
+  /// @brief change the price and quantity of an order, keeping its ID.  A
+  ///        quantity of 0 removes the order.
+  /// @param id the venue's order ID
+  /// @param new_qty the new open quantity of the order
+  /// @param new_price the new price, or PRICE_UNCHANGED
+  /// @return true if the order was found
+  bool modify(OrderId id,
+              Quantity new_qty,
+              Price new_price = PRICE_UNCHANGED);
+
+  /// @brief replace an order with one of a new ID on the same side
+  /// @param id the venue's order ID of the replaced order
+  /// @param new_id the venue's order ID of the new order
+  /// @param new_qty the open quantity of the new order
+  /// @param new_price the price of the new order, or PRICE_UNCHANGED
+  /// @return true if the order was found and the new ID was not in use
+  bool replace(OrderId id,
+               OrderId new_id,
+               Quantity new_qty,
+               Price new_price = PRICE_UNCHANGED);
+
+  /// @brief cancel part of an order
+  /// @param id the venue's order ID
+  /// @param qty the quantity cancelled
+  /// @return true if the order was found with at least that quantity
+  bool reduce(OrderId id, Quantity qty);
+
+  /// @brief apply an execution of a resting order
+  /// @param id the venue's order ID
+  /// @param qty the quantity executed
+  /// @return true if the order was found with at least that quantity
+  bool execute(OrderId id, Quantity qty);
+
+  /// @brief remove an order
+  /// @param id the venue's order ID
+  /// @return true if the order was found
+  bool remove(OrderId id);
+
+  /// @brief remove every order, as when the venue's feed is reset
+  void clear();
+
+  /// @brief find an order
+  /// @param id the venue's order ID
+  /// @return the order, or NULL if not found.  Valid until the book changes.
+  const MirrorOrder* find(OrderId id) const;
+
+  /// @brief get the number of orders in the book
+  uint32_t order_count() const;
+
+  /// @brief get the quantity executed since construction or clear()
+  uint64_t executed_qty() const;
+
+  /// @brief get the price of the last execution, or 0 if none
+  Price last_executed_price() const;
+
+  /// @brief access the depth
+  MirrorDepth& depth();
+  const MirrorDepth& depth() const;
+
+private:
+  typedef std::vector<MirrorOrder> Orders;
+  typedef std::vector<uint32_t> OrderSlots;
+
+  Orders orders_;
+  OrderSlots free_slots_;
+  OrderIdIndex index_;
+  MirrorDepth depth_;
+  uint64_t executed_qty_;
+  Price last_executed_price_;
+
+  /// @brief find the pool slot of an order
+  MirrorOrder* find_order(OrderId id);
+
+  /// @brief take a quantity from an order, removing it when none is left
+  bool take_qty(OrderId id, Quantity qty);
+
+  /// @brief remove an order from the index, the pool and the depth
+  void remove_order(MirrorOrder& order);
+};
+
+template <int SIZE>
+MirrorBook<SIZE>::MirrorBook()
+: executed_qty_(0),
+  last_executed_price_(0)
+{
+}
+
+template <int SIZE>
+inline bool
+MirrorBook<SIZE>::add(OrderId id, bool is_buy, Price price, Quantity qty)
+{
+  if (price == MARKET_ORDER_PRICE || !qty) {
+    return false;
+  }
+  uint32_t slot = orders_.size();
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+  }
+  if (!index_.insert(id, slot)) {
+    return false;
+  }
+  if (slot == orders_.size()) {
+    orders_.push_back(MirrorOrder());
+  } else {
+    free_slots_.pop_back();
+  }
+  MirrorOrder& order = orders_[slot];
+  order.id = id;
+  order.price = price;
+  order.open_qty = qty;
+  order.is_buy = is_buy;
+  depth_.add_order(price, qty, is_buy);
+  return true;
+}
+
+template <int SIZE>
+inline bool
+MirrorBook<SIZE>::modify(OrderId id, Quantity new_qty, Price new_price)
+{
+  MirrorOrder* order = find_order(id);
+  if (!order) {
+    return false;
+  }
+  if (!new_qty) {
+    remove_order(*order);
+    return true;
+  }
+  if (new_price == PRICE_UNCHANGED) {
+    new_price = order->price;
+  }
+  depth_.replace_order(order->price, new_price,
+                       order->open_qty, new_qty, order->is_buy);
+  order->price = new_price;
+  order->open_qty = new_qty;
+  return true;
+}
+
+template <int SIZE>
+inline bool
+MirrorBook<SIZE>::replace(OrderId id,
+                          OrderId new_id,
+                          Quantity new_qty,
+                          Price new_price)
+{
+  const MirrorOrder* order = find(id);
+  if (!order || (new_id != id && find(new_id))) {
+    return false;
+  }
+  const bool is_buy = order->is_buy;
+  if (new_price == PRICE_UNCHANGED) {
+    new_price = order->price;
+  }
+  remove(id);
+  if (new_qty) {
+    add(new_id, is_buy, new_price, new_qty);
+  }
+  return true;
+}
+
+template <int SIZE>
+inline bool
+MirrorBook<SIZE>::reduce(OrderId id, Quantity qty)
+{
+  return take_qty(id, qty);
+}
+
+template <int SIZE>
+inline bool
+MirrorBook<SIZE>::execute(OrderId id, Quantity qty)
+{
+  const MirrorOrder* order = find(id);
+  if (!order) {
+    return false;
+  }
+  const Price price = order->price;
+  if (!take_qty(id, qty)) {
+    return false;
+  }
+  executed_qty_ += qty;
+  last_executed_price_ = price;
+  return true;
+}
+
+template <int SIZE>
+inline bool
+MirrorBook<SIZE>::remove(OrderId id)
+{
+  MirrorOrder* order = find_order(id);
+  if (!order) {
+    return false;
+  }
+  remove_order(*order);
+  return true;
+}
+
+template <int SIZE>
+inline void
+MirrorBook<SIZE>::clear()
+{
+  orders_.clear();
+  free_slots_.clear();
+  index_.clear();
+  depth_ = MirrorDepth();
+  executed_qty_ = 0;
+  last_executed_price_ = 0;
+}
+
+template <int SIZE>
+inline const MirrorOrder*
+MirrorBook<SIZE>::find(OrderId id) const
+{
+  uint32_t slot;
+  if (index_.find(id, slot)) {
+    return &orders_[slot];
+  }
+  return NULL;
+}
+
+template <int SIZE>
+inline uint32_t
+MirrorBook<SIZE>::order_count() const
+{
+  return index_.size();
+}
+
+template <int SIZE>
+inline uint64_t
+MirrorBook<SIZE>::executed_qty() const
+{
+  return executed_qty_;
+}
+
+template <int SIZE>
+inline Price
+MirrorBook<SIZE>::last_executed_price() const
+{
+  return last_executed_price_;
+}
+
+template <int SIZE>
+inline typename MirrorBook<SIZE>::MirrorDepth&
+MirrorBook<SIZE>::depth()
+{
+  return depth_;
+}
+
+template <int SIZE>
+inline const typename MirrorBook<SIZE>::MirrorDepth&
+MirrorBook<SIZE>::depth() const
+{
+  return depth_;
+}
+
+template <int SIZE>
+inline MirrorOrder*
+MirrorBook<SIZE>::find_order(OrderId id)
+{
+  uint32_t slot;
+  if (index_.find(id, slot)) {
+    return &orders_[slot];
+  }
+  return NULL;
+}
+
+template <int SIZE>
+inline bool
+MirrorBook<SIZE>::take_qty(OrderId id, Quantity qty)
+{
+  MirrorOrder* order = find_order(id);
+  if (!order || !qty || qty > order->open_qty) {
+    return false;
+  }
+  if (qty == order->open_qty) {
+    remove_order(*order);
+  } else {
+    depth_.change_qty_order(order->price, -(int32_t)qty, order->is_buy);
+    order->open_qty -= qty;
+  }
+  return true;
+}
+
+template <int SIZE>
+inline void
+MirrorBook<SIZE>::remove_order(MirrorOrder& order)
+{
+  depth_.close_order(order.price, order.open_qty, order.is_buy);
+  index_.erase(order.id);
+  free_slots_.push_back(uint32_t(&order - &orders_[0]));
+}
+
+} }
+
+#endif
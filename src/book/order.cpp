@@ -9,4 +9,34 @@ Order::is_limit() const {
   return (price() > 0);
 }
 
+Price
+Order::stop_price() const {
+  return 0;
+}
+
+Quantity
+Order::display_qty() const {
+  return 0;
+}
+
+OwnerId
+Order::owner() const {
+  return 0;
+}
+
+Timestamp
+Order::expire_time() const {
+  return 0;
+}
+
+PegType
+Order::peg_type() const {
+  return peg_none;
+}
+
+Quantity
+Order::min_qty() const {
+  return 0;
+}
+
 } }
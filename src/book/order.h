@@ -23,6 +23,34 @@ public:
 
   /// @brief get the quantity of this order
   virtual Quantity order_qty() const = 0;
+
+  // The features below are optional.  An order which does not use one 
+  // need not override it.
+
+  /// @brief get the stop price of this order, or 0 if not a stop order
+  virtual Price stop_price() const;
+
+  /// @brief get the quantity of this order to display at a time, or 0 if 
+  ///        the whole order is displayed (not an iceberg order)
+  virtual Quantity display_qty() const;
+
+  /// @brief get the owner (account) of this order, or 0 if none.  Orders 
+  ///        with the same owner are prevented from matching.
+  virtual OwnerId owner() const;
+
+  /// @brief get the time at which this order expires, or 0 if it does not
+  ///        (good till cancel).  Times are in the units the book's time is
+  ///        advanced in.
+  virtual Timestamp expire_time() const;
+
+  /// @brief get the price this order is pegged to, or peg_none.  A pegged
+  ///        order has no price of its own, its price follows the best bid 
+  ///        and offer.
+  virtual PegType peg_type() const;
+
+  /// @brief get the least quantity this order must fill when it matches on 
+  ///        entry, used with the oc_minimum_qty condition, or 0 if none
+  virtual Quantity min_qty() const;
 };
 
 } }
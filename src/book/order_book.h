@@ -8,12 +8,16 @@
 #include "order.h"
 #include "order_listener.h"
 #include "depth_level.h"
+#include "price_ladder.h"
+#include "timer_wheel.h"
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <iostream>
 #include <stdexcept>
 #include <cmath>
 #include <list>
+#include <deque>
 
 namespace liquibook { namespace book {
 
@@ -23,21 +27,92 @@ class OrderBookListener;
 template<class OrderPtr>
 class OrderListener;
 
+/// @brief totals of the resting orders at a price level, kept up to date by
+///        OrderBook so that questions about a level need not visit its orders
+struct LevelTotal {
+  LevelTotal() : qty(0), aon_qty(0), aon_count(0), min_aon_qty(0) {}
+  Quantity qty;         // the visible quantity of orders other than all or none
+  Quantity aon_qty;     // the quantity of all or none orders
+  uint32_t aon_count;   // the number of all or none orders
+  Quantity min_aon_qty; // the quantity of the smallest all or none order
+};
+
+/// @brief the cost of filling a quantity from one side of the book, as
+///        answered by OrderBook::cost_to_fill()
+struct FillCost {
+  FillCost() : filled_qty(0), cost(0), worst_price(0), level_count(0) {}
+  Quantity filled_qty;  // the quantity which can be filled, up to that asked
+  uint64_t cost;        // the total of price times quantity of the fills
+  Price worst_price;    // the price of the last level reached, or 0 if none
+  uint32_t level_count; // the number of price levels reached
+  /// @brief get the volume weighted average price, or 0 if nothing fills
+  double vwap() const 
+  { 
+    return filled_qty ? double(cost) / filled_qty : 0.0; 
+  }
+};
+
+/// @brief a change to one resting order of a mass quote - the arguments of
+///        a replace
+template <class OrderPtr = Order*>
+struct Quote {
+  Quote() : order(), size_delta(SIZE_UNCHANGED), new_price(PRICE_UNCHANGED) {}
+  Quote(const OrderPtr& quote_order, 
+        int32_t quote_size_delta, 
+        Price quote_new_price = PRICE_UNCHANGED)
+  : order(quote_order), 
+    size_delta(quote_size_delta), 
+    new_price(quote_new_price) 
+  {}
+  OrderPtr order;
+  int32_t size_delta;
+  Price new_price;
+};
+
 /// @brief Tracker of an order's state, to keep inside the OrderBook.  
-///   Kept separate from the order itself.
+///   Kept separate from the order itself.  The fields of every order are 
+///   kept inline; those of icebergs, minimum quantity and expiring orders
+///   only are kept apart, so the tracker of most orders stays small.
 template <class OrderPtr = Order*>
 class OrderTracker {
 public:
   /// @brief construct
-  OrderTracker(const OrderPtr& order, OrderConditions conditions = 0);
+  OrderTracker(const OrderPtr& order, 
+               OrderConditions conditions = 0,
+               TransId entry_trans = 0);
 
-  /// @brief modify the order quantity
+  /// @brief construct a tracker of no order, for another to be swapped in
+  OrderTracker();
+
+  /// @brief copy
+  OrderTracker(const OrderTracker& rhs);
+
+  /// @brief assign
+  OrderTracker& operator=(const OrderTracker& rhs);
+
+  /// @brief destroy
+  ~OrderTracker();
+
+  /// @brief exchange the state of two trackers, without copying the fields
+  ///        kept apart
+  void swap(OrderTracker& rhs);
+
+  /// @brief modify the order quantity.  The reserve of an iceberg order
+  ///        takes the change first.
   void change_qty(int32_t delta);
 
   /// @brief fill an order
   /// @param qty the number of shares filled in this fill
   void fill(Quantity qty); 
 
+  /// @brief reduce the open quantity of an order without a fill, to
+  ///        prevent a self-trade.  The visible quantity is reduced first.
+  /// @param qty the number of shares to remove
+  void reduce(Quantity qty);
+
+  /// @brief display the next slice of an iceberg order from its reserve
+  void refresh();
+
   /// @brief is there no remaining open quantity in this order?
   bool filled() const;
 
@@ -47,7 +122,26 @@ public:
   /// @brief get the open quantity of this order
   Quantity open_qty() const;
 
-  /// @brief get the order pointer
+  /// @brief get the open quantity which may be matched by an inbound order,
+  ///        excluding the reserve of an iceberg order
+  Quantity visible_qty() const;
+
+  /// @brief get the hidden open quantity of an iceberg order
+  Quantity reserve_qty() const;
+
+  /// @brief get the limit price of the order, as cached on entry and on
+  ///        replace.  For a pegged order, the price of its peg when it was
+  ///        last matched as an inbound order.
+  Price price() const;
+
+  /// @brief set the price of the order, when it is replaced or pegged
+  void set_price(Price price);
+
+  /// @brief is this a buy order?
+  bool is_buy() const;
+
+  /// @brief get the order pointer.  The order itself is read only to enter
+  ///        it and to report to listeners, never while matching.
   const OrderPtr& ptr() const;
 
   /// @brief get the order pointer
@@ -59,32 +153,114 @@ public:
   /// @ brief is this order marked immediate or cancel?
   bool immediate_or_cancel() const;
 
+  /// @ brief is this an iceberg order?
+  bool iceberg() const;
+
+  /// @brief get the least quantity the order must fill when it matches as
+  ///        an inbound order - all of it if all or none, else its minimum
+  ///        quantity, if any.  0 if any fill will do.
+  Quantity required_qty() const;
+
+  /// @brief drop the minimum quantity of the order, which applies only to
+  ///        its match on entry
+  void clear_min_qty();
+
+  /// @brief get the owner of the order, or 0 if none
+  OwnerId owner() const;
+
+  /// @brief get the expiry timer of the order, or 0 if none is scheduled
+  TimerId timer() const;
+
+  /// @brief set the expiry timer of the order
+  void set_timer(TimerId timer);
+
+  /// @brief get the quantity of the order counted in its level's total
+  Quantity level_qty() const;
+
+  /// @brief set the quantity of the order counted in its level's total
+  void set_level_qty(Quantity qty);
+
+  /// @brief get the conditions the order was added with
+  OrderConditions conditions() const;
+
+  /// @brief get the transaction which added the order to the book, which
+  ///        identifies it in the book's hash
+  TransId entry_trans() const;
+
+  /// @brief get the open quantity of the order counted in the book's hash
+  Quantity hashed_qty() const;
+
+  /// @brief set the open quantity of the order counted in the book's hash
+  void set_hashed_qty(Quantity qty);
+
 private:
+  // The fields of iceberg, minimum quantity and expiring orders
+  struct Detail {
+    Detail() : reserve_qty(0), display_qty(0), min_qty(0), timer(0) {}
+    Quantity reserve_qty;
+    Quantity display_qty;
+    Quantity min_qty;
+    TimerId timer;
+  };
+
+  // The side of the order, kept in the high bit of the conditions
+  static const OrderConditions BUY_FLAG = 0x80000000;
+
   OrderPtr order_;
+  Detail* detail_;     // NULL unless the order needs it
+  // Read by the match loop, so kept together at the front
   Quantity open_qty_;
+  Price price_;
   OrderConditions conditions_;
+  OwnerId owner_;
+  Quantity level_qty_;
+  // Read on fills, on changes to the book and for listeners
+  Quantity filled_qty_;
+  Quantity hashed_qty_;
+  TransId entry_trans_;
 };
 
+// The tracker of an order without a Detail is eight 32 bit fields and two
+// pointers.  The array has a negative size, failing the build, if it grows.
+typedef char order_tracker_size_check[
+    (sizeof(OrderTracker<Order*>) <= 32 + 2 * sizeof(Order*)) ? 1 : -1];
+
 /// @brief The limit order book of a security.  Template implementation allows
 ///        user to supply common or smart pointers, and to provide a different
-///        Order class completely (as long as interface is obeyed).
-template <class OrderPtr = Order*>
+///        Order class completely (as long as interface is obeyed).  The 
+///        MatchPolicy (see match_policy.h) allocates inbound orders among 
+///        the resting orders at a price, and defaults to FifoMatch.
+template <class OrderPtr = Order*, class MatchPolicy>
 class OrderBook {
 public:
   typedef OrderTracker<OrderPtr > Tracker;
   typedef Callback<OrderPtr > TypedCallback;
+  typedef Quote<OrderPtr > TypedQuote;
   typedef OrderListener<OrderPtr > TypedOrderListener;
   typedef OrderBookListener<OrderPtr > TypedOrderBookListener;
   typedef std::vector<TypedCallback > Callbacks;
   typedef std::multimap<Price, Tracker, std::greater<Price> >  Bids;
   typedef std::multimap<Price, Tracker, std::less<Price> >     Asks;
-  typedef std::list<typename Bids::iterator> DeferredBidCrosses;
-  typedef std::list<typename Asks::iterator> DeferredAskCrosses;
+  // Totals of the resting orders at each price, best first
+  typedef std::map<Price, LevelTotal, std::greater<Price> > BidTotals;
+  typedef std::map<Price, LevelTotal, std::less<Price> >    AskTotals;
+  typedef std::vector<typename Bids::iterator> BidLevel;
+  typedef std::vector<typename Asks::iterator> AskLevel;
+  // Untriggered buy stops by stop price, a rising trade price triggers first
+  typedef std::multimap<Price, Tracker, std::less<Price> >     StopBids;
+  // Untriggered sell stops by stop price, a falling trade price triggers first
+  typedef std::multimap<Price, Tracker, std::greater<Price> >  StopAsks;
+  typedef std::deque<Tracker> TriggeredStops;
+  typedef std::vector<OrderPtr> OrderPtrs;
+  typedef TimerWheel<OrderPtr> ExpiryWheel;
+  // Resting pegged orders of a side and peg type, in time priority
+  typedef std::list<Tracker> PeggedOrders;
 
   /// @brief construct
   OrderBook();
 
-  /// @brief add an order to book
+  /// @brief add an order to book.  A stop order (having a non-zero stop 
+  ///        price) is held until the last trade price reaches its stop price.
   /// @param order the order to add
   /// @param conditions special conditions on the order
   /// @return true if the add resulted in a fill
@@ -93,6 +269,31 @@ public:
   /// @brief cancel an order in the book
   virtual void cancel(const OrderPtr& order);
 
+  /// @brief cancel every order in the book matching the criteria, including
+  ///        untriggered stop orders, in one pass over the affected levels.  
+  ///        Issues a single mass cancel callback rather than one per order.
+  /// @param owner the owner of the orders to cancel, or 0 for any owner
+  /// @param cancel_bids should buy orders be cancelled?
+  /// @param cancel_asks should sell orders be cancelled?
+  /// @param low_price the lowest limit price to cancel, or 0 for no limit
+  /// @param high_price the highest limit price to cancel, or 0 for no limit
+  /// @return the number of orders cancelled
+  virtual uint32_t mass_cancel(OwnerId owner = 0,
+                               bool cancel_bids = true,
+                               bool cancel_asks = true,
+                               Price low_price = 0,
+                               Price high_price = 0);
+
+  /// @brief advance the time of the book, cancelling every resting order 
+  ///        (including untriggered stop orders) whose expiry time has been 
+  ///        reached.  Costs nothing per order which does not expire.
+  /// @param now the new time, in the units of the orders' expiry times
+  /// @return the number of orders expired
+  virtual uint32_t advance_time(Timestamp now);
+
+  /// @brief get the time of the book, as last advanced
+  Timestamp current_time() const { return expiries_.now(); }
+
   /// @brief replace an order in the book
   /// @param order the order to replace
   /// @param size_delta the change in size for the order (positive or negative)
@@ -102,15 +303,152 @@ public:
                        int32_t size_delta = SIZE_UNCHANGED,
                        Price new_price = PRICE_UNCHANGED);
 
+  /// @brief replace several resting orders at once, such as a market 
+  ///        maker's bid and ask, as one transaction.  Each quote is 
+  ///        replaced as by replace(), but the accepted replaces are issued
+  ///        in a single mass quote callback, and the book settles (stops,
+  ///        pegs and auction) once.
+  /// @param quotes the changes to make
+  /// @param quote_count the number of quotes
+  /// @return true if any replace resulted in a fill
+  virtual bool mass_quote(const TypedQuote* quotes, uint32_t quote_count);
+
   /// @brief access the bids container
   const Bids& bids() const { return bids_; };
 
   /// @brief access the asks container
   const Asks& asks() const { return asks_; };
 
+  /// @brief access the totals of the bid price levels
+  const BidTotals& bid_totals() const { return bid_totals_; };
+
+  /// @brief access the totals of the ask price levels
+  const AskTotals& ask_totals() const { return ask_totals_; };
+
+  /// @brief find what filling a quantity from the book would cost now, from
+  ///        the level totals.  Counts the visible quantity of orders other
+  ///        than all or none orders, at their limit prices.  Does not visit
+  ///        orders or change the book.
+  /// @param is_buy true to buy from the asks, false to sell to the bids
+  /// @param qty the quantity to fill
+  /// @param limit_price the worst price to fill at, or 0 for no limit
+  /// @return the quantity which fills, its cost and the levels reached
+  FillCost cost_to_fill(bool is_buy, 
+                        Quantity qty, 
+                        Price limit_price = 0) const;
+
+  /// @brief find the visible quantity and number of orders ahead of a 
+  ///        resting order at its price level.  The level is walked up to 
+  ///        the order, as cancel() does, so the query is O(n) in the 
+  ///        orders ahead, and keeping the book costs nothing extra.
+  /// @param order the resting order
+  /// @param qty_ahead the quantity ahead of the order (out)
+  /// @param orders_ahead the number of orders ahead of the order (out)
+  /// @return true if the order is resting in the book
+  bool queue_ahead(const OrderPtr& order, 
+                   Quantity& qty_ahead, 
+                   uint32_t& orders_ahead) const;
+
+  /// @brief find the tracker of a resting order, such as to read its open
+  ///        quantity and conditions
+  /// @param order the order
+  /// @return the tracker, or NULL if the order is not resting in the book
+  ///         or the queue of its peg.  Valid until the book changes.
+  const Tracker* find_resting(const OrderPtr& order) const;
+
+  /// @brief access the untriggered buy stop orders
+  const StopBids& stop_bids() const { return stop_bids_; };
+
+  /// @brief access the untriggered sell stop orders
+  const StopAsks& stop_asks() const { return stop_asks_; };
+
+  /// @brief access the resting pegged orders of a side and peg type
+  const PeggedOrders& pegged_orders(bool is_buy, PegType peg_type) const 
+  { 
+    return peg_queues_[peg_index(is_buy, peg_type)].orders; 
+  }
+
+  /// @brief get the current price of pegged orders, from the best bid and 
+  ///        offer of the orders with a price of their own
+  /// @param is_buy the side of the pegged orders
+  /// @param peg_type the price the orders are pegged to
+  /// @return the pegged price, or 0 if there is no price to peg to
+  Price pegged_price(bool is_buy, PegType peg_type) const;
+
+  /// @brief set whether pegged orders are shown in depth.  If so, a pegged 
+  ///        depth callback is issued whenever the price or quantity of the 
+  ///        pegged orders of a side and type changes.  Off by default, and
+  ///        should be set before pegged orders are added.
+  void set_pegged_depth(bool pegged_depth) { pegged_depth_ = pegged_depth; }
+
+  /// @brief are pegged orders shown in depth?
+  bool pegged_depth() const { return pegged_depth_; }
+
+  /// @brief get the price of the last trade, or 0 if there has been none
+  Price last_trade_price() const { return last_trade_price_; }
+
+  /// @brief get the ID of the last transaction, as given in its callbacks
+  TransId trans_id() const { return trans_id_; }
+
+  /// @brief get the hash of the orders resting in the book, pegged and
+  ///        held as untriggered stops.  Each order counts its entry 
+  ///        transaction, side, price (the peg of a pegged order, the stop 
+  ///        and limit prices of a stop), open quantity and conditions, and 
+  ///        the counts are summed, so the hash is kept up to date in O(1) as
+  ///        orders change.  Books given the same transactions have the same
+  ///        hash after each of them.
+  uint64_t book_hash() const { return book_hash_; }
+
+  /// @brief set the action taken when orders with the same owner would 
+  ///        match.  The default is stp_cancel_newest.
+  void set_self_trade_prevention(SelfTradePrevention stp) 
+  { 
+    self_trade_prevention_ = stp; 
+  }
+
+  /// @brief get the action taken when orders with the same owner would match
+  SelfTradePrevention self_trade_prevention() const 
+  { 
+    return self_trade_prevention_; 
+  }
+
+  /// @brief begin an auction (pre-open) period.  Orders accepted during the
+  ///        auction rest without matching, and an uncross update callback 
+  ///        with the indicative uncross is issued after every order event.
+  /// @param low_price the lowest price expected during the auction
+  /// @param high_price the highest price expected during the auction
+  void begin_auction(Price low_price, Price high_price);
+
+  /// @brief end the auction, crossing the book at the indicative uncross 
+  ///        price.  All or none orders do not take part in the uncross.
+  /// @return true if the uncross resulted in a fill
+  bool end_auction();
+
+  /// @brief is the book in an auction period?
+  bool in_auction() const { return in_auction_; }
+
+  /// @brief access the indicative uncross of the current auction
+  const IndicativeUncross& indicative_uncross() const { return uncross_; }
+
   /// @brief perform all callbacks in the queue
   virtual void perform_callbacks();
 
+  /// @brief get the orders cancelled by a mass cancel callback
+  /// @param cb the mass cancel callback
+  /// @return the first of cb.cancel_count orders
+  const OrderPtr* mass_cancelled(const TypedCallback& cb) const
+  {
+    return &mass_cancelled_[cb.cancel_begin];
+  }
+
+  /// @brief get the replaces of a mass quote callback
+  /// @param cb the mass quote callback
+  /// @return the first of cb.quote_count replace callbacks
+  const TypedCallback* mass_quoted(const TypedCallback& cb) const
+  {
+    return &mass_quoted_[cb.quote_begin];
+  }
+
   /// @brief perform an individual callback
   virtual void perform_callback(TypedCallback& cb);
 
@@ -142,6 +480,84 @@ protected:
   void cross_orders(Tracker& inbound_tracker, 
                     Tracker& current_tracker);
 
+  /// @brief perform fill on two orders at a given price
+  /// @param inbound_tracker the new (or changed) order tracker
+  /// @param current_tracker the current order tracker
+  /// @param cross_price the price of the fill
+  void cross_orders(Tracker& inbound_tracker, 
+                    Tracker& current_tracker,
+                    Price cross_price);
+
+  /// @brief perform fill of a given quantity on two orders at a given price
+  /// @param inbound_tracker the new (or changed) order tracker
+  /// @param current_tracker the current order tracker
+  /// @param cross_price the price of the fill
+  /// @param fill_qty the quantity of the fill
+  void cross_orders(Tracker& inbound_tracker, 
+                    Tracker& current_tracker,
+                    Price cross_price,
+                    Quantity fill_qty);
+
+  /// @brief get the price at which two orders cross - the current order's
+  ///        price, or the inbound order's if the current is a market order
+  Price cross_price(const Tracker& inbound_tracker, 
+                    const Tracker& current_tracker) const;
+
+  /// @brief match an inbound order with the book and the pegged orders of
+  ///        the opposite side.  Pegged orders are priced when matching 
+  ///        starts, and match after the book's orders at their price.
+  /// @param inbound the inbound order
+  /// @param inbound_price the price of the inbound order
+  /// @return true if a match occurred 
+  bool match_inbound(Tracker& inbound, Price inbound_price);
+
+  /// @brief match an inbound order with the pegged orders of a side and type
+  /// @param inbound the inbound order
+  /// @param is_buy the side of the pegged orders
+  /// @param peg_type the type of the pegged orders
+  /// @param peg_price the price of the pegged orders
+  /// @return true if a match occurred 
+  bool match_pegs(Tracker& inbound, 
+                  bool is_buy, 
+                  PegType peg_type, 
+                  Price peg_price);
+
+  /// @brief decide whether an inbound order can fill a required quantity,
+  ///        from the level totals where they decide it, or else by visiting
+  ///        the orders which match it in the order the MatchPolicy fills
+  ///        them.  Orders of the same owner met while visiting are settled
+  ///        by self-trade prevention.
+  /// @param inbound the inbound order
+  /// @param inbound_price the price of the inbound order
+  /// @param side the resting orders of the opposite side
+  /// @param totals the level totals of the opposite side
+  /// @param required_qty the quantity which must be filled
+  /// @return true if the inbound order can fill the required quantity
+  template <class Side, class Totals>
+  bool can_fill(Tracker& inbound, 
+                const Price& inbound_price, 
+                Side& side,
+                const Totals& totals,
+                Quantity required_qty);
+
+  /// @brief get what is left of an inbound order's open quantity after a
+  ///        quantity counted as matched by can_fill()
+  static Quantity unmatched_qty(Quantity open_qty, Quantity matched_qty);
+
+  /// @brief match an inbound order a price level at a time, allocating
+  ///        across the orders at each level by the MatchPolicy.  All or 
+  ///        none orders at a level are matched after the others.
+  /// @param inbound the inbound order
+  /// @param inbound_price the price of the inbound order
+  /// @param side the resting orders of the opposite side
+  /// @param level scratch space for the orders at a level
+  /// @return true if a match occurred 
+  template <class Side, class Level>
+  bool match_levels(Tracker& inbound, 
+                    const Price& inbound_price, 
+                    Side& side,
+                    Level& level);
+
   /// @brief perform validation on the order, and create reject callbacks if not
   /// @param order the order to validate
   /// @return true if the order is valid
@@ -163,6 +579,172 @@ protected:
   /// @brief find an ask
   void find_ask(const OrderPtr& order, typename Asks::iterator& result);
 
+  /// @brief find an untriggered stop order
+  /// @param order the stop order to find
+  /// @param stops the untriggered stop orders of the order's side
+  /// @return the stop order location, or stops.end() if not found
+  template <class Stops>
+  typename Stops::iterator find_stop(const OrderPtr& order, Stops& stops);
+
+  /// @brief remove an order from the book or the untriggered stop orders
+  /// @param order the order to remove
+  /// @return true if the order was found
+  bool erase_order(const OrderPtr& order);
+
+  /// @brief cancel the expiry timer of an order leaving the book
+  void unschedule(Tracker& tracker);
+
+  /// @brief bring the quantity a resting order counts in its level's total
+  ///        up to date
+  /// @param price the price level of the order
+  /// @param tracker the order
+  void sync_level(Price price, Tracker& tracker);
+
+  /// @brief remove a resting order leaving the book from its level's total
+  /// @param price the price level of the order
+  /// @param tracker the order
+  void leave_level(Price price, Tracker& tracker);
+
+  /// @brief where an order counted in the book's hash is held
+  enum HashTag {
+    hash_resting,
+    hash_pegged,
+    hash_stop
+  };
+
+  /// @brief change the open quantity an order counts in the book's hash
+  /// @param price the price level of the order, the stop price of a stop, 
+  ///        or the peg queue of a pegged order
+  /// @param tracker the order
+  /// @param qty the open quantity to count, 0 if the order leaves the book
+  /// @param tag where the order is held
+  void change_hash(Price price, 
+                   Tracker& tracker, 
+                   Quantity qty, 
+                   HashTag tag = hash_resting);
+
+  /// @brief get the count of an order in the book's hash
+  static uint64_t order_hash(const Tracker& tracker, 
+                             Price price, 
+                             Quantity qty,
+                             HashTag tag);
+
+  /// @brief remove an untriggered stop leaving the stops from the book's
+  ///        hash
+  /// @param stop_price the stop price of the order
+  /// @param tracker the order
+  void leave_stops(Price stop_price, Tracker& tracker);
+
+  /// @brief mix the bits of a hash
+  static uint64_t mix_hash(uint64_t hash);
+
+  /// @brief change the quantity counted in a level's total.  The order 
+  ///        must already count its new quantity, as the level's orders may
+  ///        be visited.
+  /// @param side the resting orders of the order's side
+  /// @param totals the level totals of the order's side
+  /// @param price the price level of the order
+  /// @param tracker the order
+  /// @param prior_qty the quantity the order counted before
+  template <class Side, class Totals>
+  void change_level_total(Side& side,
+                          Totals& totals, 
+                          Price price, 
+                          Tracker& tracker,
+                          Quantity prior_qty);
+
+  /// @brief move past a resting order which did not match.  If only all or
+  ///        none orders too large for the inbound order remain at the
+  ///        level, move past the whole level without visiting them.
+  /// @param side the resting orders
+  /// @param totals the level totals of the resting orders
+  /// @param resting the location of the resting order
+  /// @param inbound_qty the open quantity of the inbound order
+  /// @return the location of the next resting order to consider
+  template <class Side, class Totals>
+  typename Side::iterator skip_unmatched(Side& side,
+                                         const Totals& totals,
+                                         typename Side::iterator resting,
+                                         Quantity inbound_qty);
+
+  /// @brief find the quantity and orders ahead of an order on a side
+  template <class Side>
+  bool side_queue_ahead(const Side& side,
+                        const OrderPtr& order,
+                        Quantity& qty_ahead,
+                        uint32_t& orders_ahead) const;
+
+  /// @brief find the tracker of a resting order on a side
+  template <class Side>
+  const Tracker* side_find_resting(const Side& side,
+                                   const OrderPtr& order) const;
+
+  /// @brief find the cost of filling a quantity from a side's level totals
+  template <class Totals>
+  FillCost fill_cost(const Totals& totals,
+                     Quantity qty,
+                     Price limit_price,
+                     bool is_buy) const;
+
+  /// @brief get the best price of the bids with a price of their own
+  /// @return the best bid price, or 0 if none
+  Price best_bid() const;
+
+  /// @brief get the best price of the asks with a price of their own
+  /// @return the best ask price, or 0 if none
+  Price best_ask() const;
+
+  /// @brief settle a resting order after a fill - remove a filled order, 
+  ///        or display the next slice of an iceberg order, moving it to 
+  ///        the back of its price level
+  /// @param side the container of the resting order
+  /// @param resting the location of the resting order
+  /// @return the location following the resting order
+  template <class Side>
+  typename Side::iterator settle_fill(Side& side, 
+                                     typename Side::iterator resting);
+
+  /// @brief move a resting order behind the last order at its price.  Its
+  ///        tracker is swapped into a new place in the side, so nothing is
+  ///        allocated but the place itself.
+  /// @param side the container of the resting order
+  /// @param resting the location of the resting order
+  /// @return the location following the order's former location
+  template <class Side>
+  typename Side::iterator requeue(Side& side, 
+                                  typename Side::iterator resting);
+
+  /// @brief remove the orders of one side matching mass cancel criteria
+  /// @param side the orders of the side, in the book or untriggered stops
+  /// @param begin the first location to consider
+  /// @param end the location after the last to consider
+  /// @param owner the owner of the orders to cancel, or 0 for any owner
+  /// @param low_price the lowest limit price to cancel, or 0 for no limit
+  /// @param high_price the highest limit price to cancel, or 0 for no limit
+  /// @param update_ladder should the auction price ladder be updated?
+  /// @param stops are these untriggered stops?
+  template <class Side>
+  void mass_cancel_side(Side& side,
+                        typename Side::iterator begin,
+                        typename Side::iterator end,
+                        OwnerId owner,
+                        Price low_price,
+                        Price high_price,
+                        bool update_ladder,
+                        bool stops);
+
+  /// @brief prevent an inbound order matching a resting order with the
+  ///        same owner, as set by set_self_trade_prevention()
+  /// @param inbound the inbound order
+  /// @param side the container of the resting order
+  /// @param resting the location of the resting order
+  /// @return the location following the resting order
+  template <class Side>
+  typename Side::iterator prevent_self_trade(
+      Tracker& inbound, 
+      Side& side, 
+      typename Side::iterator resting);
+
   /// @brief match an inbound with a current order
   virtual bool matches(const Tracker& inbound_order, 
                        const Price& inbound_price, 
@@ -170,29 +752,258 @@ protected:
                        const Tracker& current_order,
                        const Price& current_price,
                        bool inbound_is_buy);
+
+  /// @brief copy a resting order of another book into this one, behind 
+  ///        the orders at its price.  Used by forks of a book.
+  /// @param price the price level of the order
+  /// @param tracker the order in the other book
+  void copy_resting(Price price, const Tracker& tracker);
+
+  /// @brief copy the pegged orders and untriggered stops of another book 
+  ///        into this one, with its transaction ID, last trade price, time
+  ///        and self-trade prevention.  Used by forks of a book.
+  /// @param other the other book
+  void copy_held(const OrderBook& other);
+
+  /// @brief get the price an order is sorted at on its side of the book
+  Price sort_price(const OrderPtr& order) const;
+
 private:
   Bids bids_;
   Asks asks_;
-  DeferredBidCrosses deferred_bid_crosses_;
-  DeferredAskCrosses deferred_ask_crosses_;
+  BidTotals bid_totals_;
+  AskTotals ask_totals_;
+  BidLevel level_bids_;
+  AskLevel level_asks_;
+  std::vector<Quantity> level_qtys_;
+  std::vector<Quantity> level_allocations_;
   Callbacks callbacks_;
   TypedOrderBookListener* book_listener_;
   TypedOrderListener* order_listener_;
   TransId trans_id_;
-
-  Price sort_price(const OrderPtr& order);
+  bool in_auction_;
+  PriceLadder ladder_;
+  IndicativeUncross uncross_;
+  OrderPtrs mass_cancelled_;
+  Callbacks mass_quoted_;
+  bool quoting_;
+  StopBids stop_bids_;
+  StopAsks stop_asks_;
+  TriggeredStops triggered_stops_;
+  Price last_trade_price_;
+  SelfTradePrevention self_trade_prevention_;
+  ExpiryWheel expiries_;
+  OrderPtrs expired_;
+
+  // The place of each pegged order in its queue
+  typedef std::map<OrderPtr, typename PeggedOrders::iterator> PegPlaces;
+
+  // Pegged orders of a side and type, with their depth as last published
+  struct PegQueue {
+    PegQueue() : order_count(0), open_qty(0) 
+    {
+      published.price = 0;
+      published.order_count = 0;
+      published.qty = 0;
+    }
+    // A copy finds the places of its own orders
+    PegQueue(const PegQueue& rhs)
+    : orders(rhs.orders), 
+      order_count(rhs.order_count), 
+      open_qty(rhs.open_qty), 
+      published(rhs.published)
+    {
+      find_places();
+    }
+    PegQueue& operator=(const PegQueue& rhs)
+    {
+      if (this != &rhs) {
+        orders = rhs.orders;
+        order_count = rhs.order_count;
+        open_qty = rhs.open_qty;
+        published = rhs.published;
+        find_places();
+      }
+      return *this;
+    }
+    void find_places()
+    {
+      places.clear();
+      typename PeggedOrders::iterator order;
+      for (order = orders.begin(); order != orders.end(); ++order) {
+        places.insert(std::make_pair(order->ptr(), order));
+      }
+    }
+    PeggedOrders orders;
+    PegPlaces places;
+    uint32_t order_count;
+    Quantity open_qty;
+    PeggedDepth published;
+  };
+  PegQueue peg_queues_[4];
+  bool pegged_depth_;
+  uint64_t book_hash_;
+
+  static int peg_index(bool is_buy, PegType peg_type)
+  {
+    return (is_buy ? 0 : 2) + (peg_type == peg_midpoint ? 1 : 0);
+  }
+  PegQueue& peg_queue(bool is_buy, PegType peg_type)
+  {
+    return peg_queues_[peg_index(is_buy, peg_type)];
+  }
+  void push_peg(PegQueue& queue, const Tracker& pegged);
+  typename PeggedOrders::iterator find_peg(PegQueue& queue, 
+                                           const OrderPtr& order);
+  typename PeggedOrders::iterator erase_peg(
+      PegQueue& queue, 
+      typename PeggedOrders::iterator resting);
+  bool erase_pegged_order(const OrderPtr& order);
+  void sync_peg(PegQueue& queue, Tracker& pegged);
+  typename PeggedOrders::iterator prevent_peg_self_trade(
+      Tracker& inbound, 
+      PegQueue& queue, 
+      typename PeggedOrders::iterator resting);
+  bool replace_peg(const OrderPtr& order, int32_t size_delta, Price new_price);
+  void mass_cancel_pegs(bool is_buy, 
+                        OwnerId owner, 
+                        Price low_price, 
+                        Price high_price);
+  bool cross_midpoint_pegs();
+  void prevent_midpoint_self_trade(PegQueue& bids, PegQueue& asks);
+  void reduce_front_peg(PegQueue& queue, Quantity qty);
+  void publish_pegged_depth(bool is_buy, PegType peg_type);
+  void reprice_pegs();
+
+  static Tracker copy_tracker(const Tracker& tracker);
   bool add_order(Tracker& order_tracker, Price order_price);
+  bool replace_order(const OrderPtr& order, 
+                     int32_t size_delta, 
+                     Price new_price,
+                     bool& matched);
+  template <class Side>
+  bool replace_resting(Side& side,
+                       typename Side::iterator resting,
+                       int32_t size_delta,
+                       Price new_price);
+  bool opposite_reaches(bool is_buy, Price price) const;
+  void push_replace(const OrderPtr& order, 
+                    Quantity new_order_qty, 
+                    Price new_price);
+  void change_ladder_qty(const Tracker& tracker, 
+                         Price price, 
+                         bool is_buy,
+                         int32_t qty_delta);
+  void publish_uncross();
+  bool stop_triggered(bool is_buy, Price stop_price) const;
+  void trigger_stops();
+  template <class Stops>
+  bool replace_stop(Stops& stops,
+                    const OrderPtr& order,
+                    int32_t size_delta,
+                    Price new_price);
 };
 
 template <class OrderPtr>
 inline
 OrderTracker<OrderPtr>::OrderTracker(
   const OrderPtr& order, 
-  OrderConditions conditions)
+  OrderConditions conditions,
+  TransId entry_trans)
 : order_(order),
-  open_qty_(order_->open_qty()),
-  conditions_(conditions)
+  detail_(NULL),
+  open_qty_(order->open_qty()),
+  price_(order->price()),
+  conditions_(order->is_buy() ? (conditions | BUY_FLAG) : conditions),
+  owner_(order->owner()),
+  level_qty_(0),
+  filled_qty_(0),
+  hashed_qty_(0),
+  entry_trans_(entry_trans)
+{
+  const Quantity min_qty = 
+      (conditions & oc_minimum_qty) ? order->min_qty() : 0;
+  if (order->display_qty() || min_qty) {
+    detail_ = new Detail;
+    detail_->display_qty = order->display_qty();
+    detail_->min_qty = min_qty;
+  }
+}
+
+template <class OrderPtr>
+inline
+OrderTracker<OrderPtr>::OrderTracker()
+: order_(),
+  detail_(NULL),
+  open_qty_(0),
+  price_(0),
+  conditions_(0),
+  owner_(0),
+  level_qty_(0),
+  filled_qty_(0),
+  hashed_qty_(0),
+  entry_trans_(0)
+{
+}
+
+template <class OrderPtr>
+inline
+OrderTracker<OrderPtr>::OrderTracker(const OrderTracker& rhs)
+: order_(rhs.order_),
+  detail_(rhs.detail_ ? new Detail(*rhs.detail_) : NULL),
+  open_qty_(rhs.open_qty_),
+  price_(rhs.price_),
+  conditions_(rhs.conditions_),
+  owner_(rhs.owner_),
+  level_qty_(rhs.level_qty_),
+  filled_qty_(rhs.filled_qty_),
+  hashed_qty_(rhs.hashed_qty_),
+  entry_trans_(rhs.entry_trans_)
+{
+}
+
+template <class OrderPtr>
+inline OrderTracker<OrderPtr>&
+OrderTracker<OrderPtr>::operator=(const OrderTracker& rhs)
+{
+  if (this != &rhs) {
+    Detail* detail = rhs.detail_ ? new Detail(*rhs.detail_) : NULL;
+    delete detail_;
+    detail_ = detail;
+    order_ = rhs.order_;
+    open_qty_ = rhs.open_qty_;
+    price_ = rhs.price_;
+    conditions_ = rhs.conditions_;
+    owner_ = rhs.owner_;
+    level_qty_ = rhs.level_qty_;
+    filled_qty_ = rhs.filled_qty_;
+    hashed_qty_ = rhs.hashed_qty_;
+    entry_trans_ = rhs.entry_trans_;
+  }
+  return *this;
+}
+
+template <class OrderPtr>
+inline
+OrderTracker<OrderPtr>::~OrderTracker()
+{
+  delete detail_;
+}
+
+template <class OrderPtr>
+inline void
+OrderTracker<OrderPtr>::swap(OrderTracker& rhs)
 {
+  std::swap(order_, rhs.order_);
+  std::swap(detail_, rhs.detail_);
+  std::swap(open_qty_, rhs.open_qty_);
+  std::swap(price_, rhs.price_);
+  std::swap(conditions_, rhs.conditions_);
+  std::swap(owner_, rhs.owner_);
+  std::swap(level_qty_, rhs.level_qty_);
+  std::swap(filled_qty_, rhs.filled_qty_);
+  std::swap(hashed_qty_, rhs.hashed_qty_);
+  std::swap(entry_trans_, rhs.entry_trans_);
 }
 
 template <class OrderPtr>
@@ -205,6 +1016,15 @@ OrderTracker<OrderPtr>::change_qty(int32_t delta)
         std::runtime_error("Replace size reduction larger than open quantity");
   }
   open_qty_ += delta;
+  // Change the reserve of an iceberg first, then what is visible
+  if (detail_) {
+    if (delta > 0 && detail_->display_qty) {
+      detail_->reserve_qty += delta;
+    } else if (delta < 0) {
+      detail_->reserve_qty -= std::min(detail_->reserve_qty, 
+                                       Quantity(std::abs(delta)));
+    }
+  }
 }
 
 template <class OrderPtr>
@@ -215,6 +1035,34 @@ OrderTracker<OrderPtr>::fill(Quantity qty)
     throw std::runtime_error("Fill size larger than open quantity");
   }
   open_qty_ -= qty;
+  filled_qty_ += qty;
+  // An inbound iceberg may fill beyond its visible quantity
+  if (detail_ && detail_->reserve_qty > open_qty_) {
+    detail_->reserve_qty = open_qty_;
+  }
+}
+
+template <class OrderPtr>
+inline void
+OrderTracker<OrderPtr>::reduce(Quantity qty) 
+{
+  if (qty > open_qty_) {
+    throw std::runtime_error("Reduce size larger than open quantity");
+  }
+  open_qty_ -= qty;
+  if (detail_ && detail_->reserve_qty > open_qty_) {
+    detail_->reserve_qty = open_qty_;
+  }
+}
+
+template <class OrderPtr>
+inline void
+OrderTracker<OrderPtr>::refresh()
+{
+  if (detail_ && detail_->display_qty) {
+    detail_->reserve_qty = 
+        open_qty_ - std::min(detail_->display_qty, open_qty_);
+  }
 }
 
 template <class OrderPtr>
@@ -228,7 +1076,7 @@ template <class OrderPtr>
 inline Quantity
 OrderTracker<OrderPtr>::filled_qty() const
 {
-  return order_->order_qty() - open_qty();
+  return filled_qty_;
 }
 
 template <class OrderPtr>
@@ -238,6 +1086,41 @@ OrderTracker<OrderPtr>::open_qty() const
   return open_qty_;
 }
 
+template <class OrderPtr>
+inline Quantity
+OrderTracker<OrderPtr>::visible_qty() const
+{
+  return detail_ ? open_qty_ - detail_->reserve_qty : open_qty_;
+}
+
+template <class OrderPtr>
+inline Quantity
+OrderTracker<OrderPtr>::reserve_qty() const
+{
+  return detail_ ? detail_->reserve_qty : 0;
+}
+
+template <class OrderPtr>
+inline Price
+OrderTracker<OrderPtr>::price() const
+{
+  return price_;
+}
+
+template <class OrderPtr>
+inline void
+OrderTracker<OrderPtr>::set_price(Price price)
+{
+  price_ = price;
+}
+
+template <class OrderPtr>
+inline bool
+OrderTracker<OrderPtr>::is_buy() const
+{
+  return (conditions_ & BUY_FLAG) != 0;
+}
+
 template <class OrderPtr>
 inline const OrderPtr&
 OrderTracker<OrderPtr>::ptr() const
@@ -267,17 +1150,118 @@ OrderTracker<OrderPtr>::immediate_or_cancel() const
 }
 
 template <class OrderPtr>
-OrderBook<OrderPtr>::OrderBook()
+inline bool
+OrderTracker<OrderPtr>::iceberg() const
+{
+  return detail_ && detail_->display_qty != 0;
+}
+
+template <class OrderPtr>
+inline Quantity
+OrderTracker<OrderPtr>::required_qty() const
+{
+  if (all_or_none()) {
+    return open_qty_;
+  }
+  return detail_ ? std::min(detail_->min_qty, open_qty_) : 0;
+}
+
+template <class OrderPtr>
+inline void
+OrderTracker<OrderPtr>::clear_min_qty()
+{
+  if (detail_) {
+    detail_->min_qty = 0;
+  }
+}
+
+template <class OrderPtr>
+inline OwnerId
+OrderTracker<OrderPtr>::owner() const
+{
+  return owner_;
+}
+
+template <class OrderPtr>
+inline TimerId
+OrderTracker<OrderPtr>::timer() const
+{
+  return detail_ ? detail_->timer : 0;
+}
+
+template <class OrderPtr>
+inline void
+OrderTracker<OrderPtr>::set_timer(TimerId timer)
+{
+  if (!detail_) {
+    if (!timer) {
+      return;
+    }
+    detail_ = new Detail;
+  }
+  detail_->timer = timer;
+}
+
+template <class OrderPtr>
+inline Quantity
+OrderTracker<OrderPtr>::level_qty() const
+{
+  return level_qty_;
+}
+
+template <class OrderPtr>
+inline void
+OrderTracker<OrderPtr>::set_level_qty(Quantity qty)
+{
+  level_qty_ = qty;
+}
+
+template <class OrderPtr>
+inline OrderConditions
+OrderTracker<OrderPtr>::conditions() const
+{
+  return conditions_ & ~BUY_FLAG;
+}
+
+template <class OrderPtr>
+inline TransId
+OrderTracker<OrderPtr>::entry_trans() const
+{
+  return entry_trans_;
+}
+
+template <class OrderPtr>
+inline Quantity
+OrderTracker<OrderPtr>::hashed_qty() const
+{
+  return hashed_qty_;
+}
+
+template <class OrderPtr>
+inline void
+OrderTracker<OrderPtr>::set_hashed_qty(Quantity qty)
+{
+  hashed_qty_ = qty;
+}
+
+template <class OrderPtr, class MatchPolicy>
+OrderBook<OrderPtr, MatchPolicy>::OrderBook()
 : book_listener_(NULL),
   order_listener_(NULL),
-  trans_id_(0)
+  trans_id_(0),
+  in_auction_(false),
+  quoting_(false),
+  last_trade_price_(0),
+  self_trade_prevention_(stp_cancel_newest),
+  pegged_depth_(false),
+  book_hash_(0)
 {
   callbacks_.reserve(16);
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline bool
-OrderBook<OrderPtr>::add(const OrderPtr& order, OrderConditions conditions)
+OrderBook<OrderPtr, MatchPolicy>::add(const OrderPtr& order, OrderConditions conditions)
 {
   // Increment transacion ID
   ++trans_id_;  
@@ -289,103 +1273,243 @@ OrderBook<OrderPtr>::add(const OrderPtr& order, OrderConditions conditions)
     // reject created by is_valid
   } else {
     callbacks_.push_back(TypedCallback::accept(order, trans_id_));
-    TypedCallback& accept_cb = callbacks_.back();
 
-    Price order_price = sort_price(order);
+    Tracker inbound(order, conditions, trans_id_);
+    // If this is a stop order yet to be triggered, hold it
+    if (order->stop_price() && 
+        !stop_triggered(order->is_buy(), order->stop_price())) {
+      if (order->expire_time()) {
+        inbound.set_timer(expiries_.schedule(order->expire_time(), order));
+      }
+      const Price stop_price = order->stop_price();
+      Tracker& stop = order->is_buy() ?
+          stop_bids_.insert(std::make_pair(stop_price, inbound))->second :
+          stop_asks_.insert(std::make_pair(stop_price, inbound))->second;
+      change_hash(stop_price, stop, stop.open_qty(), hash_stop);
+    } else {
+      // A stop order triggered on arrival enters the book immediately
+      if (order->stop_price()) {
+        callbacks_.push_back(TypedCallback::trigger(order, trans_id_));
+      }
+      // Note the callback by index, adding fills may grow the container
+      typename Callbacks::size_type entry_cb = callbacks_.size() - 1;
 
-    Tracker inbound(order, conditions);
-    matched = add_order(inbound, order_price);
-    if (matched) {
-      // Note the filled qty in the callback
-      accept_cb.match_qty = inbound.filled_qty();
+      Price order_price = sort_price(order);
+      matched = add_order(inbound, order_price);
+      if (matched) {
+        // Note the filled qty in the callback
+        callbacks_[entry_cb].match_qty = inbound.filled_qty();
+      }
+      // Cancel any unfilled IOC order
+      if (inbound.immediate_or_cancel() && !inbound.filled()) {
+        callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
+      }
+      if (matched) {
+        trigger_stops();
+      }
     }
-    // Cancel any unfilled IOC order
-    if (inbound.immediate_or_cancel() && !inbound.filled()) {
-      callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
+    reprice_pegs();
+    if (in_auction_) {
+      publish_uncross();
     }
   }
   return matched;
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline void
-OrderBook<OrderPtr>::cancel(const OrderPtr& order)
+OrderBook<OrderPtr, MatchPolicy>::cancel(const OrderPtr& order)
 {
   // Increment transacion ID
   ++trans_id_;  
 
-  bool found = false;
-  // If the cancel is a buy order
-  if (order->is_buy()) {
-    typename Bids::iterator bid;
-    find_bid(order, bid);
-    if (bid != bids_.end()) {
-      // Remove from container for cancel
-      bids_.erase(bid);
-      found = true;
-    }
-  // Else the cancel is a sell order
-  } else {
-    typename Asks::iterator ask;
-    find_ask(order, ask);
-    if (ask != asks_.end()) {
-      // Remove from container for cancel
-      asks_.erase(ask);
-      found = true;
-    }
-  } 
   // If the cancel was found, issue callback
-  if (found) {
+  if (erase_order(order)) {
     callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
+    reprice_pegs();
+    if (in_auction_) {
+      publish_uncross();
+    }
   } else {
     callbacks_.push_back(
         TypedCallback::cancel_reject(order, "not found", trans_id_));
   }
 }
 
-template <class OrderPtr>
-inline bool
-OrderBook<OrderPtr>::replace(
-  const OrderPtr& order, 
-  int32_t size_delta,
-  Price new_price)
+template <class OrderPtr, class MatchPolicy>
+inline uint32_t
+OrderBook<OrderPtr, MatchPolicy>::advance_time(Timestamp now)
 {
   // Increment transacion ID
   ++trans_id_;  
 
-  bool matched = false;
-  bool found = false;
-  bool price_change = new_price && (new_price != order->price());
+  expired_.clear();
+  expiries_.advance(now, expired_);
+
+  // Every expired order is still in the book, as leaving it cancels the
+  // timer
+  uint32_t expired_count = 0;
+  typename OrderPtrs::iterator order;
+  for (order = expired_.begin(); order != expired_.end(); ++order) {
+    if (erase_order(*order)) {
+      callbacks_.push_back(TypedCallback::cancel(*order, trans_id_));
+      ++expired_count;
+    }
+  }
+  if (expired_count) {
+    reprice_pegs();
+    if (in_auction_) {
+      publish_uncross();
+    }
+  }
+  return expired_count;
+}
 
-  Price price = (new_price == PRICE_UNCHANGED) ? order->price() : new_price;
-  // TODO can we use value in tracker?
-  Quantity new_order_qty = order->order_qty() + size_delta;
+template <class OrderPtr, class MatchPolicy>
+inline uint32_t
+OrderBook<OrderPtr, MatchPolicy>::mass_cancel(
+  OwnerId owner,
+  bool cancel_bids,
+  bool cancel_asks,
+  Price low_price,
+  Price high_price)
+{
+  // Increment transacion ID
+  ++trans_id_;  
 
-  // If the order to replace is a buy order
-  if (order->is_buy()) {
-    typename Bids::iterator bid;
-    find_bid(order, bid);
-    // If the order was found
-    if (bid != bids_.end()) {
-      found = true;
-      // If this is a valid replace
-      if (is_valid_replace(bid->second, size_delta, new_price)) {
-        // Accept the replace
-        callbacks_.push_back(
-            TypedCallback::replace(order, new_order_qty, price, trans_id_));
-        Quantity new_open_qty = bid->second.open_qty() + size_delta;
-        bid->second.change_qty(size_delta);  // Update my copy
-        // If the size change will close the order
-        if (!new_open_qty) {
-          callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
-          bids_.erase(bid); // Remove order
-        // Else rematch the new order - there could be a price change
-        // or size change - that could cause all or none match
-        } else {
-          matched = add_order(bid->second, price); // Add order
-          bids_.erase(bid); // Remove order
-        }
-      }
+  const uint32_t cancel_begin = mass_cancelled_.size();
+  // Limit the search of the book to the levels in the price range
+  if (cancel_bids) {
+    mass_cancel_side(bids_, 
+                     high_price ? bids_.lower_bound(high_price) 
+                                : bids_.begin(),
+                     low_price ? bids_.upper_bound(low_price) : bids_.end(),
+                     owner, low_price, high_price, in_auction_, false);
+    mass_cancel_side(stop_bids_, stop_bids_.begin(), stop_bids_.end(),
+                     owner, low_price, high_price, false, true);
+    mass_cancel_pegs(true, owner, low_price, high_price);
+  }
+  if (cancel_asks) {
+    mass_cancel_side(asks_, 
+                     low_price ? asks_.lower_bound(low_price) : asks_.begin(),
+                     high_price ? asks_.upper_bound(high_price) : asks_.end(),
+                     owner, low_price, high_price, in_auction_, false);
+    mass_cancel_side(stop_asks_, stop_asks_.begin(), stop_asks_.end(),
+                     owner, low_price, high_price, false, true);
+    mass_cancel_pegs(false, owner, low_price, high_price);
+  }
+
+  const uint32_t cancel_count = mass_cancelled_.size() - cancel_begin;
+  if (cancel_count) {
+    callbacks_.push_back(
+        TypedCallback::mass_cancel(cancel_begin, cancel_count, trans_id_));
+    reprice_pegs();
+    if (in_auction_) {
+      publish_uncross();
+    }
+  }
+  return cancel_count;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::replace(
+  const OrderPtr& order, 
+  int32_t size_delta,
+  Price new_price)
+{
+  // Increment transacion ID
+  ++trans_id_;  
+
+  bool matched = false;
+  bool found = replace_order(order, size_delta, new_price, matched);
+
+  if (matched) {
+    trigger_stops();
+  }
+
+  if (!found) {
+    callbacks_.push_back(
+        TypedCallback::replace_reject(order, "not found", trans_id_));
+  } else {
+    reprice_pegs();
+    if (in_auction_) {
+      publish_uncross();
+    }
+  }
+
+  return matched;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::mass_quote(const TypedQuote* quotes,
+                                             uint32_t quote_count)
+{
+  // Increment transacion ID
+  ++trans_id_;  
+
+  // The quotes' replaces are gathered into one callback, ahead of any 
+  // fills or cancels they cause
+  const typename Callbacks::size_type quote_cb = callbacks_.size();
+  const uint32_t quote_begin = mass_quoted_.size();
+  callbacks_.push_back(TypedCallback::mass_quote(quote_begin, 0, trans_id_));
+
+  bool matched = false;
+  bool found = false;
+  quoting_ = true;
+  for (uint32_t index = 0; index < quote_count; ++index) {
+    const TypedQuote& quote = quotes[index];
+    if (replace_order(quote.order, quote.size_delta, quote.new_price, 
+                      matched)) {
+      found = true;
+    } else {
+      callbacks_.push_back(TypedCallback::replace_reject(
+          quote.order, "not found", trans_id_));
+    }
+  }
+  quoting_ = false;
+
+  const uint32_t replace_count = mass_quoted_.size() - quote_begin;
+  if (replace_count) {
+    callbacks_[quote_cb].quote_count = replace_count;
+  } else {
+    callbacks_.erase(callbacks_.begin() + quote_cb);
+  }
+
+  if (matched) {
+    trigger_stops();
+  }
+  if (found) {
+    reprice_pegs();
+    if (in_auction_) {
+      publish_uncross();
+    }
+  }
+  return matched;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::replace_order(
+  const OrderPtr& order, 
+  int32_t size_delta,
+  Price new_price,
+  bool& matched)
+{
+  bool found = false;
+
+  // If the order to replace is pegged, it has no price to change
+  if (order->peg_type() != peg_none) {
+    found = replace_peg(order, size_delta, new_price);
+  // Else if the order to replace is a buy order
+  } else if (order->is_buy()) {
+    typename Bids::iterator bid;
+    find_bid(order, bid);
+    // If the order was found
+    if (bid != bids_.end()) {
+      found = true;
+      matched = replace_resting(bids_, bid, size_delta, new_price) || matched;
     }
   // Else the order to replace is a sell order
   } else {
@@ -394,199 +1518,448 @@ OrderBook<OrderPtr>::replace(
     // If the order was found
     if (ask != asks_.end()) {
       found = true;
-      // If this is a valid replace
-      if (is_valid_replace(ask->second, size_delta, new_price)) {
-        // Accept the replace
-        callbacks_.push_back(
-            TypedCallback::replace(order, new_order_qty, price, trans_id_));
-        Quantity new_open_qty = ask->second.open_qty() + size_delta;
-        ask->second.change_qty(size_delta);  // Update my copy
-        // If the size change will close the order
-        if (!new_open_qty) {
-          callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
-          asks_.erase(ask); // Remove order
-        // Else rematch the new order if there is a price change or the order
-        // is all or none (for which a size change could cause it to match)
-        } else if (price_change || ask->second.all_or_none()) {
-          matched = add_order(ask->second, price); // Add order
-          asks_.erase(ask); // Remove order
-        }
+      matched = replace_resting(asks_, ask, size_delta, new_price) || matched;
+    }
+  }
+
+  // If not in the book, the order may be an untriggered stop
+  if (!found && order->stop_price()) {
+    if (order->is_buy()) {
+      found = replace_stop(stop_bids_, order, size_delta, new_price);
+    } else {
+      found = replace_stop(stop_asks_, order, size_delta, new_price);
+    }
+  }
+  return found;
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::replace_resting(
+  Side& side,
+  typename Side::iterator resting,
+  int32_t size_delta,
+  Price new_price)
+{
+  Tracker& tracker = resting->second;
+  const OrderPtr order = tracker.ptr();
+  const bool is_buy = order->is_buy();
+  // If this is not a valid replace, the reject is created by is_valid_replace
+  if (!is_valid_replace(tracker, size_delta, new_price)) {
+    return false;
+  }
+
+  // Accept the replace
+  const bool price_change = new_price && (new_price != tracker.price());
+  const Price price = 
+      (new_price == PRICE_UNCHANGED) ? tracker.price() : new_price;
+  push_replace(order, order->order_qty() + size_delta, price);
+
+  // If the size change will close the order
+  if (tracker.open_qty() + size_delta == 0) {
+    if (in_auction_) {
+      change_ladder_qty(tracker, resting->first, is_buy, 
+                        -(int32_t)tracker.open_qty());
+    }
+    tracker.change_qty(size_delta);
+    callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
+    unschedule(tracker);
+    leave_level(resting->first, tracker);
+    side.erase(resting);
+    return false;
+  }
+
+  // If the price is unchanged and the order can not match at it, amend the
+  // order in place.  It keeps its time priority if its size does not grow,
+  // else it goes to the back of its level.
+  if (!price_change && 
+      (in_auction_ || !opposite_reaches(is_buy, resting->first))) {
+    if (in_auction_) {
+      change_ladder_qty(tracker, resting->first, is_buy, size_delta);
+    }
+    tracker.change_qty(size_delta);
+    sync_level(resting->first, tracker);
+    if (tracker.iceberg()) {
+      callbacks_.push_back(TypedCallback::display(
+          order, tracker.visible_qty(), trans_id_));
+    }
+    if (size_delta > 0) {
+      requeue(side, resting);
+    }
+    return false;
+  }
+
+  // Else rematch the order at its new price
+  if (in_auction_) {
+    change_ladder_qty(tracker, resting->first, is_buy, 
+                      -(int32_t)tracker.open_qty());
+  }
+  tracker.change_qty(size_delta);
+  leave_level(resting->first, tracker);
+  tracker.set_price(price);
+  const bool matched = add_order(tracker, price);
+  side.erase(resting);
+  return matched;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::opposite_reaches(bool is_buy, 
+                                                   Price price) const
+{
+  if (is_buy) {
+    return !ask_totals_.empty() && ask_totals_.begin()->first <= price;
+  } else {
+    return !bid_totals_.empty() && bid_totals_.begin()->first >= price;
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::push_replace(const OrderPtr& order,
+                                               Quantity new_order_qty,
+                                               Price new_price)
+{
+  TypedCallback cb = 
+      TypedCallback::replace(order, new_order_qty, new_price, trans_id_);
+  if (quoting_) {
+    mass_quoted_.push_back(cb);
+  } else {
+    callbacks_.push_back(cb);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline Price
+OrderBook<OrderPtr, MatchPolicy>::pegged_price(bool is_buy, 
+                                               PegType peg_type) const
+{
+  const Price bid = best_bid();
+  const Price ask = best_ask();
+  if (peg_type == peg_primary) {
+    return is_buy ? bid : ask;
+  } else if (peg_type == peg_midpoint && bid && ask) {
+    // Round toward the order's own side, so that midpoint pegs of the two
+    // sides meet only when the spread is even
+    const uint64_t sum = uint64_t(bid) + ask;
+    return Price(is_buy ? (sum / 2) : ((sum + 1) / 2));
+  }
+  return 0;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::match_inbound(Tracker& inbound, 
+                                                Price inbound_price)
+{
+  bool matched = false;
+  const bool is_buy = inbound.is_buy();
+
+  // Orders with a required quantity do not match pegged orders, which are
+  // not counted in the level totals.  Midpoint pegs are priced at least as
+  // well as primary pegs, so match first.
+  if (!inbound.required_qty()) {
+    const PegType peg_types[] = { peg_midpoint, peg_primary };
+    Price peg_prices[2];
+    for (int index = 0; index < 2; ++index) {
+      peg_prices[index] = pegged_price(!is_buy, peg_types[index]);
+    }
+    for (int index = 0; index < 2 && !inbound.filled(); ++index) {
+      const Price peg_price = peg_prices[index];
+      if (!peg_price || 
+          peg_queue(!is_buy, peg_types[index]).orders.empty()) {
+        continue;
       }
-    } 
+      // If the inbound order does not reach the pegged price, stop
+      if (is_buy ? (inbound_price < peg_price) 
+                 : (inbound_price > peg_price)) {
+        break;
+      }
+      // Match the book's orders at or better than the pegged price first
+      if (is_buy) {
+        matched = match_order(inbound, peg_price, asks_) || matched;
+      } else {
+        matched = match_order(inbound, peg_price, bids_) || matched;
+      }
+      if (!inbound.filled()) {
+        matched = match_pegs(inbound, !is_buy, peg_types[index], peg_price) ||
+                  matched;
+      }
+    }
+  }
 
-    if (!found) {
-      callbacks_.push_back(
-          TypedCallback::replace_reject(order, "not found", trans_id_));
+  // Match the rest of the book
+  if (!inbound.filled()) {
+    if (is_buy) {
+      matched = match_order(inbound, inbound_price, asks_) || matched;
+    } else {
+      matched = match_order(inbound, inbound_price, bids_) || matched;
     }
   }
+  return matched;
+}
 
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::match_pegs(Tracker& inbound,
+                                             bool is_buy,
+                                             PegType peg_type,
+                                             Price peg_price)
+{
+  bool matched = false;
+  PegQueue& queue = peg_queue(is_buy, peg_type);
+  typename PeggedOrders::iterator resting = queue.orders.begin();
+  while (resting != queue.orders.end() && !inbound.filled()) {
+    // If both orders have the same owner, prevent the self-trade
+    if (inbound.owner() && (inbound.owner() == resting->owner())) {
+      resting = prevent_peg_self_trade(inbound, queue, resting);
+      continue;
+    }
+    const Quantity fill_qty = std::min(inbound.open_qty(), 
+                                       resting->open_qty());
+    cross_orders(inbound, *resting, peg_price, fill_qty);
+    queue.open_qty -= fill_qty;
+    sync_peg(queue, *resting);
+    matched = true;
+    if (resting->filled()) {
+      resting = erase_peg(queue, resting);
+    } else {
+      ++resting;
+    }
+  }
   return matched;
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline bool
-OrderBook<OrderPtr>::match_order(Tracker& inbound, 
+OrderBook<OrderPtr, MatchPolicy>::match_order(Tracker& inbound, 
                                  const Price& inbound_price, 
                                  Bids& bids)
 {
+  // An all or none order matches only if it can be filled completely, and
+  // an order with a minimum quantity only if it can fill that much
+  const Quantity required_qty = inbound.required_qty();
+  if (required_qty && 
+      !can_fill(inbound, inbound_price, bids, bid_totals_, required_qty)) {
+    return false;
+  }
+
+  // If the policy allocates across a level.  All or none inbound orders
+  // match in time priority, as they fill completely or not at all.
+  if (MatchPolicy::allocates_level && !inbound.all_or_none()) {
+    return match_levels(inbound, inbound_price, bids, level_bids_);
+  }
+
   bool matched = false;
   typename Bids::iterator bid;
-  Quantity matched_qty = 0;
-  Quantity inbound_qty = inbound.open_qty();
 
   for (bid = bids.begin(); bid != bids.end(); ) {
     // If the inbound order matches the current order
     if (matches(inbound, 
                 inbound_price, 
-                inbound.open_qty() - matched_qty, 
+                inbound.open_qty(), 
                 bid->second, 
                 bid->first, 
                 false)) {
-      // If the inbound order is an all or none order
-      if (inbound.all_or_none()) {
-        // Track how much of the inbound order has been matched
-        matched_qty += bid->second.ptr()->open_qty();
-        // If we have matched enough quantity to fill the inbound order
-        if (matched_qty >= inbound_qty) {
-          matched =  true;
-
-          // Unwind the deferred crosses
-          typename DeferredBidCrosses::iterator dbc;
-          for (dbc = deferred_bid_crosses_.begin(); 
-               dbc != deferred_bid_crosses_.end(); ++dbc) {
-            // Adjust tracking values for cross
-            cross_orders(inbound, (*dbc)->second);
-
-            // If the existing order was filled, remove it
-            if ((*dbc)->second.filled()) {
-              bids.erase(*dbc);
-            }
-          }
-        // Else we have to defer crossing this order
-        } else {
-          deferred_bid_crosses_.push_back(bid);
-          ++bid;
+      // If both orders have the same owner, prevent the self-trade
+      if (inbound.owner() && (inbound.owner() == bid->second.owner())) {
+        bid = prevent_self_trade(inbound, bids, bid);
+        // If the inbound order was cancelled, no more matches are possible
+        if (inbound.filled()) {
+          break;
         }
-      } else {
-        matched =  true;
+        continue;
       }
+      matched =  true;
 
-      if (matched) {
-        // Adjust tracking values for cross
-        cross_orders(inbound, bid->second);
+      // Adjust tracking values for cross
+      cross_orders(inbound, bid->second);
 
-        // If the existing order was filled, remove it
-        if (bid->second.filled()) {
-          bids.erase(bid++);
-        } else {
-          ++bid;
-        }
+      // Remove the existing order if filled, and move on
+      bid = settle_fill(bids, bid);
 
-        // if the inbound order is filled, no more matches are possible
-        if (inbound.filled()) {
-          break;
-        }
+      // if the inbound order is filled, no more matches are possible
+      if (inbound.filled()) {
+        break;
       }
     // Didn't match, exit loop if this was because of price
     } else if (bid->first < inbound_price) {
       break;
     } else {
-      ++bid;
+      bid = skip_unmatched(bids, bid_totals_, bid, inbound.open_qty());
     }
   }
 
   return matched;
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline bool
-OrderBook<OrderPtr>::match_order(Tracker& inbound, 
+OrderBook<OrderPtr, MatchPolicy>::match_order(Tracker& inbound, 
                                  const Price& inbound_price, 
                                  Asks& asks)
 {
+  // An all or none order matches only if it can be filled completely, and
+  // an order with a minimum quantity only if it can fill that much
+  const Quantity required_qty = inbound.required_qty();
+  if (required_qty && 
+      !can_fill(inbound, inbound_price, asks, ask_totals_, required_qty)) {
+    return false;
+  }
+
+  // If the policy allocates across a level.  All or none inbound orders
+  // match in time priority, as they fill completely or not at all.
+  if (MatchPolicy::allocates_level && !inbound.all_or_none()) {
+    return match_levels(inbound, inbound_price, asks, level_asks_);
+  }
+
   bool matched = false;
   typename Asks::iterator ask;
-  Quantity matched_qty = 0;
-  Quantity inbound_qty = inbound.open_qty();
 
   for (ask = asks.begin(); ask != asks.end(); ) {
     // If the inbound order matches the current order
     if (matches(inbound, 
                 inbound_price, 
-                inbound.open_qty() - matched_qty, 
+                inbound.open_qty(), 
                 ask->second, 
                 ask->first, 
                 true)) {
-      // If the inbound order is an all or none order
-      if (inbound.all_or_none()) {
-        // Track how much of the inbound order has been matched
-        matched_qty += ask->second.ptr()->open_qty();
-        // If we have matched enough quantity to fill the inbound order
-        if (matched_qty >= inbound_qty) {
-          matched =  true;
-
-          // Unwind the deferred crosses
-          typename DeferredAskCrosses::iterator dac;
-          for (dac = deferred_ask_crosses_.begin(); 
-               dac != deferred_ask_crosses_.end(); ++dac) {
-            // Adjust tracking values for cross
-            cross_orders(inbound, (*dac)->second);
-
-            // If the existing order was filled, remove it
-            if ((*dac)->second.filled()) {
-              asks.erase(*dac);
-            }
-          }
-        // Else we have to defer crossing this order
-        } else {
-          deferred_ask_crosses_.push_back(ask);
-          ++ask;
+      // If both orders have the same owner, prevent the self-trade
+      if (inbound.owner() && (inbound.owner() == ask->second.owner())) {
+        ask = prevent_self_trade(inbound, asks, ask);
+        // If the inbound order was cancelled, no more matches are possible
+        if (inbound.filled()) {
+          break;
         }
-      } else {
-        matched =  true;
+        continue;
       }
+      matched =  true;
 
-      if (matched) {
-        // Adjust tracking values for cross
-        cross_orders(inbound, ask->second);
+      // Adjust tracking values for cross
+      cross_orders(inbound, ask->second);
 
-        // If the existing order was filled, remove it
-        if (ask->second.filled()) {
-          asks.erase(ask++);
-        } else {
-          ++ask;
-        }
+      // Remove the existing order if filled, and move on
+      ask = settle_fill(asks, ask);
 
-        // if the inbound order is filled, no more matches are possible
-        if (inbound.filled()) {
-          break;
-        }
+      // if the inbound order is filled, no more matches are possible
+      if (inbound.filled()) {
+        break;
       }
     // Didn't match, exit loop if this was because of price
     } else if (ask->first > inbound_price) {
       break;
     } else {
-      ++ask;
+      ask = skip_unmatched(asks, ask_totals_, ask, inbound.open_qty());
     }
   }
   return matched;
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline void
-OrderBook<OrderPtr>::cross_orders(Tracker& inbound_tracker, 
-                                  Tracker& current_tracker)
+OrderBook<OrderPtr, MatchPolicy>::begin_auction(Price low_price, Price high_price)
 {
-  Quantity fill_qty = std::min(inbound_tracker.open_qty(), 
-                               current_tracker.open_qty());
-  Price cross_price = current_tracker.ptr()->price();
-  // If current order is a market order, cross at inbound price
-  if (MARKET_ORDER_PRICE == cross_price) {
-    cross_price = inbound_tracker.ptr()->price();
+  // Increment transacion ID
+  ++trans_id_;  
+
+  in_auction_ = true;
+  ladder_.reset(low_price, high_price);
+
+  // Count the orders already resting in the book
+  typename Bids::const_iterator bid;
+  for (bid = bids_.begin(); bid != bids_.end(); ++bid) {
+    change_ladder_qty(bid->second, bid->first, true, bid->second.open_qty());
+  }
+  typename Asks::const_iterator ask;
+  for (ask = asks_.begin(); ask != asks_.end(); ++ask) {
+    change_ladder_qty(ask->second, ask->first, false, ask->second.open_qty());
+  }
+  publish_uncross();
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::end_auction()
+{
+  // Increment transacion ID
+  ++trans_id_;  
+
+  bool matched = false;
+  if (in_auction_) {
+    in_auction_ = false;
+    const Price uncross_price = uncross_.price;
+
+    typename Bids::iterator bid = bids_.begin();
+    typename Asks::iterator ask = asks_.begin();
+    // While both the best bid and best ask can trade at the uncross price
+    while (uncross_.matched_qty &&
+           bid != bids_.end() && bid->first >= uncross_price &&
+           ask != asks_.end() && ask->first <= uncross_price) {
+      if (bid->second.all_or_none()) {
+        ++bid;
+      } else if (ask->second.all_or_none()) {
+        ++ask;
+      } else {
+        // Both orders are resting, so neither fills beyond what it shows
+        cross_orders(bid->second, ask->second, uncross_price,
+                     std::min(bid->second.visible_qty(), 
+                              ask->second.visible_qty()));
+        matched = true;
+        // Move past an order once filled or its visible slice is used up,
+        // else it matches again where it is
+        if (bid->second.filled() || !bid->second.visible_qty()) {
+          bid = settle_fill(bids_, bid);
+        } else {
+          settle_fill(bids_, bid);
+        }
+        if (ask->second.filled() || !ask->second.visible_qty()) {
+          ask = settle_fill(asks_, ask);
+        } else {
+          settle_fill(asks_, ask);
+        }
+      }
+    }
+    ladder_ = PriceLadder();
+    uncross_ = IndicativeUncross();
+  }
+  if (matched) {
+    trigger_stops();
   }
-  
+  reprice_pegs();
+  return matched;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::cross_orders(Tracker& inbound_tracker, 
+                                  Tracker& current_tracker)
+{
+  cross_orders(inbound_tracker, current_tracker, 
+               cross_price(inbound_tracker, current_tracker));
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::cross_orders(Tracker& inbound_tracker, 
+                                  Tracker& current_tracker,
+                                  Price cross_price)
+{
+  cross_orders(inbound_tracker, current_tracker, cross_price,
+               std::min(inbound_tracker.open_qty(), 
+                        current_tracker.visible_qty()));
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::cross_orders(Tracker& inbound_tracker, 
+                                  Tracker& current_tracker,
+                                  Price cross_price,
+                                  Quantity fill_qty)
+{
   inbound_tracker.fill(fill_qty);
   current_tracker.fill(fill_qty);
+  last_trade_price_ = cross_price;
   callbacks_.push_back(TypedCallback::fill(inbound_tracker.ptr(),
                                            current_tracker.ptr(),
                                            fill_qty,
@@ -594,37 +1967,280 @@ OrderBook<OrderPtr>::cross_orders(Tracker& inbound_tracker,
                                            trans_id_));
 }
 
-template <class OrderPtr>
-inline void
-OrderBook<OrderPtr>::perform_callbacks()
+template <class OrderPtr, class MatchPolicy>
+inline Price
+OrderBook<OrderPtr, MatchPolicy>::cross_price(
+  const Tracker& inbound_tracker, 
+  const Tracker& current_tracker) const
 {
-  typename Callbacks::iterator cb;
-  for (cb = callbacks_.begin(); cb != callbacks_.end(); ++cb) {
-    perform_callback(*cb);
+  Price price = current_tracker.price();
+  // If current order is a market order, cross at inbound price
+  if (MARKET_ORDER_PRICE == price) {
+    price = inbound_tracker.price();
   }
-  callbacks_.erase(callbacks_.begin(), callbacks_.end());
+  return price;
 }
 
-template <class OrderPtr>
-inline void
-OrderBook<OrderPtr>::perform_callback(TypedCallback& cb)
+template <class OrderPtr, class MatchPolicy>
+template <class Side, class Totals>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::can_fill(
+  Tracker& inbound, 
+  const Price& inbound_price, 
+  Side& side,
+  const Totals& totals,
+  Quantity required_qty)
 {
-  // If this is an order callback and I know of an order listener
-  if (cb.order && order_listener_) {
-    switch (cb.type) {
-      case TypedCallback::cb_order_fill: {
-        Cost fill_cost = cb.fill_price * cb.fill_qty;
-        order_listener_->on_fill(cb.order, cb.fill_qty, fill_cost);
-        order_listener_->on_fill(cb.matched_order, cb.fill_qty, fill_cost);
-        break;
+  const bool inbound_is_buy = inbound.is_buy();
+  const Quantity inbound_qty = inbound.open_qty();
+
+  // Total the levels the inbound order reaches.  Orders other than all or
+  // none can always take part, all or none orders only if wholly matched,
+  // so not at all at a level whose smallest is larger than the inbound.
+  Quantity matchable_qty = 0;
+  Quantity level_qty = 0;
+  typename Totals::const_iterator level;
+  for (level = totals.begin(); level != totals.end(); ++level) {
+    if (inbound_is_buy ? (level->first > inbound_price) 
+                       : (level->first < inbound_price)) {
+      break;
+    }
+    matchable_qty += level->second.qty;
+    level_qty += level->second.qty;
+    if (level->second.aon_count && level->second.min_aon_qty <= inbound_qty) {
+      level_qty += level->second.aon_qty;
+    }
+    // Orders of the same owner may not take part, so must be visited
+    if (matchable_qty >= required_qty && !inbound.owner()) {
+      return true;
+    }
+  }
+  if (level_qty < required_qty) {
+    return false;
+  }
+
+  // Else visit the orders which match a level at a time, in the order the
+  // matching would fill them.  A policy which allocates across a level 
+  // fills the orders other than all or none first, then all or none orders
+  // from what is left.  Else the orders fill in time priority.  All or none
+  // inbound orders always match in time priority.  Self-trade prevention 
+  // may reduce the inbound order as it goes.
+  const bool allocates = MatchPolicy::allocates_level && 
+                         !inbound.all_or_none();
+  Quantity matched_qty = 0;
+  typename Side::iterator resting = side.begin();
+  while (resting != side.end()) {
+    const Price level_price = resting->first;
+    // If past the inbound price, no more matches are possible
+    if (inbound_is_buy ? (level_price > inbound_price) 
+                       : (level_price < inbound_price)) {
+      break;
+    }
+    const typename Side::iterator level_end = side.upper_bound(level_price);
+    // Skip a level of only all or none orders too large to match
+    level = totals.find(level_price);
+    if (level != totals.end() && !level->second.qty &&
+        level->second.min_aon_qty > 
+            unmatched_qty(inbound.open_qty(), matched_qty)) {
+      resting = level_end;
+      continue;
+    }
+
+    Quantity shared_qty = 0;
+    while (resting != level_end) {
+      Tracker& current = resting->second;
+      // If both orders have the same owner, prevent the self-trade
+      if (inbound.owner() && (inbound.owner() == current.owner())) {
+        resting = prevent_self_trade(inbound, side, resting);
+        // If the inbound order was cancelled, it can not be filled
+        if (inbound.filled()) {
+          return false;
+        }
+        continue;
       }
-      case TypedCallback::cb_order_accept:
-        order_listener_->on_accept(cb.order);
-        break;
-      case TypedCallback::cb_order_reject:
-        order_listener_->on_reject(cb.order, cb.reject_reason);
-        break;
-      case TypedCallback::cb_order_cancel:
+      const Quantity open_qty = unmatched_qty(inbound.open_qty(), 
+                                              matched_qty);
+      if (!current.all_or_none()) {
+        if (allocates) {
+          shared_qty += current.visible_qty();
+        } else {
+          matched_qty += std::min(open_qty, current.visible_qty());
+        }
+      } else if (!allocates && current.open_qty() <= open_qty) {
+        matched_qty += current.open_qty();
+      }
+      // In time priority, the orders after this one are never reached
+      if (!allocates && 
+          matched_qty >= std::min(required_qty, inbound.open_qty())) {
+        return true;
+      }
+      ++resting;
+    }
+
+    if (allocates) {
+      // The other orders take what they can, then all or none orders
+      matched_qty += std::min(shared_qty, 
+                              unmatched_qty(inbound.open_qty(), matched_qty));
+      typename Side::iterator aon = side.lower_bound(level_price);
+      for (; aon != level_end; ++aon) {
+        if (aon->second.all_or_none() &&
+            aon->second.open_qty() <= 
+                unmatched_qty(inbound.open_qty(), matched_qty)) {
+          matched_qty += aon->second.open_qty();
+        }
+      }
+    }
+    if (matched_qty >= std::min(required_qty, inbound.open_qty())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline Quantity
+OrderBook<OrderPtr, MatchPolicy>::unmatched_qty(Quantity open_qty,
+                                                Quantity matched_qty)
+{
+  return open_qty > matched_qty ? open_qty - matched_qty : 0;
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side, class Level>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::match_levels(Tracker& inbound, 
+                                               const Price& inbound_price, 
+                                               Side& side,
+                                               Level& level)
+{
+  bool matched = false;
+  const bool inbound_is_buy = inbound.is_buy();
+  typename Side::iterator resting = side.begin();
+
+  // While the inbound order is open and crosses the best remaining level
+  while (inbound.open_qty() && resting != side.end() &&
+         (inbound_is_buy ? (inbound_price >= resting->first) 
+                         : (inbound_price <= resting->first))) {
+    const Price level_price = resting->first;
+
+    // Gather the orders at the level, in time priority.  All or none 
+    // orders can not take a prorated share, so are left to last.
+    level.clear();
+    level_qtys_.clear();
+    Quantity level_qty = 0;
+    bool has_all_or_none = false;
+    while (inbound.open_qty() && 
+           resting != side.end() && resting->first == level_price) {
+      // If both orders have the same owner, prevent the self-trade
+      if (inbound.owner() && (inbound.owner() == resting->second.owner())) {
+        resting = prevent_self_trade(inbound, side, resting);
+      } else if (resting->second.all_or_none()) {
+        has_all_or_none = true;
+        ++resting;
+      } else {
+        level.push_back(resting);
+        level_qtys_.push_back(resting->second.visible_qty());
+        level_qty += resting->second.visible_qty();
+        ++resting;
+      }
+    }
+
+    // Allocate the inbound order across the level, in one pass
+    bool refreshed = false;
+    if (level_qty && inbound.open_qty()) {
+      MatchPolicy::allocate(inbound.open_qty(), level_qtys_, level_qty, 
+                            level_allocations_);
+      for (size_t index = 0; index < level.size(); ++index) {
+        if (level_allocations_[index]) {
+          Tracker& current = level[index]->second;
+          cross_orders(inbound, current, cross_price(inbound, current),
+                       level_allocations_[index]);
+          matched = true;
+          // An iceberg not filled by its allocation has been refreshed
+          if (current.iceberg() && !current.filled() && 
+              !current.visible_qty()) {
+            refreshed = true;
+          }
+          settle_fill(side, level[index]);
+        }
+      }
+    }
+
+    // Match any all or none orders with what remains
+    if (has_all_or_none && inbound.open_qty()) {
+      typename Side::iterator aon = side.lower_bound(level_price);
+      while (aon != resting && inbound.open_qty()) {
+        // Orders of the same owner were settled while gathering the level
+        if (aon->second.all_or_none() &&
+            (!inbound.owner() || (inbound.owner() != aon->second.owner())) &&
+            matches(inbound, inbound_price, inbound.open_qty(), 
+                    aon->second, aon->first, inbound_is_buy)) {
+          cross_orders(inbound, aon->second);
+          matched = true;
+          aon = settle_fill(side, aon);
+        } else {
+          ++aon;
+        }
+      }
+    }
+
+    // Match the refreshed slices of any icebergs at the same level again
+    if (refreshed) {
+      resting = side.lower_bound(level_price);
+    }
+  }
+
+  return matched;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::perform_callbacks()
+{
+  typename Callbacks::iterator cb;
+  for (cb = callbacks_.begin(); cb != callbacks_.end(); ++cb) {
+    perform_callback(*cb);
+  }
+  callbacks_.erase(callbacks_.begin(), callbacks_.end());
+  mass_cancelled_.clear();
+  mass_quoted_.clear();
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::perform_callback(TypedCallback& cb)
+{
+  // If this is a mass cancel and I know of an order listener
+  if (cb.type == TypedCallback::cb_mass_cancel) {
+    if (order_listener_) {
+      order_listener_->on_mass_cancel(mass_cancelled(cb), cb.cancel_count);
+    }
+  // Else if this is a mass quote, tell of each replace
+  } else if (cb.type == TypedCallback::cb_mass_quote) {
+    if (order_listener_) {
+      const TypedCallback* quoted = mass_quoted(cb);
+      for (uint32_t index = 0; index < cb.quote_count; ++index) {
+        order_listener_->on_replace(quoted[index].order, 
+                                    quoted[index].new_order_qty, 
+                                    quoted[index].new_price);
+      }
+    }
+  // Else if this is an order callback and I know of an order listener
+  } else if (cb.order && order_listener_) {
+    switch (cb.type) {
+      case TypedCallback::cb_order_fill: {
+        Cost fill_cost = cb.fill_price * cb.fill_qty;
+        order_listener_->on_fill(cb.order, cb.fill_qty, fill_cost);
+        order_listener_->on_fill(cb.matched_order, cb.fill_qty, fill_cost);
+        break;
+      }
+      case TypedCallback::cb_order_accept:
+        order_listener_->on_accept(cb.order);
+        break;
+      case TypedCallback::cb_order_reject:
+        order_listener_->on_reject(cb.order, cb.reject_reason);
+        break;
+      case TypedCallback::cb_order_cancel:
         order_listener_->on_cancel(cb.order);
         break;
       case TypedCallback::cb_order_cancel_reject:
@@ -636,9 +2252,19 @@ OrderBook<OrderPtr>::perform_callback(TypedCallback& cb)
       case TypedCallback::cb_order_replace_reject:
         order_listener_->on_replace_reject(cb.order, cb.reject_reason);
         break;
+      case TypedCallback::cb_order_trigger:
+        order_listener_->on_trigger(cb.order);
+        break;
+      case TypedCallback::cb_order_display:
+        order_listener_->on_display(cb.order, cb.visible_qty);
+        break;
       case TypedCallback::cb_unknown:
+      case TypedCallback::cb_mass_cancel:
+      case TypedCallback::cb_mass_quote:
+      case TypedCallback::cb_pegged_depth:
       case TypedCallback::cb_depth_update:
       case TypedCallback::cb_bbo_update:
+      case TypedCallback::cb_uncross_update:
         // Error
         std::runtime_error("Unexpected callback type for order");
         break;
@@ -648,9 +2274,9 @@ OrderBook<OrderPtr>::perform_callback(TypedCallback& cb)
   }
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline void
-OrderBook<OrderPtr>::log() const
+OrderBook<OrderPtr, MatchPolicy>::log() const
 {
   typename Asks::const_reverse_iterator ask;
   typename Bids::const_iterator bid;
@@ -664,21 +2290,48 @@ OrderBook<OrderPtr>::log() const
   }
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline bool
-OrderBook<OrderPtr>::is_valid(const OrderPtr& order, OrderConditions )
+OrderBook<OrderPtr, MatchPolicy>::is_valid(const OrderPtr& order, 
+                              OrderConditions conditions)
 {
   if (order->order_qty() == 0) {
     callbacks_.push_back(TypedCallback::reject(order, "size must be positive", trans_id_));
     return false;
+  } else if (order->display_qty() && (conditions & oc_all_or_none)) {
+    callbacks_.push_back(TypedCallback::reject(order, 
+                                               "iceberg can not be all or none",
+                                               trans_id_));
+    return false;
+  } else if (order->peg_type() != peg_none && order->price()) {
+    callbacks_.push_back(TypedCallback::reject(order, 
+                                               "pegged order can not have a price",
+                                               trans_id_));
+    return false;
+  } else if (order->peg_type() != peg_none && 
+             (order->display_qty() || (conditions & oc_all_or_none))) {
+    callbacks_.push_back(TypedCallback::reject(order, 
+                                               "pegged order can not be all or none or iceberg",
+                                               trans_id_));
+    return false;
+  } else if ((conditions & oc_minimum_qty) && 
+             (!order->min_qty() || order->min_qty() > order->order_qty())) {
+    callbacks_.push_back(TypedCallback::reject(order, 
+                                               "minimum quantity must be positive and within the order quantity",
+                                               trans_id_));
+    return false;
+  } else if (order->expire_time() && 
+             (order->expire_time() <= expiries_.now())) {
+    callbacks_.push_back(TypedCallback::reject(order, "expired", trans_id_));
+    return false;
   } else {
     return true;
   }
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline bool
-OrderBook<OrderPtr>::is_valid_replace(
+OrderBook<OrderPtr, MatchPolicy>::is_valid_replace(
   const Tracker& order,
   int32_t size_delta,
   Price /*new_price*/)
@@ -696,9 +2349,9 @@ OrderBook<OrderPtr>::is_valid_replace(
   return true;
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline void
-OrderBook<OrderPtr>::find_bid(
+OrderBook<OrderPtr, MatchPolicy>::find_bid(
   const OrderPtr& order,
   typename Bids::iterator& result)
 {
@@ -710,14 +2363,15 @@ OrderBook<OrderPtr>::find_bid(
       break;
     // Else if this bid's price is too low to match the search price
     } else if (result->first < search_price) {
+      result = bids_.end();
       break; // No more possible
     }
   }
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline void
-OrderBook<OrderPtr>::find_ask(
+OrderBook<OrderPtr, MatchPolicy>::find_ask(
   const OrderPtr& order,
   typename Asks::iterator& result)
 {
@@ -729,14 +2383,907 @@ OrderBook<OrderPtr>::find_ask(
       break;
     // Else if this ask's price is too high to match the search price
     } else if (result->first > search_price) {
+      result = asks_.end();
       break; // No more possible
     }
   }
 } 
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
+template <class Stops>
+inline typename Stops::iterator
+OrderBook<OrderPtr, MatchPolicy>::find_stop(const OrderPtr& order, Stops& stops)
+{
+  typename Stops::iterator result = stops.find(order->stop_price());
+  for ( ; result != stops.end(); ++result) {
+    // If this is the correct stop
+    if (result->second.ptr() == order) {
+      return result;
+    // Else if this stop has a different stop price
+    } else if (result->first != order->stop_price()) {
+      break; // No more possible
+    }
+  }
+  return stops.end();
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::erase_order(const OrderPtr& order)
+{
+  bool found = false;
+  // If the order is pegged, it rests apart from the book
+  if (order->peg_type() != peg_none) {
+    found = erase_pegged_order(order);
+  // Else if the order is a buy order
+  } else if (order->is_buy()) {
+    typename Bids::iterator bid;
+    find_bid(order, bid);
+    if (bid != bids_.end()) {
+      if (in_auction_) {
+        change_ladder_qty(bid->second, bid->first, true, 
+                          -(int32_t)bid->second.open_qty());
+      }
+      unschedule(bid->second);
+      leave_level(bid->first, bid->second);
+      bids_.erase(bid);
+      found = true;
+    }
+  // Else the order is a sell order
+  } else {
+    typename Asks::iterator ask;
+    find_ask(order, ask);
+    if (ask != asks_.end()) {
+      if (in_auction_) {
+        change_ladder_qty(ask->second, ask->first, false, 
+                          -(int32_t)ask->second.open_qty());
+      }
+      unschedule(ask->second);
+      leave_level(ask->first, ask->second);
+      asks_.erase(ask);
+      found = true;
+    }
+  } 
+  // If not in the book, the order may be an untriggered stop
+  if (!found && order->stop_price()) {
+    if (order->is_buy()) {
+      typename StopBids::iterator stop = find_stop(order, stop_bids_);
+      if (stop != stop_bids_.end()) {
+        unschedule(stop->second);
+        leave_stops(stop->first, stop->second);
+        stop_bids_.erase(stop);
+        found = true;
+      }
+    } else {
+      typename StopAsks::iterator stop = find_stop(order, stop_asks_);
+      if (stop != stop_asks_.end()) {
+        unschedule(stop->second);
+        leave_stops(stop->first, stop->second);
+        stop_asks_.erase(stop);
+        found = true;
+      }
+    }
+  }
+  return found;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::unschedule(Tracker& tracker)
+{
+  if (tracker.timer()) {
+    expiries_.cancel(tracker.timer());
+    tracker.set_timer(0);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::sync_level(Price price, Tracker& tracker)
+{
+  // The hash counts the reserve of an iceberg as well
+  if (tracker.open_qty() != tracker.hashed_qty()) {
+    change_hash(price, tracker, tracker.open_qty());
+  }
+  const Quantity qty = tracker.visible_qty();
+  const Quantity prior_qty = tracker.level_qty();
+  if (qty != prior_qty) {
+    tracker.set_level_qty(qty);
+    if (tracker.is_buy()) {
+      change_level_total(bids_, bid_totals_, price, tracker, prior_qty);
+    } else {
+      change_level_total(asks_, ask_totals_, price, tracker, prior_qty);
+    }
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::leave_level(Price price, Tracker& tracker)
+{
+  if (tracker.hashed_qty()) {
+    change_hash(price, tracker, 0);
+  }
+  const Quantity prior_qty = tracker.level_qty();
+  if (prior_qty) {
+    tracker.set_level_qty(0);
+    if (tracker.is_buy()) {
+      change_level_total(bids_, bid_totals_, price, tracker, prior_qty);
+    } else {
+      change_level_total(asks_, ask_totals_, price, tracker, prior_qty);
+    }
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::change_hash(Price price, 
+                                              Tracker& tracker,
+                                              Quantity qty,
+                                              HashTag tag)
+{
+  // Sums wrap, so an order's count is taken away as it was added
+  if (tracker.hashed_qty()) {
+    book_hash_ -= order_hash(tracker, price, tracker.hashed_qty(), tag);
+  }
+  if (qty) {
+    book_hash_ += order_hash(tracker, price, qty, tag);
+  }
+  tracker.set_hashed_qty(qty);
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline uint64_t
+OrderBook<OrderPtr, MatchPolicy>::order_hash(const Tracker& tracker,
+                                             Price price,
+                                             Quantity qty,
+                                             HashTag tag)
+{
+  // Mix in the fields in two rounds, so counts of similar orders differ
+  uint64_t identity = (uint64_t(tracker.entry_trans()) << 32) | price;
+  const uint64_t state = (uint64_t(tracker.conditions()) << 33) |
+                         (uint64_t(tracker.is_buy()) << 32) | qty;
+  // Orders held apart from the book mix in their tag, and stops their 
+  // limit price, in a round of their own
+  if (tag != hash_resting) {
+    const Price limit_price = (tag == hash_stop) ? tracker.price() : 0;
+    identity = mix_hash(identity) ^ ((uint64_t(limit_price) << 2) | tag);
+  }
+  return mix_hash(mix_hash(identity) ^ state);
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::sync_peg(PegQueue& queue, Tracker& pegged)
+{
+  // The queue's place in peg_queues_ stands in for a price
+  if (pegged.open_qty() != pegged.hashed_qty()) {
+    change_hash(Price(&queue - peg_queues_), pegged, pegged.open_qty(), 
+                hash_pegged);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::leave_stops(Price stop_price, 
+                                              Tracker& tracker)
+{
+  if (tracker.hashed_qty()) {
+    change_hash(stop_price, tracker, 0, hash_stop);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline uint64_t
+OrderBook<OrderPtr, MatchPolicy>::mix_hash(uint64_t hash)
+{
+  // The finalizer of splitmix64
+  hash ^= hash >> 30;
+  hash *= 0xBF58476D1CE4E5B9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94D049BB133111EBULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side, class Totals>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::change_level_total(
+  Side& side,
+  Totals& totals, 
+  Price price, 
+  Tracker& tracker,
+  Quantity prior_qty)
+{
+  const Quantity qty = tracker.level_qty();
+  typename Totals::iterator level = totals.find(price);
+  if (level == totals.end()) {
+    level = totals.insert(std::make_pair(price, LevelTotal())).first;
+  }
+  LevelTotal& total = level->second;
+
+  if (!tracker.all_or_none()) {
+    total.qty = total.qty - prior_qty + qty;
+  } else {
+    total.aon_qty = total.aon_qty - prior_qty + qty;
+    if (!prior_qty) {
+      ++total.aon_count;
+    } else if (!qty) {
+      --total.aon_count;
+    }
+    if (!total.aon_count) {
+      total.min_aon_qty = 0;
+    } else if (qty && (total.aon_count == 1 || qty < total.min_aon_qty)) {
+      total.min_aon_qty = qty;
+    // Else if the smallest order grew or left, find the smallest again
+    } else if (prior_qty == total.min_aon_qty && qty != prior_qty) {
+      total.min_aon_qty = qty;
+      typename Side::const_iterator resting = side.lower_bound(price);
+      for (; resting != side.end() && resting->first == price; ++resting) {
+        const Quantity resting_qty = resting->second.level_qty();
+        if (resting->second.all_or_none() && resting_qty &&
+            (!total.min_aon_qty || resting_qty < total.min_aon_qty)) {
+          total.min_aon_qty = resting_qty;
+        }
+      }
+    }
+  }
+  // Remove a level left empty
+  if (!total.qty && !total.aon_qty) {
+    totals.erase(level);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side, class Totals>
+inline typename Side::iterator
+OrderBook<OrderPtr, MatchPolicy>::skip_unmatched(
+  Side& side,
+  const Totals& totals,
+  typename Side::iterator resting,
+  Quantity inbound_qty)
+{
+  if (resting->second.all_or_none()) {
+    typename Totals::const_iterator level = totals.find(resting->first);
+    if (level != totals.end() && !level->second.qty && 
+        level->second.min_aon_qty > inbound_qty) {
+      return side.upper_bound(resting->first);
+    }
+  }
+  return ++resting;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::queue_ahead(const OrderPtr& order,
+                                              Quantity& qty_ahead,
+                                              uint32_t& orders_ahead) const
+{
+  if (order->is_buy()) {
+    return side_queue_ahead(bids_, order, qty_ahead, orders_ahead);
+  } else {
+    return side_queue_ahead(asks_, order, qty_ahead, orders_ahead);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::side_queue_ahead(
+  const Side& side,
+  const OrderPtr& order,
+  Quantity& qty_ahead,
+  uint32_t& orders_ahead) const
+{
+  // Sum the orders counted in the level's total while finding the order
+  Quantity qty = 0;
+  uint32_t count = 0;
+  const Price price = sort_price(order);
+  typename Side::const_iterator resting = side.lower_bound(price);
+  for (; resting != side.end() && resting->first == price; ++resting) {
+    const Quantity level_qty = resting->second.level_qty();
+    if (resting->second.ptr() == order) {
+      if (!level_qty) {
+        break;
+      }
+      qty_ahead = qty;
+      orders_ahead = count;
+      return true;
+    } else if (level_qty) {
+      qty += level_qty;
+      ++count;
+    }
+  }
+  return false;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline const typename OrderBook<OrderPtr, MatchPolicy>::Tracker*
+OrderBook<OrderPtr, MatchPolicy>::find_resting(const OrderPtr& order) const
+{
+  // A pegged order rests in the queue of its peg, not in the book
+  const PegType peg_type = order->peg_type();
+  if (peg_type != peg_none) {
+    const PegPlaces& places = 
+        peg_queues_[peg_index(order->is_buy(), peg_type)].places;
+    typename PegPlaces::const_iterator place = places.find(order);
+    return (place == places.end()) ? NULL : &*place->second;
+  } else if (order->is_buy()) {
+    return side_find_resting(bids_, order);
+  } else {
+    return side_find_resting(asks_, order);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline const typename OrderBook<OrderPtr, MatchPolicy>::Tracker*
+OrderBook<OrderPtr, MatchPolicy>::side_find_resting(
+  const Side& side,
+  const OrderPtr& order) const
+{
+  const Price price = sort_price(order);
+  typename Side::const_iterator resting = side.lower_bound(price);
+  for (; resting != side.end() && resting->first == price; ++resting) {
+    if (resting->second.ptr() == order) {
+      return &resting->second;
+    }
+  }
+  return NULL;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline FillCost
+OrderBook<OrderPtr, MatchPolicy>::cost_to_fill(bool is_buy,
+                                               Quantity qty,
+                                               Price limit_price) const
+{
+  if (is_buy) {
+    return fill_cost(ask_totals_, qty, limit_price, is_buy);
+  } else {
+    return fill_cost(bid_totals_, qty, limit_price, is_buy);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Totals>
+inline FillCost
+OrderBook<OrderPtr, MatchPolicy>::fill_cost(const Totals& totals,
+                                            Quantity qty,
+                                            Price limit_price,
+                                            bool is_buy) const
+{
+  FillCost result;
+  typename Totals::const_iterator level;
+  for (level = totals.begin(); 
+       level != totals.end() && result.filled_qty < qty; ++level) {
+    const Price price = level->first;
+    // Market orders have no price to fill at
+    if (price == (is_buy ? MARKET_ORDER_ASK_SORT_PRICE 
+                         : MARKET_ORDER_BID_SORT_PRICE)) {
+      continue;
+    }
+    // If past the limit price, no more fills are possible
+    if (limit_price && (is_buy ? (price > limit_price) 
+                               : (price < limit_price))) {
+      break;
+    }
+    if (!level->second.qty) {
+      continue;
+    }
+    const Quantity fill_qty = 
+        std::min(level->second.qty, qty - result.filled_qty);
+    result.filled_qty += fill_qty;
+    result.cost += uint64_t(price) * fill_qty;
+    result.worst_price = price;
+    ++result.level_count;
+  }
+  return result;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline Price
+OrderBook<OrderPtr, MatchPolicy>::best_bid() const
+{
+  typename Bids::const_iterator bid = bids_.begin();
+  // Skip market orders, which have no price
+  if (bid != bids_.end() && bid->first == MARKET_ORDER_BID_SORT_PRICE) {
+    bid = bids_.upper_bound(MARKET_ORDER_BID_SORT_PRICE);
+  }
+  return (bid == bids_.end()) ? 0 : bid->first;
+}
+
+template <class OrderPtr, class MatchPolicy>
 inline Price
-OrderBook<OrderPtr>::sort_price(const OrderPtr& order)
+OrderBook<OrderPtr, MatchPolicy>::best_ask() const
+{
+  typename Asks::const_iterator ask = asks_.begin();
+  // Skip market orders, which have no price
+  if (ask != asks_.end() && ask->first == MARKET_ORDER_ASK_SORT_PRICE) {
+    ask = asks_.upper_bound(MARKET_ORDER_ASK_SORT_PRICE);
+  }
+  return (ask == asks_.end()) ? 0 : ask->first;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline typename OrderBook<OrderPtr, MatchPolicy>::PeggedOrders::iterator
+OrderBook<OrderPtr, MatchPolicy>::erase_peg(
+  PegQueue& queue,
+  typename PeggedOrders::iterator resting)
+{
+  unschedule(*resting);
+  --queue.order_count;
+  queue.open_qty -= resting->open_qty();
+  if (resting->hashed_qty()) {
+    change_hash(Price(&queue - peg_queues_), *resting, 0, hash_pegged);
+  }
+  queue.places.erase(resting->ptr());
+  return queue.orders.erase(resting);
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::push_peg(PegQueue& queue, 
+                                           const Tracker& pegged)
+{
+  queue.orders.push_back(pegged);
+  typename PeggedOrders::iterator back = queue.orders.end();
+  queue.places.insert(std::make_pair(pegged.ptr(), --back));
+  ++queue.order_count;
+  queue.open_qty += pegged.open_qty();
+  sync_peg(queue, *back);
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline typename OrderBook<OrderPtr, MatchPolicy>::PeggedOrders::iterator
+OrderBook<OrderPtr, MatchPolicy>::find_peg(PegQueue& queue, 
+                                           const OrderPtr& order)
+{
+  typename PegPlaces::iterator place = queue.places.find(order);
+  return (place == queue.places.end()) ? queue.orders.end() : place->second;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::erase_pegged_order(const OrderPtr& order)
+{
+  PegQueue& queue = peg_queue(order->is_buy(), order->peg_type());
+  typename PeggedOrders::iterator pegged = find_peg(queue, order);
+  if (pegged == queue.orders.end()) {
+    return false;
+  }
+  erase_peg(queue, pegged);
+  return true;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline typename OrderBook<OrderPtr, MatchPolicy>::PeggedOrders::iterator
+OrderBook<OrderPtr, MatchPolicy>::prevent_peg_self_trade(
+  Tracker& inbound, 
+  PegQueue& queue, 
+  typename PeggedOrders::iterator resting)
+{
+  // All or none inbound orders do not match pegged orders
+  switch (self_trade_prevention_) {
+    case stp_cancel_oldest:
+      callbacks_.push_back(TypedCallback::cancel(resting->ptr(), trans_id_));
+      resting = erase_peg(queue, resting);
+      break;
+    case stp_decrement_both: {
+      Quantity qty = std::min(inbound.open_qty(), resting->open_qty());
+      inbound.reduce(qty);
+      resting->reduce(qty);
+      queue.open_qty -= qty;
+      sync_peg(queue, *resting);
+      if (resting->filled()) {
+        callbacks_.push_back(
+            TypedCallback::cancel(resting->ptr(), trans_id_));
+        resting = erase_peg(queue, resting);
+      } else {
+        callbacks_.push_back(TypedCallback::replace(
+            resting->ptr(), resting->filled_qty() + resting->open_qty(), 
+            MARKET_ORDER_PRICE, trans_id_));
+        ++resting;
+      }
+      break;
+    }
+    case stp_cancel_newest:
+    default:
+      // Cancelled by add_order()
+      inbound.reduce(inbound.open_qty());
+      break;
+  }
+  return resting;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::replace_peg(
+  const OrderPtr& order,
+  int32_t size_delta,
+  Price new_price)
+{
+  PegQueue& queue = peg_queue(order->is_buy(), order->peg_type());
+  typename PeggedOrders::iterator pegged = find_peg(queue, order);
+  // If not found, the order may be an untriggered stop
+  if (pegged == queue.orders.end()) {
+    return false;
+  }
+  if (new_price != PRICE_UNCHANGED) {
+    callbacks_.push_back(TypedCallback::replace_reject(
+        order, "pegged order can not have a price", trans_id_));
+  // Else if this is a valid replace, the order keeps its place unless its
+  // size grows
+  } else if (is_valid_replace(*pegged, size_delta, new_price)) {
+    push_replace(order, order->order_qty() + size_delta, PRICE_UNCHANGED);
+    pegged->change_qty(size_delta);
+    queue.open_qty += size_delta;
+    sync_peg(queue, *pegged);
+    // If the size change closed the order
+    if (pegged->filled()) {
+      callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
+      erase_peg(queue, pegged);
+    } else if (size_delta > 0) {
+      queue.orders.splice(queue.orders.end(), queue.orders, pegged);
+    }
+  }
+  return true;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::mass_cancel_pegs(
+  bool is_buy,
+  OwnerId owner,
+  Price low_price,
+  Price high_price)
+{
+  const PegType peg_types[] = { peg_primary, peg_midpoint };
+  for (int index = 0; index < 2; ++index) {
+    PegQueue& queue = peg_queue(is_buy, peg_types[index]);
+    // Pegged orders are in a price range if their current price is
+    const Price price = pegged_price(is_buy, peg_types[index]);
+    if ((low_price || high_price) && 
+        (!price || (low_price && (price < low_price)) || 
+                   (high_price && (price > high_price)))) {
+      continue;
+    }
+    typename PeggedOrders::iterator pegged = queue.orders.begin();
+    while (pegged != queue.orders.end()) {
+      if (!owner || (owner == pegged->owner())) {
+        mass_cancelled_.push_back(pegged->ptr());
+        pegged = erase_peg(queue, pegged);
+      } else {
+        ++pegged;
+      }
+    }
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::cross_midpoint_pegs()
+{
+  PegQueue& bids = peg_queue(true, peg_midpoint);
+  PegQueue& asks = peg_queue(false, peg_midpoint);
+  if (in_auction_ || bids.orders.empty() || asks.orders.empty()) {
+    return false;
+  }
+  // The pegs meet when a change of the best bid or offer evens the spread
+  const Price price = pegged_price(true, peg_midpoint);
+  if (!price || (price < pegged_price(false, peg_midpoint))) {
+    return false;
+  }
+  bool matched = false;
+  while (!bids.orders.empty() && !asks.orders.empty()) {
+    Tracker& bid = bids.orders.front();
+    Tracker& ask = asks.orders.front();
+    // Orders of the same owner are settled by self-trade prevention, and 
+    // the orders behind them cross in turn
+    if (bid.owner() && (bid.owner() == ask.owner())) {
+      prevent_midpoint_self_trade(bids, asks);
+      continue;
+    }
+    const Quantity fill_qty = std::min(bid.open_qty(), ask.open_qty());
+    cross_orders(bid, ask, price, fill_qty);
+    bids.open_qty -= fill_qty;
+    asks.open_qty -= fill_qty;
+    sync_peg(bids, bid);
+    sync_peg(asks, ask);
+    matched = true;
+    if (bid.filled()) {
+      erase_peg(bids, bids.orders.begin());
+    }
+    if (ask.filled()) {
+      erase_peg(asks, asks.orders.begin());
+    }
+  }
+  return matched;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::prevent_midpoint_self_trade(PegQueue& bids,
+                                                              PegQueue& asks)
+{
+  // Neither order is inbound, so the one entered later is the newest
+  const Tracker& bid = bids.orders.front();
+  const Tracker& ask = asks.orders.front();
+  const bool bid_newest = bid.entry_trans() >= ask.entry_trans();
+  PegQueue& newest = bid_newest ? bids : asks;
+  PegQueue& oldest = bid_newest ? asks : bids;
+  switch (self_trade_prevention_) {
+    case stp_cancel_oldest:
+      reduce_front_peg(oldest, oldest.orders.front().open_qty());
+      break;
+    case stp_decrement_both: {
+      const Quantity qty = std::min(bid.open_qty(), ask.open_qty());
+      reduce_front_peg(bids, qty);
+      reduce_front_peg(asks, qty);
+      break;
+    }
+    case stp_cancel_newest:
+    default:
+      reduce_front_peg(newest, newest.orders.front().open_qty());
+      break;
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::reduce_front_peg(PegQueue& queue, 
+                                                   Quantity qty)
+{
+  Tracker& pegged = queue.orders.front();
+  pegged.reduce(qty);
+  queue.open_qty -= qty;
+  sync_peg(queue, pegged);
+  if (pegged.filled()) {
+    callbacks_.push_back(TypedCallback::cancel(pegged.ptr(), trans_id_));
+    erase_peg(queue, queue.orders.begin());
+  } else {
+    callbacks_.push_back(TypedCallback::replace(
+        pegged.ptr(), pegged.filled_qty() + pegged.open_qty(), 
+        MARKET_ORDER_PRICE, trans_id_));
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::publish_pegged_depth(bool is_buy, 
+                                                       PegType peg_type)
+{
+  PegQueue& queue = peg_queue(is_buy, peg_type);
+  PeggedDepth pegged;
+  pegged.price = queue.order_count ? pegged_price(is_buy, peg_type) : 0;
+  // Orders with nothing to peg to are not shown
+  pegged.order_count = pegged.price ? queue.order_count : 0;
+  pegged.qty = pegged.price ? queue.open_qty : 0;
+  if (pegged.price != queue.published.price ||
+      pegged.order_count != queue.published.order_count ||
+      pegged.qty != queue.published.qty) {
+    callbacks_.push_back(TypedCallback::pegged_depth(
+        is_buy, queue.published, pegged, trans_id_));
+    queue.published = pegged;
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::reprice_pegs()
+{
+  // Pegged orders are priced as they match, so a change in the best bid or
+  // offer costs nothing per order.  Only midpoint pegs of the two sides can
+  // come to cross each other.
+  while (cross_midpoint_pegs()) {
+    trigger_stops();
+  }
+  if (pegged_depth_) {
+    publish_pegged_depth(true, peg_primary);
+    publish_pegged_depth(true, peg_midpoint);
+    publish_pegged_depth(false, peg_primary);
+    publish_pegged_depth(false, peg_midpoint);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline typename Side::iterator
+OrderBook<OrderPtr, MatchPolicy>::settle_fill(Side& side, typename Side::iterator resting)
+{
+  Tracker& tracker = resting->second;
+  sync_level(resting->first, tracker);
+  // If the resting order was filled, remove it
+  if (tracker.filled()) {
+    if (tracker.iceberg()) {
+      callbacks_.push_back(TypedCallback::display(tracker.ptr(), 0, trans_id_));
+    }
+    unschedule(tracker);
+    side.erase(resting++);
+  // Else if an iceberg, display what remains
+  } else if (tracker.iceberg()) {
+    // If the visible slice is gone, refresh from the reserve and lose time
+    // priority, rather than as a cancel and add
+    if (!tracker.visible_qty()) {
+      tracker.refresh();
+      sync_level(resting->first, tracker);
+      callbacks_.push_back(TypedCallback::display(
+          tracker.ptr(), tracker.visible_qty(), trans_id_));
+      resting = requeue(side, resting);
+    } else {
+      callbacks_.push_back(TypedCallback::display(
+          tracker.ptr(), tracker.visible_qty(), trans_id_));
+      ++resting;
+    }
+  } else {
+    ++resting;
+  }
+  return resting;
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline typename Side::iterator
+OrderBook<OrderPtr, MatchPolicy>::requeue(Side& side, 
+                                          typename Side::iterator resting)
+{
+  typename Side::iterator back = side.insert(
+      side.upper_bound(resting->first),
+      typename Side::value_type(resting->first, Tracker()));
+  back->second.swap(resting->second);
+  side.erase(resting++);
+  return resting;
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::mass_cancel_side(
+  Side& side,
+  typename Side::iterator begin,
+  typename Side::iterator end,
+  OwnerId owner,
+  Price low_price,
+  Price high_price,
+  bool update_ladder,
+  bool stops)
+{
+  typename Side::iterator pos = begin;
+  while (pos != end) {
+    Tracker& tracker = pos->second;
+    const Price price = tracker.price();
+    // If the order meets the criteria, remove it
+    if ((!owner || (owner == tracker.owner())) &&
+        (!low_price || (price >= low_price)) &&
+        (!high_price || (price <= high_price))) {
+      if (update_ladder) {
+        change_ladder_qty(tracker, pos->first, tracker.is_buy(), 
+                          -(int32_t)tracker.open_qty());
+      }
+      mass_cancelled_.push_back(tracker.ptr());
+      unschedule(tracker);
+      if (stops) {
+        leave_stops(pos->first, tracker);
+      } else {
+        leave_level(pos->first, tracker);
+      }
+      side.erase(pos++);
+    } else {
+      ++pos;
+    }
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Side>
+inline typename Side::iterator
+OrderBook<OrderPtr, MatchPolicy>::prevent_self_trade(
+  Tracker& inbound, 
+  Side& side, 
+  typename Side::iterator resting)
+{
+  Tracker& current = resting->second;
+  // An all or none inbound order can not be partly decremented
+  SelfTradePrevention stp = self_trade_prevention_;
+  if (stp == stp_decrement_both && inbound.all_or_none()) {
+    stp = stp_cancel_newest;
+  }
+
+  switch (stp) {
+    case stp_cancel_oldest:
+      callbacks_.push_back(TypedCallback::cancel(current.ptr(), trans_id_));
+      unschedule(current);
+      leave_level(resting->first, current);
+      side.erase(resting++);
+      break;
+    case stp_decrement_both: {
+      Quantity qty = std::min(inbound.open_qty(), current.visible_qty());
+      inbound.reduce(qty);
+      current.reduce(qty);
+      if (current.filled()) {
+        callbacks_.push_back(TypedCallback::cancel(current.ptr(), trans_id_));
+      } else {
+        const OrderPtr& order = current.ptr();
+        callbacks_.push_back(TypedCallback::replace(
+            order, current.filled_qty() + current.open_qty(), 
+            order->is_limit() ? resting->first : MARKET_ORDER_PRICE,
+            trans_id_));
+      }
+      resting = settle_fill(side, resting);
+      break;
+    }
+    case stp_cancel_newest:
+    default:
+      // Cancelled by add_order()
+      inbound.reduce(inbound.open_qty());
+      break;
+  }
+  return resting;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::copy_resting(Price price, 
+                                               const Tracker& tracker)
+{
+  if (tracker.is_buy()) {
+    sync_level(price, 
+               bids_.insert(std::make_pair(price, 
+                                           copy_tracker(tracker)))->second);
+  } else {
+    sync_level(price, 
+               asks_.insert(std::make_pair(price, 
+                                           copy_tracker(tracker)))->second);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::copy_held(const OrderBook& other)
+{
+  trans_id_ = other.trans_id_;
+  last_trade_price_ = other.last_trade_price_;
+  self_trade_prevention_ = other.self_trade_prevention_;
+  expiries_.advance(other.expiries_.now(), expired_);
+  for (int index = 0; index < 4; ++index) {
+    const PeggedOrders& pegged = other.peg_queues_[index].orders;
+    PegQueue& queue = peg_queues_[index];
+    typename PeggedOrders::const_iterator order;
+    for (order = pegged.begin(); order != pegged.end(); ++order) {
+      push_peg(queue, copy_tracker(*order));
+    }
+  }
+  typename StopBids::const_iterator bid;
+  for (bid = other.stop_bids_.begin(); bid != other.stop_bids_.end(); ++bid) {
+    Tracker& stop = stop_bids_.insert(
+        std::make_pair(bid->first, copy_tracker(bid->second)))->second;
+    change_hash(bid->first, stop, stop.open_qty(), hash_stop);
+  }
+  typename StopAsks::const_iterator ask;
+  for (ask = other.stop_asks_.begin(); ask != other.stop_asks_.end(); ++ask) {
+    Tracker& stop = stop_asks_.insert(
+        std::make_pair(ask->first, copy_tracker(ask->second)))->second;
+    change_hash(ask->first, stop, stop.open_qty(), hash_stop);
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline typename OrderBook<OrderPtr, MatchPolicy>::Tracker
+OrderBook<OrderPtr, MatchPolicy>::copy_tracker(const Tracker& tracker)
+{
+  // The copy is counted afresh in this book's levels and hash, and is not
+  // timed by this book
+  Tracker copy(tracker);
+  copy.set_level_qty(0);
+  copy.set_hashed_qty(0);
+  copy.set_timer(0);
+  return copy;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline Price
+OrderBook<OrderPtr, MatchPolicy>::sort_price(const OrderPtr& order) const
 {
   Price result_price = order->price();
   if (MARKET_ORDER_PRICE == result_price) {
@@ -746,38 +3293,209 @@ OrderBook<OrderPtr>::sort_price(const OrderPtr& order)
   return result_price;
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
 inline bool
-OrderBook<OrderPtr>::add_order(Tracker& inbound, Price order_price)
+OrderBook<OrderPtr, MatchPolicy>::add_order(Tracker& inbound, Price order_price)
 {
   bool matched = false;
   OrderPtr& order = inbound.ptr();
+  const Quantity entry_qty = inbound.filled_qty() + inbound.open_qty();
+  const PegType peg_type = order->peg_type();
+
+  // A pegged order takes the price of its peg, which it crosses resting
+  // market orders at
+  if (peg_type != peg_none) {
+    order_price = pegged_price(order->is_buy(), peg_type);
+    inbound.set_price(order_price);
+  }
 
-  // Try to match with current orders
-  if (order->is_buy()) {
-    matched = match_order(inbound, order_price, asks_);
+  // During an auction orders rest without matching
+  if (in_auction_) {
+    // No match
+  // Else a pegged order with nothing to peg to rests until it is priced
+  } else if (peg_type != peg_none && !order_price) {
+    // No match
+  // Else try to match with current orders
   } else {
-    matched = match_order(inbound, order_price, bids_);
+    matched = match_inbound(inbound, order_price);
+  }
+  // A minimum quantity applies to the match on entry only
+  inbound.clear_min_qty();
+
+  // If the order was reduced to prevent a self-trade, cancel or resize it
+  if (inbound.filled_qty() + inbound.open_qty() < entry_qty) {
+    if (inbound.filled()) {
+      callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
+    } else {
+      callbacks_.push_back(TypedCallback::replace(
+          order, inbound.filled_qty() + inbound.open_qty(), 
+          order->is_limit() ? order_price : MARKET_ORDER_PRICE, trans_id_));
+    }
   }
 
   // If order has remaining open quantity and is not immediate or cancel
   if (inbound.open_qty() && !inbound.immediate_or_cancel()) {
-    // If this is a buy order
-    if (order->is_buy()) {
+    // An order with an expiry time is timed while it rests
+    if (order->expire_time() && !inbound.timer()) {
+      inbound.set_timer(expiries_.schedule(order->expire_time(), order));
+    }
+    // An iceberg rests with only its first slice visible
+    if (inbound.iceberg()) {
+      inbound.refresh();
+      callbacks_.push_back(TypedCallback::display(
+          order, inbound.visible_qty(), trans_id_));
+    }
+    // If this is a pegged order, queue it with the others of its peg
+    if (peg_type != peg_none) {
+      push_peg(peg_queue(order->is_buy(), peg_type), inbound);
+    // Else if this is a buy order
+    } else if (order->is_buy()) {
       // Insert into bids
-      bids_.insert(std::make_pair(order_price, inbound));
+      sync_level(order_price, 
+                 bids_.insert(std::make_pair(order_price, inbound))->second);
     // Else this is a sell order
     } else {
       // Insert into asks
-      asks_.insert(std::make_pair(order_price, inbound));
+      sync_level(order_price, 
+                 asks_.insert(std::make_pair(order_price, inbound))->second);
     }
+    // Pegged orders do not take part in an uncross
+    if (in_auction_ && peg_type == peg_none) {
+      change_ladder_qty(inbound, order_price, order->is_buy(), 
+                        inbound.open_qty());
+    }
+  // Else the order does not rest, and will not expire
+  } else {
+    unschedule(inbound);
   }
   return matched;
 }
 
-template <class OrderPtr>
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::change_ladder_qty(
+  const Tracker& tracker,
+  Price price,
+  bool is_buy,
+  int32_t qty_delta)
+{
+  // All or none orders are not counted on to trade in the uncross
+  if (!tracker.all_or_none()) {
+    if (is_buy) {
+      ladder_.change_bid_qty(price, qty_delta);
+    } else {
+      ladder_.change_ask_qty(price, qty_delta);
+    }
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::stop_triggered(bool is_buy, Price stop_price) const
+{
+  // No stop is triggered before the first trade
+  if (!last_trade_price_) {
+    return false;
+  } else if (is_buy) {
+    return last_trade_price_ >= stop_price;
+  } else {
+    return last_trade_price_ <= stop_price;
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::trigger_stops()
+{
+  // Each triggered stop may trade and trigger more stops.  Process them in 
+  // turn rather than recursively, all within the current transaction.
+  bool triggered = true;
+  while (triggered) {
+    // Move stops triggered by the last trade price to the end of the queue
+    typename StopBids::iterator last_bid = 
+        stop_bids_.upper_bound(last_trade_price_);
+    typename StopBids::iterator bid;
+    for (bid = stop_bids_.begin(); bid != last_bid; ++bid) {
+      leave_stops(bid->first, bid->second);
+      triggered_stops_.push_back(bid->second);
+    }
+    stop_bids_.erase(stop_bids_.begin(), last_bid);
+
+    typename StopAsks::iterator last_ask = 
+        stop_asks_.upper_bound(last_trade_price_);
+    typename StopAsks::iterator ask;
+    for (ask = stop_asks_.begin(); ask != last_ask; ++ask) {
+      leave_stops(ask->first, ask->second);
+      triggered_stops_.push_back(ask->second);
+    }
+    stop_asks_.erase(stop_asks_.begin(), last_ask);
+
+    // If there is a triggered stop, enter it in the book
+    triggered = !triggered_stops_.empty();
+    if (triggered) {
+      Tracker& inbound = triggered_stops_.front();
+      const OrderPtr& order = inbound.ptr();
+      callbacks_.push_back(TypedCallback::trigger(order, trans_id_));
+      typename Callbacks::size_type trigger_cb = callbacks_.size() - 1;
+      if (add_order(inbound, sort_price(order))) {
+        // Note the filled qty in the callback
+        callbacks_[trigger_cb].match_qty = inbound.filled_qty();
+      }
+      // Cancel any unfilled IOC order
+      if (inbound.immediate_or_cancel() && !inbound.filled()) {
+        callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
+      }
+      triggered_stops_.pop_front();
+    }
+  }
+}
+
+template <class OrderPtr, class MatchPolicy>
+template <class Stops>
+inline bool
+OrderBook<OrderPtr, MatchPolicy>::replace_stop(
+  Stops& stops,
+  const OrderPtr& order,
+  int32_t size_delta,
+  Price new_price)
+{
+  typename Stops::iterator stop = find_stop(order, stops);
+  if (stop == stops.end()) {
+    return false;
+  }
+  // If this is a valid replace
+  if (is_valid_replace(stop->second, size_delta, new_price)) {
+    Price price = (new_price == PRICE_UNCHANGED) ? order->price() : new_price;
+    push_replace(order, order->order_qty() + size_delta, price);
+    // The stop price is unchanged, so the stop keeps its place.  It is 
+    // counted again in the hash at its new limit price.
+    leave_stops(stop->first, stop->second);
+    stop->second.change_qty(size_delta);
+    stop->second.set_price(price);
+    // If the size change closed the order
+    if (stop->second.filled()) {
+      callbacks_.push_back(TypedCallback::cancel(order, trans_id_));
+      unschedule(stop->second);
+      stops.erase(stop);
+    } else {
+      change_hash(stop->first, stop->second, stop->second.open_qty(), 
+                  hash_stop);
+    }
+  }
+  return true;
+}
+
+template <class OrderPtr, class MatchPolicy>
+inline void
+OrderBook<OrderPtr, MatchPolicy>::publish_uncross()
+{
+  ladder_.indicative_uncross(uncross_);
+  callbacks_.push_back(TypedCallback::uncross_update(uncross_, trans_id_));
+}
+
+template <class OrderPtr, class MatchPolicy>
 inline bool
-OrderBook<OrderPtr>::matches(
+OrderBook<OrderPtr, MatchPolicy>::matches(
   const Tracker& /*inbound_order*/,
   const Price& inbound_price, 
   const Quantity inbound_open_qty,
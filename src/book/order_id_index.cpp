@@ -0,0 +1,123 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "order_id_index.h"
+
+namespace liquibook { namespace book {
+
+namespace {
+  const uint32_t INITIAL_BITS = 4;
+  // Fibonacci hashing multiplier, 2^64 divided by the golden ratio
+  const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+}
+
+OrderIdIndex::OrderIdIndex()
+: entries_(1 << INITIAL_BITS),
+  size_(0),
+  shift_(64 - INITIAL_BITS)
+{
+}
+
+uint32_t
+OrderIdIndex::size() const
+{
+  return size_;
+}
+
+bool
+OrderIdIndex::insert(OrderId id, uint32_t value)
+{
+  // Keep the table at most half full
+  if ((size_ + 1) * 2 > entries_.size()) {
+    grow();
+  }
+  uint32_t pos = home(id);
+  while (entries_[pos].used) {
+    if (entries_[pos].id == id) {
+      return false;
+    }
+    pos = (pos + 1) & mask();
+  }
+  entries_[pos].id = id;
+  entries_[pos].value = value;
+  entries_[pos].used = true;
+  ++size_;
+  return true;
+}
+
+bool
+OrderIdIndex::find(OrderId id, uint32_t& value) const
+{
+  for (uint32_t pos = home(id); entries_[pos].used; pos = (pos + 1) & mask()) {
+    if (entries_[pos].id == id) {
+      value = entries_[pos].value;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+OrderIdIndex::erase(OrderId id)
+{
+  uint32_t pos = home(id);
+  while (entries_[pos].used && entries_[pos].id != id) {
+    pos = (pos + 1) & mask();
+  }
+  if (!entries_[pos].used) {
+    return false;
+  }
+  // Shift back the entries which probed past the erased one
+  uint32_t next = (pos + 1) & mask();
+  while (entries_[next].used) {
+    const uint32_t next_home = home(entries_[next].id);
+    // If the entry's home is not cyclically within (pos, next], move it
+    if (((next - next_home) & mask()) >= ((next - pos) & mask())) {
+      entries_[pos] = entries_[next];
+      pos = next;
+    }
+    next = (next + 1) & mask();
+  }
+  entries_[pos] = Entry();
+  --size_;
+  return true;
+}
+
+void
+OrderIdIndex::clear()
+{
+  for (Entries::iterator entry = entries_.begin();
+       entry != entries_.end(); ++entry) {
+    *entry = Entry();
+  }
+  size_ = 0;
+}
+
+uint32_t
+OrderIdIndex::home(OrderId id) const
+{
+  return uint32_t((id * HASH_MULTIPLIER) >> shift_);
+}
+
+uint32_t
+OrderIdIndex::mask() const
+{
+  return entries_.size() - 1;
+}
+
+void
+OrderIdIndex::grow()
+{
+  Entries prior(entries_.size() * 2);
+  prior.swap(entries_);
+  --shift_;
+  size_ = 0;
+  for (Entries::const_iterator entry = prior.begin();
+       entry != prior.end(); ++entry) {
+    if (entry->used) {
+      insert(entry->id, entry->value);
+    }
+  }
+}
+
+} }
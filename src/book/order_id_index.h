@@ -0,0 +1,65 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef order_id_index_h
+#define order_id_index_h
+
+#include "types.h"
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief hash index from order ID to a value, such as the position of the
+///        order in a pool.  Open addressing with linear probing, in a table
+///        kept at most half full, so finding, inserting and erasing are O(1)
+///        on average.  Erasing shifts later entries back, so no deleted
+///        markers build up.
+class OrderIdIndex {
+public:
+  /// @brief construct an empty index
+  OrderIdIndex();
+
+  /// @brief get the number of entries
+  uint32_t size() const;
+
+  /// @brief add an entry
+  /// @param id the order ID
+  /// @param value the value of the entry
+  /// @return false if the ID already has an entry
+  bool insert(OrderId id, uint32_t value);
+
+  /// @brief find an entry
+  /// @param id the order ID
+  /// @param value the value of the entry (out)
+  /// @return true if found
+  bool find(OrderId id, uint32_t& value) const;
+
+  /// @brief remove an entry
+  /// @param id the order ID
+  /// @return true if found
+  bool erase(OrderId id);
+
+  /// @brief remove every entry, keeping the table
+  void clear();
+
+private:
+  struct Entry {
+    Entry() : id(0), value(0), used(false) {}
+    OrderId id;
+    uint32_t value;
+    bool used;
+  };
+  typedef std::vector<Entry> Entries;
+
+  Entries entries_;
+  uint32_t size_;
+  uint32_t shift_;
+
+  uint32_t home(OrderId id) const;
+  uint32_t mask() const;
+  void grow();
+};
+
+} }
+
+#endif
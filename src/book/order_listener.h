@@ -44,6 +44,19 @@ public:
 
   /// @brief callback for an order replace rejection
   virtual void on_replace_reject(const OrderPtr& order, const char* reason) = 0;
+
+  /// @brief callback for a stop order trigger
+  virtual void on_trigger(const OrderPtr& order) = 0;
+
+  /// @brief callback for a change in the displayed quantity of an iceberg
+  /// @param order the iceberg order
+  /// @param visible_qty the quantity now displayed
+  virtual void on_display(const OrderPtr& order, Quantity visible_qty) = 0;
+
+  /// @brief callback for a mass cancel
+  /// @param orders the cancelled orders
+  /// @param count the number of cancelled orders
+  virtual void on_mass_cancel(const OrderPtr* orders, uint32_t count) = 0;
 };
 
 } }
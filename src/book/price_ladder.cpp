@@ -0,0 +1,176 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "price_ladder.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace liquibook { namespace book {
+
+IndicativeUncross::IndicativeUncross()
+: price(INVALID_LEVEL_PRICE),
+  matched_qty(0),
+  buy_surplus(0),
+  sell_surplus(0)
+{
+}
+
+PriceLadder::PriceLadder()
+: low_price_(0),
+  size_(0),
+  total_bid_qty_(0)
+{
+}
+
+void
+PriceLadder::reset(Price low_price, Price high_price)
+{
+  if (high_price < low_price) {
+    throw std::runtime_error("PriceLadder::reset high price below low price");
+  }
+  low_price_ = low_price;
+  size_ = high_price - low_price + 1;
+  total_bid_qty_ = 0;
+  // Fenwick trees are indexed from 1
+  bid_tree_.assign(size_ + 1, 0);
+  ask_tree_.assign(size_ + 1, 0);
+  cross_tree_.assign(size_ + 1, 0);
+}
+
+bool
+PriceLadder::empty() const
+{
+  return size_ == 0;
+}
+
+void
+PriceLadder::change_bid_qty(Price price, int32_t qty_delta)
+{
+  uint32_t bid_index = index(price);
+  update(bid_tree_, bid_index, qty_delta);
+  // A bid adds demand to every price at or below its own, so it is counted
+  // in the cross tree from the next price up
+  if (bid_index + 1 < size_) {
+    update(cross_tree_, bid_index + 1, qty_delta);
+  }
+  total_bid_qty_ += qty_delta;
+}
+
+void
+PriceLadder::change_ask_qty(Price price, int32_t qty_delta)
+{
+  uint32_t ask_index = index(price);
+  update(ask_tree_, ask_index, qty_delta);
+  update(cross_tree_, ask_index, qty_delta);
+}
+
+Quantity
+PriceLadder::bid_qty_at_or_above(Price price) const
+{
+  return size_ ? demand(index(price)) : 0;
+}
+
+Quantity
+PriceLadder::ask_qty_at_or_below(Price price) const
+{
+  return size_ ? supply(index(price)) : 0;
+}
+
+void
+PriceLadder::indicative_uncross(IndicativeUncross& result) const
+{
+  result = IndicativeUncross();
+  if (!size_) {
+    return;
+  }
+  // Demand never increases and supply never decreases as price increases.
+  // Find the count of prices at which demand covers supply - matched
+  // quantity is greatest at the last of these prices, or the one after.
+  uint32_t covered = count_at_or_below(cross_tree_, total_bid_qty_);
+  uint32_t first = covered ? covered - 1 : 0;
+  uint32_t last = (covered < size_) ? covered : size_ - 1;
+
+  for (uint32_t candidate = first; candidate <= last; ++candidate) {
+    Quantity bid_qty = demand(candidate);
+    Quantity ask_qty = supply(candidate);
+    Quantity matched_qty = std::min(bid_qty, ask_qty);
+    Quantity surplus = std::max(bid_qty, ask_qty) - matched_qty;
+    // If this price is better than any seen so far
+    if ((matched_qty > result.matched_qty) ||
+        (matched_qty && (matched_qty == result.matched_qty) &&
+         (surplus < result.buy_surplus + result.sell_surplus))) {
+      result.price = price_at(candidate);
+      result.matched_qty = matched_qty;
+      result.buy_surplus = bid_qty - matched_qty;
+      result.sell_surplus = ask_qty - matched_qty;
+    }
+  }
+}
+
+uint32_t
+PriceLadder::index(Price price) const
+{
+  if (price <= low_price_) {
+    return 0;
+  } else if (price - low_price_ >= size_) {
+    return size_ - 1;
+  }
+  return price - low_price_;
+}
+
+Price
+PriceLadder::price_at(uint32_t index) const
+{
+  return low_price_ + index;
+}
+
+void
+PriceLadder::update(Tree& tree, uint32_t index, int32_t qty_delta)
+{
+  for (uint32_t pos = index + 1; pos < tree.size(); pos += pos & (~pos + 1)) {
+    tree[pos] += qty_delta;
+  }
+}
+
+Quantity
+PriceLadder::prefix_sum(const Tree& tree, uint32_t index)
+{
+  Quantity sum = 0;
+  for (uint32_t pos = index + 1; pos > 0; pos -= pos & (~pos + 1)) {
+    sum += tree[pos];
+  }
+  return sum;
+}
+
+Quantity
+PriceLadder::demand(uint32_t index) const
+{
+  return index ? total_bid_qty_ - prefix_sum(bid_tree_, index - 1)
+               : total_bid_qty_;
+}
+
+Quantity
+PriceLadder::supply(uint32_t index) const
+{
+  return prefix_sum(ask_tree_, index);
+}
+
+uint32_t
+PriceLadder::count_at_or_below(const Tree& tree, Quantity qty) const
+{
+  uint32_t step = 1;
+  while ((step << 1) <= size_) {
+    step <<= 1;
+  }
+  // Descend the tree, taking each step which keeps the sum within qty
+  uint32_t count = 0;
+  for ( ; step; step >>= 1) {
+    if ((count + step <= size_) && (tree[count + step] <= qty)) {
+      count += step;
+      qty -= tree[count];
+    }
+  }
+  return count;
+}
+
+} }
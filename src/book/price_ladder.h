@@ -0,0 +1,94 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef price_ladder_h
+#define price_ladder_h
+
+#include "types.h"
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief result of an indicative uncross calculation
+struct IndicativeUncross {
+  /// @brief construct
+  IndicativeUncross();
+
+  /// @brief the equilibrium price, or INVALID_LEVEL_PRICE if the book would
+  ///        not cross
+  Price price;
+  /// @brief the quantity which would trade at the equilibrium price
+  Quantity matched_qty;
+  /// @brief the unmatched buy quantity at the equilibrium price
+  Quantity buy_surplus;
+  /// @brief the unmatched sell quantity at the equilibrium price
+  Quantity sell_surplus;
+};
+
+/// @brief open quantity by price over a fixed range of prices (one price
+///        per tick).  Quantities are held in Fenwick (binary indexed) trees,
+///        so that an update and the indicative uncross calculation are each
+///        O(log n) in the number of prices in the ladder.
+///        Prices outside of the ladder, including market orders, are
+///        counted at the nearest end of the ladder.
+class PriceLadder {
+public:
+  /// @brief construct an empty ladder
+  PriceLadder();
+
+  /// @brief reset the ladder to cover a price range, with no quantity
+  /// @param low_price the lowest price in the ladder
+  /// @param high_price the highest price in the ladder
+  void reset(Price low_price, Price high_price);
+
+  /// @brief does this ladder cover any prices?
+  bool empty() const;
+
+  /// @brief add or remove bid quantity at a price
+  /// @param price the price of the bid
+  /// @param qty_delta the change in bid quantity (+ or -)
+  void change_bid_qty(Price price, int32_t qty_delta);
+
+  /// @brief add or remove ask quantity at a price
+  /// @param price the price of the ask
+  /// @param qty_delta the change in ask quantity (+ or -)
+  void change_ask_qty(Price price, int32_t qty_delta);
+
+  /// @brief get the total bid quantity at or above a price
+  Quantity bid_qty_at_or_above(Price price) const;
+
+  /// @brief get the total ask quantity at or below a price
+  Quantity ask_qty_at_or_below(Price price) const;
+
+  /// @brief calculate the price which maximizes matched quantity, should
+  ///        the bids and asks in the ladder be crossed.  Ties are broken by
+  ///        minimum surplus.
+  /// @param result the calculated uncross (out)
+  void indicative_uncross(IndicativeUncross& result) const;
+
+private:
+  typedef std::vector<Quantity> Tree;
+  Price low_price_;
+  uint32_t size_;
+  Quantity total_bid_qty_;
+  // Bid quantity by price index
+  Tree bid_tree_;
+  // Ask quantity by price index
+  Tree ask_tree_;
+  // Bid quantity shifted up by one index, plus ask quantity.  The prefix sum
+  // of this tree through index i is the bid quantity priced below i plus the
+  // ask quantity priced at or below i, which never decreases as i increases.
+  Tree cross_tree_;
+
+  uint32_t index(Price price) const;
+  Price price_at(uint32_t index) const;
+  static void update(Tree& tree, uint32_t index, int32_t qty_delta);
+  static Quantity prefix_sum(const Tree& tree, uint32_t index);
+  Quantity demand(uint32_t index) const;
+  Quantity supply(uint32_t index) const;
+  uint32_t count_at_or_below(const Tree& tree, Quantity qty) const;
+};
+
+} }
+
+#endif
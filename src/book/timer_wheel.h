@@ -0,0 +1,274 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef timer_wheel_h
+#define timer_wheel_h
+
+#include "types.h"
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief identifier of a scheduled timer, or 0 for none
+typedef uint32_t TimerId;
+
+/// @brief hierarchical timer wheel of entries which expire at a given time.
+///        Each level has 64 slots, and each slot spans 64 times as long as a
+///        slot of the level below, so that 11 levels cover every Timestamp.
+///        An entry sits at the lowest level whose slots can tell its expiry
+///        time from the current time, and moves down as the current time
+///        reaches its slot.  Entries are linked in
+///        a pool of nodes, so scheduling and cancelling are O(1), and
+///        advancing costs a fixed number of slot checks per level plus
+///        O(1) per entry expired or moved, however far time advances.
+template <class Entry>
+class TimerWheel {
+public:
+  /// @brief construct an empty wheel at time 0
+  TimerWheel();
+
+  /// @brief get the current time of the wheel
+  Timestamp now() const;
+
+  /// @brief get the number of scheduled entries
+  uint32_t size() const;
+
+  /// @brief schedule an entry.  An entry due at or before the current time
+  ///        expires at the next advance.
+  /// @param expire_time the time at which the entry expires
+  /// @param entry the entry
+  /// @return the identifier of the timer, for cancel()
+  TimerId schedule(Timestamp expire_time, const Entry& entry);
+
+  /// @brief cancel a scheduled entry.  Has no effect if the timer has
+  ///        already expired or been cancelled.
+  void cancel(TimerId timer);
+
+  /// @brief advance the current time, expiring all entries due
+  /// @param now the new current time
+  /// @param expired the container to push the expired entries onto (out)
+  template <class Entries>
+  void advance(Timestamp now, Entries& expired);
+
+private:
+  static const unsigned SLOT_BITS = 6;
+  static const unsigned SLOTS = 1 << SLOT_BITS;
+  static const unsigned LEVELS = (64 + SLOT_BITS - 1) / SLOT_BITS;
+  // Lists of entries - a list per slot of each level, then entries already
+  // due
+  static const unsigned DUE_LIST = LEVELS * SLOTS;
+  static const unsigned LISTS = DUE_LIST + 1;
+  // Node 0 is never used, so that a TimerId of 0 means none
+  static const uint32_t NIL = 0;
+
+  struct Node {
+    Node() : expire_time(0), entry(), prev(NIL), next(NIL), list(0),
+             in_use(false) {}
+    Timestamp expire_time;
+    Entry entry;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t list;
+    bool in_use;
+  };
+  typedef std::vector<Node> Nodes;
+  typedef std::vector<uint32_t> NodeIndexes;
+
+  Nodes nodes_;
+  NodeIndexes free_nodes_;
+  NodeIndexes pending_;
+  uint32_t heads_[LISTS];
+  uint64_t occupied_[LEVELS];
+  Timestamp now_;
+  uint32_t size_;
+
+  void place(uint32_t node);
+  void link(uint32_t node, uint32_t list);
+  void unlink(uint32_t node);
+  void take_list(uint32_t list);
+  void release(uint32_t node);
+};
+
+template <class Entry>
+TimerWheel<Entry>::TimerWheel()
+: nodes_(1),
+  now_(0),
+  size_(0)
+{
+  for (unsigned list = 0; list < LISTS; ++list) {
+    heads_[list] = NIL;
+  }
+  for (unsigned level = 0; level < LEVELS; ++level) {
+    occupied_[level] = 0;
+  }
+}
+
+template <class Entry>
+inline Timestamp
+TimerWheel<Entry>::now() const
+{
+  return now_;
+}
+
+template <class Entry>
+inline uint32_t
+TimerWheel<Entry>::size() const
+{
+  return size_;
+}
+
+template <class Entry>
+inline TimerId
+TimerWheel<Entry>::schedule(Timestamp expire_time, const Entry& entry)
+{
+  uint32_t node;
+  if (free_nodes_.empty()) {
+    node = nodes_.size();
+    nodes_.push_back(Node());
+  } else {
+    node = free_nodes_.back();
+    free_nodes_.pop_back();
+  }
+  nodes_[node].expire_time = expire_time;
+  nodes_[node].entry = entry;
+  nodes_[node].in_use = true;
+  place(node);
+  ++size_;
+  return node;
+}
+
+template <class Entry>
+inline void
+TimerWheel<Entry>::cancel(TimerId timer)
+{
+  if (timer != NIL && timer < nodes_.size() && nodes_[timer].in_use) {
+    unlink(timer);
+    release(timer);
+  }
+}
+
+template <class Entry>
+template <class Entries>
+inline void
+TimerWheel<Entry>::advance(Timestamp now, Entries& expired)
+{
+  if (now <= now_) {
+    return;
+  }
+  pending_.clear();
+  take_list(DUE_LIST);
+  // Take the slots of each level which time reaches
+  for (unsigned level = 0; level < LEVELS; ++level) {
+    if (!occupied_[level]) {
+      continue;
+    }
+    const unsigned shift = SLOT_BITS * level;
+    unsigned first_slot = 0;
+    unsigned last_slot = SLOTS - 1;
+    // If time stays within this level's range, take only the slots passed.
+    // Time never leaves the range of the top level.
+    if ((level + 1 == LEVELS) ||
+        ((now >> (shift + SLOT_BITS)) == (now_ >> (shift + SLOT_BITS)))) {
+      first_slot = ((now_ >> shift) & (SLOTS - 1)) + 1;
+      last_slot = (now >> shift) & (SLOTS - 1);
+    }
+    for (unsigned slot = first_slot; slot <= last_slot; ++slot) {
+      if (occupied_[level] & (uint64_t(1) << slot)) {
+        take_list(level * SLOTS + slot);
+      }
+    }
+  }
+
+  // Expire what is due, and move the rest closer to the new time
+  now_ = now;
+  for (NodeIndexes::iterator node = pending_.begin();
+       node != pending_.end(); ++node) {
+    if (nodes_[*node].expire_time <= now_) {
+      expired.push_back(nodes_[*node].entry);
+      release(*node);
+    } else {
+      place(*node);
+    }
+  }
+}
+
+template <class Entry>
+inline void
+TimerWheel<Entry>::place(uint32_t node)
+{
+  const Timestamp expire_time = nodes_[node].expire_time;
+  if (expire_time <= now_) {
+    link(node, DUE_LIST);
+    return;
+  }
+  // Find the lowest level above which the expiry and current times agree
+  const Timestamp differ = expire_time ^ now_;
+  unsigned level = 0;
+  while ((level + 1 < LEVELS) && (differ >> (SLOT_BITS * (level + 1)))) {
+    ++level;
+  }
+  unsigned slot = (expire_time >> (SLOT_BITS * level)) & (SLOTS - 1);
+  link(node, level * SLOTS + slot);
+  occupied_[level] |= uint64_t(1) << slot;
+}
+
+template <class Entry>
+inline void
+TimerWheel<Entry>::link(uint32_t node, uint32_t list)
+{
+  Node& linked = nodes_[node];
+  linked.list = list;
+  linked.prev = NIL;
+  linked.next = heads_[list];
+  if (linked.next != NIL) {
+    nodes_[linked.next].prev = node;
+  }
+  heads_[list] = node;
+}
+
+template <class Entry>
+inline void
+TimerWheel<Entry>::unlink(uint32_t node)
+{
+  Node& unlinked = nodes_[node];
+  if (unlinked.prev != NIL) {
+    nodes_[unlinked.prev].next = unlinked.next;
+  } else {
+    heads_[unlinked.list] = unlinked.next;
+  }
+  if (unlinked.next != NIL) {
+    nodes_[unlinked.next].prev = unlinked.prev;
+  }
+  // If a slot is now empty, mark it so
+  if (heads_[unlinked.list] == NIL && unlinked.list < DUE_LIST) {
+    occupied_[unlinked.list / SLOTS] &=
+        ~(uint64_t(1) << (unlinked.list % SLOTS));
+  }
+}
+
+template <class Entry>
+inline void
+TimerWheel<Entry>::take_list(uint32_t list)
+{
+  for (uint32_t node = heads_[list]; node != NIL; node = nodes_[node].next) {
+    pending_.push_back(node);
+  }
+  heads_[list] = NIL;
+  if (list < DUE_LIST) {
+    occupied_[list / SLOTS] &= ~(uint64_t(1) << (list % SLOTS));
+  }
+}
+
+template <class Entry>
+inline void
+TimerWheel<Entry>::release(uint32_t node)
+{
+  nodes_[node].in_use = false;
+  nodes_[node].entry = Entry();
+  free_nodes_.push_back(node);
+  --size_;
+}
+
+} }
+
+#endif
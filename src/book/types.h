@@ -15,10 +15,28 @@ namespace liquibook { namespace book {
   typedef uint32_t ChangeId;
   typedef uint32_t TransId;
   typedef uint32_t OrderConditions;
+  typedef uint32_t OwnerId;
+  typedef uint64_t Timestamp;
+  typedef uint64_t OrderId;
 
   enum OrderCondition {
     oc_all_or_none = 1,
-    oc_immediate_or_cancel = oc_all_or_none * 2
+    oc_immediate_or_cancel = oc_all_or_none * 2,
+    oc_minimum_qty = oc_immediate_or_cancel * 2  // see Order::min_qty()
+  };
+
+  // Action taken when orders with the same owner would match
+  enum SelfTradePrevention {
+    stp_cancel_newest,  // cancel the inbound order
+    stp_cancel_oldest,  // cancel the resting order
+    stp_decrement_both  // reduce both orders by the smaller open quantity
+  };
+
+  // Price an order is pegged to, rather than a fixed limit price
+  enum PegType {
+    peg_none,
+    peg_primary,  // the best price of the order's own side
+    peg_midpoint  // the midpoint of the best bid and best offer
   };
 
   // Constants used in liquibook
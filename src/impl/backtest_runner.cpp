@@ -0,0 +1,130 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "backtest_runner.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace liquibook { namespace impl {
+
+namespace {
+  // The jobs of one worker
+  struct Worker {
+    Backtest* backtest;
+    const EventRecord* begin;
+    const EventRecord* end;
+    uint32_t first_job;
+    uint32_t job_step;
+    uint32_t job_count;
+  };
+
+  void run_jobs(const Worker& worker)
+  {
+    for (uint32_t job = worker.first_job; job < worker.job_count;
+         job += worker.job_step) {
+      worker.backtest->run_job(job, worker.begin, worker.end);
+    }
+  }
+
+#ifdef _WIN32
+  DWORD WINAPI worker_main(LPVOID worker)
+  {
+    run_jobs(*static_cast<Worker*>(worker));
+    return 0;
+  }
+#else
+  void* worker_main(void* worker)
+  {
+    run_jobs(*static_cast<Worker*>(worker));
+    return NULL;
+  }
+#endif
+}
+
+Backtest::~Backtest()
+{
+}
+
+BacktestRunner::BacktestRunner(uint32_t worker_count)
+: worker_count_(worker_count ? worker_count : 1)
+{
+}
+
+uint32_t
+BacktestRunner::worker_count() const
+{
+  return worker_count_;
+}
+
+bool
+BacktestRunner::run(Backtest& backtest,
+                    const EventFileReader& events,
+                    uint32_t job_count)
+{
+  std::vector<Worker> workers(worker_count_);
+  for (uint32_t index = 0; index < worker_count_; ++index) {
+    Worker& worker = workers[index];
+    worker.backtest = &backtest;
+    worker.begin = events.begin();
+    worker.end = events.end();
+    worker.first_job = index;
+    worker.job_step = worker_count_;
+    worker.job_count = job_count;
+  }
+
+  // Start the other workers, then work on this thread
+  bool started = true;
+#ifdef _WIN32
+  std::vector<HANDLE> threads;
+  for (uint32_t index = 1; index < worker_count_; ++index) {
+    HANDLE thread = CreateThread(NULL, 0, worker_main, &workers[index],
+                                 0, NULL);
+    if (thread) {
+      threads.push_back(thread);
+    } else {
+      started = false;
+    }
+  }
+  run_jobs(workers[0]);
+  for (size_t index = 0; index < threads.size(); ++index) {
+    WaitForSingleObject(threads[index], INFINITE);
+    CloseHandle(threads[index]);
+  }
+#else
+  std::vector<pthread_t> threads;
+  for (uint32_t index = 1; index < worker_count_; ++index) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker_main, &workers[index]) == 0) {
+      threads.push_back(thread);
+    } else {
+      started = false;
+    }
+  }
+  run_jobs(workers[0]);
+  for (size_t index = 0; index < threads.size(); ++index) {
+    pthread_join(threads[index], NULL);
+  }
+#endif
+  return started;
+}
+
+BacktestResult::BacktestResult()
+: events_applied(0),
+  orders_added(0),
+  traded_qty(0)
+{
+}
+
+void
+BacktestResult::add(const BacktestResult& other)
+{
+  events_applied += other.events_applied;
+  orders_added += other.orders_added;
+  traded_qty += other.traded_qty;
+}
+
+} }
@@ -0,0 +1,146 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef backtest_runner_h
+#define backtest_runner_h
+
+#include "event_file.h"
+#include "event_replay.h"
+#include <vector>
+
+namespace liquibook { namespace impl {
+
+/// @brief jobs run over the same events, such as the parameter sets of a
+///        sweep.  Jobs run at the same time on different threads, so a job
+///        must only change state of its own.
+class Backtest {
+public:
+  virtual ~Backtest();
+
+  /// @brief run a job over the events
+  /// @param job the index of the job
+  /// @param begin the first event
+  /// @param end one past the last event
+  virtual void run_job(uint32_t job,
+                       const EventRecord* begin,
+                       const EventRecord* end) = 0;
+};
+
+/// @brief runner of a backtest's jobs on a pool of worker threads.  Every
+///        worker reads the same mapped events, which are never written.
+///        Worker n runs jobs n, n + workers, n + 2 * workers, and so on, as
+///        jobs over the same events take about as long as each other.  The
+///        calling thread is the first worker.
+class BacktestRunner {
+public:
+  /// @brief construct a runner
+  /// @param worker_count the number of workers, at least 1
+  explicit BacktestRunner(uint32_t worker_count);
+
+  /// @brief get the number of workers
+  uint32_t worker_count() const;
+
+  /// @brief run every job of a backtest, and wait for them to finish
+  /// @param backtest the backtest
+  /// @param events the events to run over
+  /// @param job_count the number of jobs
+  /// @return false if a worker thread could not be started.  Jobs of
+  ///         workers which did start have still run.
+  bool run(Backtest& backtest,
+           const EventFileReader& events,
+           uint32_t job_count);
+
+private:
+  uint32_t worker_count_;
+};
+
+/// @brief the outcome of replaying events into a book
+struct BacktestResult {
+  BacktestResult();
+  /// @brief add another result into this one
+  void add(const BacktestResult& other);
+
+  uint64_t events_applied;
+  uint64_t orders_added;
+  uint64_t traded_qty;
+};
+
+/// @brief backtest which replays the events into a new order book for each
+///        job, and keeps each job's result.  Each job's book and orders are
+///        its own, made and freed on its worker's thread.
+template <class OrderBook>
+class ReplayBacktest : public Backtest {
+public:
+  /// @brief construct for a number of jobs
+  explicit ReplayBacktest(uint32_t job_count);
+
+  virtual void run_job(uint32_t job,
+                       const EventRecord* begin,
+                       const EventRecord* end);
+
+  /// @brief get the result of a job
+  const BacktestResult& result(uint32_t job) const;
+
+  /// @brief get the results of every job added together
+  BacktestResult total() const;
+
+protected:
+  /// @brief set up a job's book before its replay, such as to apply the
+  ///        job's parameters.  Does nothing by default.
+  virtual void prepare(uint32_t job, OrderBook& order_book);
+
+private:
+  typedef std::vector<BacktestResult> Results;
+  // Sized up front, so each job writes only its own element
+  Results results_;
+};
+
+template <class OrderBook>
+ReplayBacktest<OrderBook>::ReplayBacktest(uint32_t job_count)
+: results_(job_count)
+{
+}
+
+template <class OrderBook>
+inline void
+ReplayBacktest<OrderBook>::run_job(uint32_t job,
+                                   const EventRecord* begin,
+                                   const EventRecord* end)
+{
+  OrderBook order_book;
+  prepare(job, order_book);
+  EventReplay<OrderBook> replay(order_book);
+  BacktestResult& result = results_[job];
+  result.events_applied = replay.replay(begin, end);
+  result.orders_added = replay.order_count();
+  result.traded_qty = replay.traded_qty();
+}
+
+template <class OrderBook>
+inline const BacktestResult&
+ReplayBacktest<OrderBook>::result(uint32_t job) const
+{
+  return results_[job];
+}
+
+template <class OrderBook>
+inline BacktestResult
+ReplayBacktest<OrderBook>::total() const
+{
+  BacktestResult total;
+  for (typename Results::const_iterator result = results_.begin();
+       result != results_.end(); ++result) {
+    total.add(*result);
+  }
+  return total;
+}
+
+template <class OrderBook>
+inline void
+ReplayBacktest<OrderBook>::prepare(uint32_t, OrderBook&)
+{
+}
+
+} }
+
+#endif
@@ -0,0 +1,161 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef book_replica_h
+#define book_replica_h
+
+#include "command_ring.h"
+#include "event_replay.h"
+#include <string.h>
+
+namespace liquibook { namespace impl {
+
+/// @brief one of the primary and backup copies of an order book, for hot
+///        standby on one host.  A book given the same commands makes the
+///        same transactions, so the primary publishes each command it
+///        applies to a ring in shared memory, and the backup applies the
+///        commands from the ring to its own book, in lockstep.  Each
+///        command carries the primary's transaction ID and book hash after
+///        it, for the backup to check its book against.
+///
+///        If the primary stops, the backup applies the commands left in the
+///        ring and takes over from where the primary was, with nothing to
+///        replay: it applies new commands itself, and may publish them to a
+///        new backup.  Finding that the primary has stopped, such as by a
+///        heartbeat, is left to the caller.
+template <class OrderBook>
+class BookReplica {
+public:
+  /// @brief construct a replica of a book
+  explicit BookReplica(OrderBook& order_book);
+
+  /// @brief apply a command to the book
+  /// @return true if the command was applied.  Adds of an order ID whose
+  ///         order is not done, and cancels or replaces of an unknown ID or
+  ///         of an order which is done, are skipped.
+  bool apply(const EventRecord& event);
+
+  /// @brief apply a command to the book as the primary, and publish it to
+  ///        the backup.  A command skipped by the book is not published.
+  /// @param event the command
+  /// @param ring the ring to the backup
+  /// @return false if the ring is full, and nothing was applied
+  bool publish(const EventRecord& event, CommandRing& ring);
+
+  /// @brief apply the commands published to the ring as the backup
+  /// @param ring the ring from the primary
+  /// @param max_count the most commands to apply, or 0 for no limit
+  /// @return the number of commands applied
+  uint32_t follow(CommandRing& ring, uint32_t max_count = 0);
+
+  /// @brief has a command left the book in another state than the
+  ///        primary's, or been missed?
+  bool diverged() const;
+
+  /// @brief get the sequence number of the last command applied
+  uint64_t sequence() const;
+
+  /// @brief find the order created for an order ID
+  /// @return the order, or NULL if the ID was never added, or its order is
+  ///         done and has been freed
+  SimpleOrder* find(OrderId order_id);
+
+  /// @brief access the book
+  OrderBook& order_book();
+
+private:
+  OrderBook& order_book_;
+  EventReplay<OrderBook> replay_;
+  uint64_t sequence_;
+  bool diverged_;
+};
+
+template <class OrderBook>
+BookReplica<OrderBook>::BookReplica(OrderBook& order_book)
+: order_book_(order_book),
+  replay_(order_book),
+  sequence_(0),
+  diverged_(false)
+{
+}
+
+template <class OrderBook>
+inline bool
+BookReplica<OrderBook>::apply(const EventRecord& event)
+{
+  if (replay_.replay(&event, &event + 1)) {
+    ++sequence_;
+    return true;
+  }
+  return false;
+}
+
+template <class OrderBook>
+inline bool
+BookReplica<OrderBook>::publish(const EventRecord& event, CommandRing& ring)
+{
+  // Apply only what can be published, so the backup never falls behind
+  if (!ring.can_write()) {
+    return false;
+  }
+  if (apply(event)) {
+    ReplicatedCommand command;
+    memset(&command, 0, sizeof(command));
+    command.sequence = sequence_;
+    command.trans_id = order_book_.trans_id();
+    command.book_hash = order_book_.book_hash();
+    command.event = event;
+    ring.write(command);
+  }
+  return true;
+}
+
+template <class OrderBook>
+inline uint32_t
+BookReplica<OrderBook>::follow(CommandRing& ring, uint32_t max_count)
+{
+  uint32_t applied = 0;
+  ReplicatedCommand command;
+  while ((!max_count || applied < max_count) && ring.read(command)) {
+    const bool in_sequence = command.sequence == sequence_ + 1;
+    if (!apply(command.event) || !in_sequence ||
+        command.trans_id != order_book_.trans_id() ||
+        command.book_hash != order_book_.book_hash()) {
+      diverged_ = true;
+    }
+    ++applied;
+  }
+  return applied;
+}
+
+template <class OrderBook>
+inline bool
+BookReplica<OrderBook>::diverged() const
+{
+  return diverged_;
+}
+
+template <class OrderBook>
+inline uint64_t
+BookReplica<OrderBook>::sequence() const
+{
+  return sequence_;
+}
+
+template <class OrderBook>
+inline SimpleOrder*
+BookReplica<OrderBook>::find(OrderId order_id)
+{
+  return replay_.find(order_id);
+}
+
+template <class OrderBook>
+inline OrderBook&
+BookReplica<OrderBook>::order_book()
+{
+  return order_book_;
+}
+
+} }
+
+#endif
@@ -0,0 +1,158 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "command_ring.h"
+#include <string.h>
+
+namespace liquibook { namespace impl {
+
+namespace {
+  const char COMMAND_RING_MAGIC[4] = { 'L', 'B', 'C', 'R' };
+  const uint32_t COMMAND_RING_VERSION = 1;
+  const uint32_t CACHE_LINE_SIZE = 64;
+}
+
+// The counts are written by different processes, so each has a cache line
+struct CommandRing::Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t command_size;
+  uint32_t capacity;
+  uint8_t padding0[CACHE_LINE_SIZE - 16];
+  volatile uint64_t write_count;
+  uint8_t padding1[CACHE_LINE_SIZE - 8];
+  volatile uint64_t read_count;
+  uint8_t padding2[CACHE_LINE_SIZE - 8];
+};
+
+CommandRing::CommandRing()
+: header_(NULL),
+  commands_(NULL),
+  mask_(0)
+{
+}
+
+bool
+CommandRing::create(const char* path, uint32_t capacity)
+{
+  close();
+  uint32_t ring_capacity = 1;
+  while (ring_capacity < capacity) {
+    ring_capacity *= 2;
+  }
+  if (!region_.create(path, sizeof(Header) +
+                            ring_capacity * sizeof(ReplicatedCommand))) {
+    return false;
+  }
+  // The region is zero filled, so both counts start at 0
+  Header* header = static_cast<Header*>(region_.address());
+  header->version = COMMAND_RING_VERSION;
+  header->command_size = sizeof(ReplicatedCommand);
+  header->capacity = ring_capacity;
+  // Mark the ring as ready last
+  memory_barrier();
+  memcpy(header->magic, COMMAND_RING_MAGIC, sizeof(header->magic));
+  return attach();
+}
+
+bool
+CommandRing::open(const char* path)
+{
+  close();
+  return region_.open(path) && attach();
+}
+
+void
+CommandRing::close()
+{
+  region_.close();
+  header_ = NULL;
+  commands_ = NULL;
+  mask_ = 0;
+}
+
+bool
+CommandRing::is_open() const
+{
+  return header_ != NULL;
+}
+
+uint32_t
+CommandRing::capacity() const
+{
+  return mask_ + 1;
+}
+
+bool
+CommandRing::write(const ReplicatedCommand& command)
+{
+  if (!can_write()) {
+    return false;
+  }
+  const uint64_t count = header_->write_count;
+  commands_[count & mask_] = command;
+  // Publish the command only once it is whole
+  memory_barrier();
+  header_->write_count = count + 1;
+  return true;
+}
+
+bool
+CommandRing::can_write() const
+{
+  return header_ && header_->write_count - header_->read_count <= mask_;
+}
+
+bool
+CommandRing::read(ReplicatedCommand& command)
+{
+  if (!header_) {
+    return false;
+  }
+  const uint64_t count = header_->read_count;
+  if (count == header_->write_count) {
+    return false;
+  }
+  // Read the command only after seeing it published
+  memory_barrier();
+  command = commands_[count & mask_];
+  // Free the slot only once the command is copied out
+  memory_barrier();
+  header_->read_count = count + 1;
+  return true;
+}
+
+uint64_t
+CommandRing::write_count() const
+{
+  return header_ ? header_->write_count : 0;
+}
+
+uint64_t
+CommandRing::read_count() const
+{
+  return header_ ? header_->read_count : 0;
+}
+
+bool
+CommandRing::attach()
+{
+  Header* header = static_cast<Header*>(region_.address());
+  const size_t size = region_.size();
+  if (size < sizeof(Header) ||
+      memcmp(header->magic, COMMAND_RING_MAGIC, sizeof(header->magic)) ||
+      header->version != COMMAND_RING_VERSION ||
+      header->command_size != sizeof(ReplicatedCommand) ||
+      !header->capacity || (header->capacity & (header->capacity - 1)) ||
+      (size - sizeof(Header)) / sizeof(ReplicatedCommand) <
+          header->capacity) {
+    close();
+    return false;
+  }
+  header_ = header;
+  commands_ = reinterpret_cast<ReplicatedCommand*>(header + 1);
+  mask_ = header->capacity - 1;
+  return true;
+}
+
+} }
@@ -0,0 +1,87 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef command_ring_h
+#define command_ring_h
+
+#include "event_file.h"
+#include "shared_region.h"
+
+namespace liquibook { namespace impl {
+
+using book::TransId;
+
+/// @brief a command applied by a primary book, as published to its backup
+struct ReplicatedCommand {
+  uint64_t sequence;    // the number of the command, from 1
+  TransId trans_id;     // the primary's last transaction after the command
+  uint32_t reserved;
+  uint64_t book_hash;   // the primary's book hash after the command
+  EventRecord event;    // the command
+  uint8_t padding[8];   // to a whole number of commands per cache line
+};
+
+/// @brief ring of replicated commands in shared memory, written by one
+///        process and read by one other.  Neither side locks: the writer
+///        publishes a command by advancing its count after the command is
+///        written, and the reader frees it by advancing its own count after
+///        it is read.  The two counts lie on cache lines of their own.
+class CommandRing {
+public:
+  CommandRing();
+
+  /// @brief create the ring, replacing any file at the path
+  /// @param path the path of the shared file, such as one in /dev/shm
+  /// @param capacity the number of commands held, rounded up to a power of
+  ///        2
+  /// @return false if the ring can not be created
+  bool create(const char* path, uint32_t capacity);
+
+  /// @brief open a ring created by another process
+  /// @return false if the file can not be mapped or is not a ring
+  bool open(const char* path);
+
+  /// @brief unmap the ring
+  void close();
+
+  /// @brief is the ring mapped?
+  bool is_open() const;
+
+  /// @brief get the number of commands the ring holds
+  uint32_t capacity() const;
+
+  /// @brief publish a command
+  /// @return false if the ring is full
+  bool write(const ReplicatedCommand& command);
+
+  /// @brief is there room to publish a command?
+  bool can_write() const;
+
+  /// @brief take the next published command
+  /// @param command the command (out)
+  /// @return false if no command is waiting
+  bool read(ReplicatedCommand& command);
+
+  /// @brief get the number of commands written since the ring was created
+  uint64_t write_count() const;
+
+  /// @brief get the number of commands read since the ring was created
+  uint64_t read_count() const;
+
+private:
+  struct Header;
+
+  SharedRegion region_;
+  Header* header_;
+  ReplicatedCommand* commands_;
+  uint32_t mask_;
+
+  bool attach();
+
+  CommandRing(const CommandRing&);
+  CommandRing& operator=(const CommandRing&);
+};
+
+} }
+
+#endif
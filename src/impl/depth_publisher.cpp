@@ -0,0 +1,132 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "depth_publisher.h"
+
+namespace liquibook { namespace impl {
+
+namespace {
+  const char DEPTH_REGION_MAGIC[4] = { 'L', 'B', 'D', 'P' };
+  const uint32_t DEPTH_REGION_VERSION = 2;
+  const uint32_t CACHE_LINE_SIZE = 64;
+
+  uint32_t slot_size(uint32_t level_count)
+  {
+    const uint32_t size = sizeof(DepthSlotHeader) +
+                          2 * level_count * sizeof(DepthLevel);
+    return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  }
+}
+
+// The layout of the levels is checked, as readers copy them as they lie
+struct DepthRegion::Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t book_count;
+  uint32_t level_count;
+  uint32_t level_size;
+  uint32_t slot_size;
+  uint8_t padding[CACHE_LINE_SIZE - 24];
+};
+
+DepthRegion::DepthRegion()
+: header_(NULL),
+  slots_(NULL),
+  slot_size_(0)
+{
+}
+
+bool
+DepthRegion::create(const char* path,
+                    uint32_t book_count,
+                    uint32_t level_count)
+{
+  close();
+  const uint32_t size = slot_size(level_count);
+  if (!book_count ||
+      !region_.create(path, sizeof(Header) + size_t(book_count) * size)) {
+    return false;
+  }
+  // The region is zero filled, so no book is published
+  Header* header = static_cast<Header*>(region_.address());
+  header->version = DEPTH_REGION_VERSION;
+  header->book_count = book_count;
+  header->level_count = level_count;
+  header->level_size = sizeof(DepthLevel);
+  header->slot_size = size;
+  // Mark the region as ready last
+  memory_barrier();
+  memcpy(header->magic, DEPTH_REGION_MAGIC, sizeof(header->magic));
+  return attach(level_count);
+}
+
+bool
+DepthRegion::open(const char* path, uint32_t level_count)
+{
+  close();
+  return region_.open(path) && attach(level_count);
+}
+
+void
+DepthRegion::close()
+{
+  region_.close();
+  header_ = NULL;
+  slots_ = NULL;
+  slot_size_ = 0;
+}
+
+uint32_t
+DepthRegion::book_count() const
+{
+  return header_ ? header_->book_count : 0;
+}
+
+bool
+DepthRegion::find(const char* symbol, uint32_t& book) const
+{
+  for (uint32_t index = 0; index < book_count(); ++index) {
+    const DepthSlotHeader* header = slot(index);
+    if (!strncmp(header->symbol, symbol, sizeof(header->symbol))) {
+      book = index;
+      return true;
+    }
+  }
+  return false;
+}
+
+DepthSlotHeader*
+DepthRegion::slot(uint32_t book) const
+{
+  return reinterpret_cast<DepthSlotHeader*>(
+      slots_ + size_t(book) * slot_size_);
+}
+
+DepthLevel*
+DepthRegion::levels(uint32_t book) const
+{
+  return reinterpret_cast<DepthLevel*>(slot(book) + 1);
+}
+
+bool
+DepthRegion::attach(uint32_t level_count)
+{
+  Header* header = static_cast<Header*>(region_.address());
+  const size_t size = region_.size();
+  if (size < sizeof(Header) ||
+      memcmp(header->magic, DEPTH_REGION_MAGIC, sizeof(header->magic)) ||
+      header->version != DEPTH_REGION_VERSION ||
+      header->level_count != level_count ||
+      header->level_size != sizeof(DepthLevel) ||
+      header->slot_size != slot_size(level_count) ||
+      (size - sizeof(Header)) / header->slot_size < header->book_count) {
+    close();
+    return false;
+  }
+  header_ = header;
+  slots_ = reinterpret_cast<char*>(header + 1);
+  slot_size_ = header->slot_size;
+  return true;
+}
+
+} }
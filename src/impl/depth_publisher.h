@@ -0,0 +1,299 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef depth_publisher_h
+#define depth_publisher_h
+
+#include "shared_region.h"
+#include "book/depth.h"
+#include <algorithm>
+#include <string.h>
+
+namespace liquibook { namespace impl {
+
+using book::ChangeId;
+using book::Depth;
+using book::DepthLevel;
+
+/// @brief the header of a book's slot in a depth region
+struct DepthSlotHeader {
+  volatile uint32_t sequence; // odd while the levels are being written
+  volatile uint32_t published; // nonzero once the levels are first written
+  ChangeId last_change;       // the change stamp of the depth published
+  char symbol[24];            // the book's symbol, 0 terminated
+};
+
+/// @brief region of shared memory holding the depth of many books, each in
+///        a slot of its own.  A slot holds the bid levels and then the ask
+///        levels of a book, as laid out in Depth, and starts on a cache line
+///        so that books written at once do not share lines.
+class DepthRegion {
+public:
+  DepthRegion();
+
+  /// @brief create a region, replacing any file at the path
+  /// @param path the path of the shared file, such as one in /dev/shm
+  /// @param book_count the number of books
+  /// @param level_count the number of bid and ask levels of each book
+  /// @return false if the region can not be created
+  bool create(const char* path, uint32_t book_count, uint32_t level_count);
+
+  /// @brief open a region created by another process
+  /// @param path the path of the shared file
+  /// @param level_count the number of bid and ask levels of each book
+  /// @return false if the file can not be mapped, or is not a region of
+  ///         books with that number of levels
+  bool open(const char* path, uint32_t level_count);
+
+  /// @brief unmap the region
+  void close();
+
+  /// @brief get the number of books
+  uint32_t book_count() const;
+
+  /// @brief find a book by its symbol, in O(n) of the books
+  /// @param symbol the symbol
+  /// @param book the index of the book (out)
+  /// @return true if found
+  bool find(const char* symbol, uint32_t& book) const;
+
+  /// @brief access the header of a book's slot
+  DepthSlotHeader* slot(uint32_t book) const;
+
+  /// @brief access the levels of a book's slot
+  DepthLevel* levels(uint32_t book) const;
+
+private:
+  struct Header;
+
+  SharedRegion region_;
+  Header* header_;
+  char* slots_;
+  uint32_t slot_size_;
+
+  bool attach(uint32_t level_count);
+
+  DepthRegion(const DepthRegion&);
+  DepthRegion& operator=(const DepthRegion&);
+};
+
+/// @brief publisher of the depth of many books to processes on the same
+///        host, through a region of shared memory.  Each book's slot is
+///        guarded by a sequence lock: the sequence is odd while the levels
+///        are written, and is advanced again once they are whole.  The
+///        sequence may wrap, so whether a book was ever published is kept
+///        apart from it.  The publisher never waits for readers.  There must be only one
+///        publisher of a region.
+template <int SIZE = 5>
+class DepthPublisher {
+public:
+  typedef Depth<SIZE> SizedDepth;
+
+  /// @brief create the region
+  /// @param path the path of the shared file, such as one in /dev/shm
+  /// @param book_count the number of books
+  bool create(const char* path, uint32_t book_count);
+
+  /// @brief unmap the region, which is left for readers
+  void close();
+
+  /// @brief set the symbol of a book, which readers may find it by
+  /// @param book the index of the book
+  /// @param symbol the symbol, cut to 23 characters
+  void set_symbol(uint32_t book, const char* symbol);
+
+  /// @brief publish the depth of a book, if it changed since last published
+  /// @param book the index of the book
+  /// @param depth the depth
+  /// @return true if the depth was written
+  bool publish(uint32_t book, const SizedDepth& depth);
+
+  /// @brief get the number of books
+  uint32_t book_count() const;
+
+private:
+  DepthRegion region_;
+};
+
+/// @brief reader of the depth of many books, published by another process.
+///        Reads never block the publisher.  A read which overlaps a write is
+///        seen to do so, and tried again.
+template <int SIZE = 5>
+class DepthReader {
+public:
+  /// @brief open a region
+  /// @return false if the file can not be mapped, or is not a region of
+  ///         books of SIZE levels
+  bool open(const char* path);
+
+  /// @brief unmap the region
+  void close();
+
+  /// @brief find a book by its symbol, in O(n) of the books
+  bool find(const char* symbol, uint32_t& book) const;
+
+  /// @brief copy a consistent snapshot of a book's depth
+  /// @param book the index of the book
+  /// @param levels the bid levels and then the ask levels, SIZE of each
+  ///        (out)
+  /// @param last_change the change stamp of the depth (out)
+  /// @return false if the book's depth was never published
+  bool read(uint32_t book, DepthLevel* levels, ChangeId& last_change) const;
+
+  /// @brief start reading a book's levels in place, with no copy.  Waits
+  ///        out a write in progress.
+  /// @param book the index of the book
+  /// @param sequence the sequence to pass to end_read() (out)
+  /// @return false if the book's depth was never published
+  bool begin_read(uint32_t book, uint32_t& sequence) const;
+
+  /// @brief access a book's levels in place, bids and then asks.  Values
+  ///        read are good only if end_read() then returns true.
+  const DepthLevel* levels(uint32_t book) const;
+
+  /// @brief finish reading a book's levels in place
+  /// @param book the index of the book
+  /// @param sequence the sequence given by begin_read()
+  /// @return true if no write overlapped the read
+  bool end_read(uint32_t book, uint32_t sequence) const;
+
+  /// @brief get the number of books
+  uint32_t book_count() const;
+
+private:
+  DepthRegion region_;
+};
+
+template <int SIZE>
+inline bool
+DepthPublisher<SIZE>::create(const char* path, uint32_t book_count)
+{
+  return region_.create(path, book_count, SIZE);
+}
+
+template <int SIZE>
+inline void
+DepthPublisher<SIZE>::close()
+{
+  region_.close();
+}
+
+template <int SIZE>
+inline void
+DepthPublisher<SIZE>::set_symbol(uint32_t book, const char* symbol)
+{
+  DepthSlotHeader* slot = region_.slot(book);
+  const size_t length = strnlen(symbol, sizeof(slot->symbol) - 1);
+  memcpy(slot->symbol, symbol, length);
+  slot->symbol[length] = '\0';
+}
+
+template <int SIZE>
+inline bool
+DepthPublisher<SIZE>::publish(uint32_t book, const SizedDepth& depth)
+{
+  DepthSlotHeader* slot = region_.slot(book);
+  const uint32_t sequence = slot->sequence;
+  if (slot->published && slot->last_change == depth.last_change()) {
+    return false;
+  }
+  slot->sequence = sequence + 1;
+  memory_barrier();
+  // Copy level by level; DepthLevel is not trivially copyable
+  const DepthLevel* levels = depth.bids();
+  std::copy(levels, levels + SIZE * 2, region_.levels(book));
+  slot->last_change = depth.last_change();
+  slot->published = 1;
+  memory_barrier();
+  slot->sequence = sequence + 2;
+  return true;
+}
+
+template <int SIZE>
+inline uint32_t
+DepthPublisher<SIZE>::book_count() const
+{
+  return region_.book_count();
+}
+
+template <int SIZE>
+inline bool
+DepthReader<SIZE>::open(const char* path)
+{
+  return region_.open(path, SIZE);
+}
+
+template <int SIZE>
+inline void
+DepthReader<SIZE>::close()
+{
+  region_.close();
+}
+
+template <int SIZE>
+inline bool
+DepthReader<SIZE>::find(const char* symbol, uint32_t& book) const
+{
+  return region_.find(symbol, book);
+}
+
+template <int SIZE>
+inline bool
+DepthReader<SIZE>::read(uint32_t book,
+                        DepthLevel* levels,
+                        ChangeId& last_change) const
+{
+  for (;;) {
+    uint32_t sequence;
+    if (!begin_read(book, sequence)) {
+      return false;
+    }
+    const DepthLevel* published = region_.levels(book);
+    std::copy(published, published + SIZE * 2, levels);
+    last_change = region_.slot(book)->last_change;
+    if (end_read(book, sequence)) {
+      return true;
+    }
+  }
+}
+
+template <int SIZE>
+inline bool
+DepthReader<SIZE>::begin_read(uint32_t book, uint32_t& sequence) const
+{
+  const DepthSlotHeader* slot = region_.slot(book);
+  sequence = slot->sequence;
+  while (sequence & 1) {
+    sequence = slot->sequence;
+  }
+  // Read the flag and the levels only after the sequence
+  memory_barrier();
+  return slot->published != 0;
+}
+
+template <int SIZE>
+inline const DepthLevel*
+DepthReader<SIZE>::levels(uint32_t book) const
+{
+  return region_.levels(book);
+}
+
+template <int SIZE>
+inline bool
+DepthReader<SIZE>::end_read(uint32_t book, uint32_t sequence) const
+{
+  // Read the sequence again only after the levels
+  memory_barrier();
+  return region_.slot(book)->sequence == sequence;
+}
+
+template <int SIZE>
+inline uint32_t
+DepthReader<SIZE>::book_count() const
+{
+  return region_.book_count();
+}
+
+} }
+
+#endif
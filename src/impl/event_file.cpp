@@ -0,0 +1,290 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "event_file.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace liquibook { namespace impl {
+
+namespace {
+  const char EVENT_FILE_MAGIC[4] = { 'L', 'B', 'E', 'V' };
+  const uint32_t EVENT_FILE_VERSION = 1;
+
+  // Read an unsigned number, and the comma or end of line after it
+  bool parse_number(const char*& pos, uint64_t& value)
+  {
+    char* end;
+    value = strtoull(pos, &end, 10);
+    if (end == pos) {
+      return false;
+    }
+    pos = end;
+    if (*pos == ',') {
+      ++pos;
+    }
+    return true;
+  }
+
+  bool at_line_end(const char* pos)
+  {
+    while (*pos == ' ' || *pos == '\r' || *pos == '\n') {
+      ++pos;
+    }
+    return !*pos;
+  }
+}
+
+EventRecord
+add_event(OrderId order_id,
+          bool is_buy,
+          Price price,
+          Quantity qty,
+          OrderConditions conditions)
+{
+  EventRecord record;
+  memset(&record, 0, sizeof(record));
+  record.type = et_add;
+  record.order_id = order_id;
+  record.is_buy = is_buy ? 1 : 0;
+  record.price = price;
+  record.qty = qty;
+  record.conditions = conditions;
+  return record;
+}
+
+EventRecord
+cancel_event(OrderId order_id)
+{
+  EventRecord record;
+  memset(&record, 0, sizeof(record));
+  record.type = et_cancel;
+  record.order_id = order_id;
+  return record;
+}
+
+EventRecord
+replace_event(OrderId order_id, int32_t size_delta, Price new_price)
+{
+  EventRecord record;
+  memset(&record, 0, sizeof(record));
+  record.type = et_replace;
+  record.order_id = order_id;
+  record.size_delta = size_delta;
+  record.price = new_price;
+  return record;
+}
+
+bool
+parse_csv_event(const char* line, EventRecord& record)
+{
+  const char type = line[0];
+  if (!type || line[1] != ',') {
+    return false;
+  }
+  const char* pos = line + 2;
+  uint64_t order_id;
+  if (!parse_number(pos, order_id)) {
+    return false;
+  }
+  if (type == 'A') {
+    const char side = *pos;
+    if ((side != 'B' && side != 'S') || pos[1] != ',') {
+      return false;
+    }
+    pos += 2;
+    uint64_t price, qty;
+    uint64_t conditions = 0;
+    if (!parse_number(pos, price) || !parse_number(pos, qty)) {
+      return false;
+    }
+    if (!at_line_end(pos) && !parse_number(pos, conditions)) {
+      return false;
+    }
+    record = add_event(order_id, side == 'B', Price(price), Quantity(qty),
+                       OrderConditions(conditions));
+  } else if (type == 'C') {
+    record = cancel_event(order_id);
+  } else if (type == 'R') {
+    bool negative = (*pos == '-');
+    if (negative) {
+      ++pos;
+    }
+    uint64_t size_change, new_price;
+    if (!parse_number(pos, size_change) || !parse_number(pos, new_price)) {
+      return false;
+    }
+    int32_t size_delta = int32_t(size_change);
+    record = replace_event(order_id, negative ? -size_delta : size_delta,
+                           Price(new_price));
+  } else {
+    return false;
+  }
+  return at_line_end(pos);
+}
+
+EventFileWriter::EventFileWriter()
+: file_(NULL)
+{
+  memset(&header_, 0, sizeof(header_));
+}
+
+EventFileWriter::~EventFileWriter()
+{
+  close();
+}
+
+bool
+EventFileWriter::open(const char* path)
+{
+  close();
+  file_ = fopen(path, "wb");
+  if (!file_) {
+    return false;
+  }
+  memset(&header_, 0, sizeof(header_));
+  memcpy(header_.magic, EVENT_FILE_MAGIC, sizeof(header_.magic));
+  header_.version = EVENT_FILE_VERSION;
+  header_.record_size = sizeof(EventRecord);
+  // The counts are written again on close
+  return fwrite(&header_, sizeof(header_), 1, file_) == 1;
+}
+
+bool
+EventFileWriter::write(const EventRecord& record)
+{
+  if (!file_ || fwrite(&record, sizeof(record), 1, file_) != 1) {
+    return false;
+  }
+  ++header_.record_count;
+  if (record.type == et_add) {
+    ++header_.add_count;
+  }
+  return true;
+}
+
+bool
+EventFileWriter::close()
+{
+  if (!file_) {
+    return true;
+  }
+  bool written = (fseek(file_, 0, SEEK_SET) == 0) &&
+                 (fwrite(&header_, sizeof(header_), 1, file_) == 1);
+  if (fclose(file_) != 0) {
+    written = false;
+  }
+  file_ = NULL;
+  return written;
+}
+
+uint32_t
+EventFileWriter::record_count() const
+{
+  return header_.record_count;
+}
+
+EventFileReader::EventFileReader()
+: header_(NULL)
+{
+}
+
+EventFileReader::~EventFileReader()
+{
+  close();
+}
+
+bool
+EventFileReader::open(const char* path)
+{
+  close();
+  if (!region_.open(path, true) || 
+      region_.size() < sizeof(EventFileHeader)) {
+    close();
+    return false;
+  }
+  region_.advise_sequential();
+  header_ = static_cast<const EventFileHeader*>(region_.address());
+  if (memcmp(header_->magic, EVENT_FILE_MAGIC, sizeof(header_->magic)) ||
+      header_->version != EVENT_FILE_VERSION ||
+      header_->record_size != sizeof(EventRecord) ||
+      (region_.size() - sizeof(EventFileHeader)) / sizeof(EventRecord) <
+          header_->record_count) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void
+EventFileReader::close()
+{
+  region_.close();
+  header_ = NULL;
+}
+
+const EventRecord*
+EventFileReader::begin() const
+{
+  if (!header_) {
+    return NULL;
+  }
+  return reinterpret_cast<const EventRecord*>(header_ + 1);
+}
+
+const EventRecord*
+EventFileReader::end() const
+{
+  if (!header_) {
+    return NULL;
+  }
+  return begin() + header_->record_count;
+}
+
+uint32_t
+EventFileReader::record_count() const
+{
+  return header_ ? header_->record_count : 0;
+}
+
+uint32_t
+EventFileReader::add_count() const
+{
+  return header_ ? header_->add_count : 0;
+}
+
+bool
+convert_csv_events(const char* csv_path,
+                   const char* event_path,
+                   uint32_t& bad_line)
+{
+  bad_line = 0;
+  FILE* csv = fopen(csv_path, "r");
+  if (!csv) {
+    return false;
+  }
+  EventFileWriter writer;
+  bool converted = writer.open(event_path);
+  char line[256];
+  uint32_t line_number = 0;
+  while (converted && fgets(line, sizeof(line), csv)) {
+    ++line_number;
+    if (line[0] == '#' || at_line_end(line)) {
+      continue;
+    }
+    EventRecord record;
+    if (!parse_csv_event(line, record)) {
+      bad_line = line_number;
+      converted = false;
+    } else {
+      converted = writer.write(record);
+    }
+  }
+  fclose(csv);
+  if (!writer.close()) {
+    converted = false;
+  }
+  return converted;
+}
+
+} }
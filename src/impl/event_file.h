@@ -0,0 +1,143 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef event_file_h
+#define event_file_h
+
+#include "book/types.h"
+#include "shared_region.h"
+#include <stdio.h>
+#include <stddef.h>
+
+namespace liquibook { namespace impl {
+
+using book::OrderConditions;
+using book::OrderId;
+using book::Price;
+using book::Quantity;
+
+enum EventType {
+  et_add = 1,
+  et_cancel,
+  et_replace
+};
+
+/// @brief a market event as stored in an event file.  Records are fixed
+///        size, in host byte order, so a mapped file is read in place.
+struct EventRecord {
+  OrderId order_id;
+  Price price;                // add: limit price, replace: new price
+  Quantity qty;               // add: order quantity
+  int32_t size_delta;         // replace: change in order quantity
+  OrderConditions conditions; // add: order conditions
+  uint8_t type;               // an EventType
+  uint8_t is_buy;             // add: 1 for a buy
+  uint8_t reserved[6];
+};
+
+/// @brief the header at the start of an event file
+struct EventFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t record_count;
+  uint32_t add_count;
+  uint32_t reserved[3];
+};
+
+/// @brief create an add event
+EventRecord add_event(OrderId order_id,
+                      bool is_buy,
+                      Price price,
+                      Quantity qty,
+                      OrderConditions conditions = 0);
+/// @brief create a cancel event
+EventRecord cancel_event(OrderId order_id);
+/// @brief create a replace event
+EventRecord replace_event(OrderId order_id,
+                          int32_t size_delta,
+                          Price new_price);
+
+/// @brief parse an event from a line of text, one of
+///          A,<order id>,<B|S>,<price>,<qty>[,<conditions>]
+///          C,<order id>
+///          R,<order id>,<size delta>,<new price>
+/// @param line the line
+/// @param record the event (out)
+/// @return true if the line holds an event
+bool parse_csv_event(const char* line, EventRecord& record);
+
+/// @brief writer of an event file
+class EventFileWriter {
+public:
+  EventFileWriter();
+  ~EventFileWriter();
+
+  /// @brief create the file, replacing any file at the path
+  bool open(const char* path);
+
+  /// @brief add an event to the file
+  bool write(const EventRecord& record);
+
+  /// @brief complete the header and close the file
+  bool close();
+
+  /// @brief get the number of events written
+  uint32_t record_count() const;
+
+private:
+  FILE* file_;
+  EventFileHeader header_;
+
+  EventFileWriter(const EventFileWriter&);
+  EventFileWriter& operator=(const EventFileWriter&);
+};
+
+/// @brief reader of an event file, mapped into memory.  The records are
+///        read where they lie in the mapping, with nothing copied or
+///        parsed.
+class EventFileReader {
+public:
+  EventFileReader();
+  ~EventFileReader();
+
+  /// @brief map a file, checking its header
+  /// @return false if the file can not be mapped or is not an event file
+  bool open(const char* path);
+
+  /// @brief unmap the file
+  void close();
+
+  /// @brief get the first event
+  const EventRecord* begin() const;
+
+  /// @brief get one past the last event
+  const EventRecord* end() const;
+
+  /// @brief get the number of events
+  uint32_t record_count() const;
+
+  /// @brief get the number of add events
+  uint32_t add_count() const;
+
+private:
+  SharedRegion region_;
+  const EventFileHeader* header_;
+
+  EventFileReader(const EventFileReader&);
+  EventFileReader& operator=(const EventFileReader&);
+};
+
+/// @brief convert a text file of events, one per line, to an event file.
+///        Blank lines and lines starting with # are skipped.
+/// @param csv_path the path of the text file
+/// @param event_path the path of the event file to create
+/// @param bad_line the number of the first line not understood (out), or 0
+/// @return true if every line was converted
+bool convert_csv_events(const char* csv_path,
+                        const char* event_path,
+                        uint32_t& bad_line);
+
+} }
+
+#endif
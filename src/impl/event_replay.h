@@ -0,0 +1,244 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef event_replay_h
+#define event_replay_h
+
+#include "event_file.h"
+#include "simple_order.h"
+#include "book/order_id_index.h"
+#include <deque>
+#include <new>
+#include <vector>
+
+namespace liquibook { namespace impl {
+
+/// @brief replay of market events into an order book of SimpleOrders.  The
+///        replay creates an order for each add event, and finds the order
+///        of a cancel or replace event by its order ID.  An order lives
+///        until it is done (filled, cancelled or rejected), then its slot
+///        and ID are freed, so the replay holds about as many orders as
+///        rest in the book however long it runs.  The orders are swept for
+///        those done when the orders held have doubled since the last
+///        sweep, which costs O(1) per order added.
+template <class OrderBook>
+class EventReplay {
+public:
+  /// @brief construct a replay into a book
+  explicit EventReplay(OrderBook& order_book);
+
+  /// @brief apply events to the book, performing callbacks after each
+  /// @param begin the first event
+  /// @param end one past the last event
+  /// @return the number of events applied.  Adds of an order ID whose
+  ///         order is not done, and cancels or replaces of an unknown ID
+  ///         or of an order which is done, are skipped, so a replay does
+  ///         the same whenever its orders are freed.
+  uint32_t replay(const EventRecord* begin, const EventRecord* end);
+
+  /// @brief find the order created for an order ID
+  /// @return the order, or NULL if the ID was never added, or its order is
+  ///         done and has been freed.  Valid until the order is freed.
+  SimpleOrder* find(OrderId order_id);
+
+  /// @brief get the number of orders added
+  uint32_t order_count() const;
+
+  /// @brief get the number of orders held - those live, and those done but
+  ///        not yet freed
+  uint32_t held_count() const;
+
+  /// @brief get the quantity traded between the orders added
+  uint64_t traded_qty() const;
+
+private:
+  typedef std::deque<SimpleOrder> Orders;
+  typedef std::vector<OrderId> OrderIds;
+  typedef std::vector<uint32_t> Slots;
+
+  // The fewest orders held before a sweep
+  static const uint32_t MIN_SWEEP = 1024;
+
+  /// @brief is an order done, so that the book no longer holds it?
+  static bool done(const SimpleOrder& order);
+
+  /// @brief take a free slot, or a new one, for an order ID
+  uint32_t take_slot(OrderId order_id);
+
+  /// @brief create the order of an add event in a slot
+  void make_order(uint32_t slot, const EventRecord& event);
+
+  /// @brief free the slots of the orders which are done
+  void sweep();
+
+  OrderBook& order_book_;
+  // A deque never moves its orders as it grows.  A freed slot is reused
+  // for a later order.
+  Orders orders_;
+  // The order ID of each slot
+  OrderIds order_ids_;
+  Slots held_slots_;
+  Slots free_slots_;
+  book::OrderIdIndex index_;
+  uint32_t added_count_;
+  uint32_t sweep_count_;
+  // The quantity filled by the orders freed
+  uint64_t freed_filled_qty_;
+};
+
+template <class OrderBook>
+EventReplay<OrderBook>::EventReplay(OrderBook& order_book)
+: order_book_(order_book),
+  added_count_(0),
+  sweep_count_(MIN_SWEEP),
+  freed_filled_qty_(0)
+{
+}
+
+template <class OrderBook>
+inline uint32_t
+EventReplay<OrderBook>::replay(const EventRecord* begin,
+                               const EventRecord* end)
+{
+  uint32_t applied = 0;
+  for (const EventRecord* event = begin; event != end; ++event) {
+    uint32_t slot;
+    const bool found = index_.find(event->order_id, slot);
+    if (event->type == et_add) {
+      // An order ID may be added again once its order is done
+      if (!found) {
+        slot = take_slot(event->order_id);
+      } else if (done(orders_[slot])) {
+        freed_filled_qty_ += orders_[slot].filled_qty();
+      } else {
+        continue;
+      }
+      make_order(slot, *event);
+      order_book_.add(&orders_[slot], event->conditions);
+    } else {
+      if (!found || done(orders_[slot])) {
+        continue;
+      }
+      if (event->type == et_cancel) {
+        order_book_.cancel(&orders_[slot]);
+      } else if (event->type == et_replace) {
+        order_book_.replace(&orders_[slot], event->size_delta, event->price);
+      } else {
+        continue;
+      }
+    }
+    order_book_.perform_callbacks();
+    ++applied;
+    if (held_slots_.size() >= sweep_count_) {
+      sweep();
+    }
+  }
+  return applied;
+}
+
+template <class OrderBook>
+inline SimpleOrder*
+EventReplay<OrderBook>::find(OrderId order_id)
+{
+  uint32_t index;
+  if (index_.find(order_id, index)) {
+    return &orders_[index];
+  }
+  return NULL;
+}
+
+template <class OrderBook>
+inline uint32_t
+EventReplay<OrderBook>::order_count() const
+{
+  return added_count_;
+}
+
+template <class OrderBook>
+inline uint32_t
+EventReplay<OrderBook>::held_count() const
+{
+  return held_slots_.size();
+}
+
+template <class OrderBook>
+inline uint64_t
+EventReplay<OrderBook>::traded_qty() const
+{
+  // Each trade fills two of the orders
+  uint64_t filled_qty = freed_filled_qty_;
+  for (Slots::const_iterator slot = held_slots_.begin();
+       slot != held_slots_.end(); ++slot) {
+    filled_qty += orders_[*slot].filled_qty();
+  }
+  return filled_qty / 2;
+}
+
+template <class OrderBook>
+inline bool
+EventReplay<OrderBook>::done(const SimpleOrder& order)
+{
+  const OrderState state = order.state();
+  return state == os_complete || state == os_cancelled ||
+         state == os_rejected;
+}
+
+template <class OrderBook>
+inline uint32_t
+EventReplay<OrderBook>::take_slot(OrderId order_id)
+{
+  uint32_t slot;
+  if (free_slots_.empty()) {
+    slot = order_ids_.size();
+    order_ids_.push_back(order_id);
+  } else {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+    order_ids_[slot] = order_id;
+  }
+  index_.insert(order_id, slot);
+  held_slots_.push_back(slot);
+  return slot;
+}
+
+template <class OrderBook>
+inline void
+EventReplay<OrderBook>::make_order(uint32_t slot, const EventRecord& event)
+{
+  if (slot == orders_.size()) {
+    orders_.push_back(SimpleOrder(event.is_buy != 0, event.price, event.qty));
+  } else {
+    // An order can not be assigned, so is made again in place
+    orders_[slot].~SimpleOrder();
+    new (&orders_[slot]) SimpleOrder(event.is_buy != 0, event.price,
+                                     event.qty);
+  }
+  ++added_count_;
+}
+
+template <class OrderBook>
+inline void
+EventReplay<OrderBook>::sweep()
+{
+  Slots::iterator kept = held_slots_.begin();
+  for (Slots::iterator slot = held_slots_.begin();
+       slot != held_slots_.end(); ++slot) {
+    const SimpleOrder& order = orders_[*slot];
+    if (done(order)) {
+      freed_filled_qty_ += order.filled_qty();
+      index_.erase(order_ids_[*slot]);
+      free_slots_.push_back(*slot);
+    } else {
+      *kept++ = *slot;
+    }
+  }
+  held_slots_.erase(kept, held_slots_.end());
+  sweep_count_ = 2 * held_slots_.size();
+  if (sweep_count_ < MIN_SWEEP) {
+    sweep_count_ = MIN_SWEEP;
+  }
+}
+
+} }
+
+#endif
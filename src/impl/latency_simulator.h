@@ -0,0 +1,351 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef latency_simulator_h
+#define latency_simulator_h
+
+#include "event_file.h"
+#include "event_replay.h"
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace liquibook { namespace impl {
+
+using book::Timestamp;
+
+/// @brief a historical event and the time it reached the exchange
+struct TimedEvent {
+  Timestamp time;
+  EventRecord event;
+};
+
+/// @brief listener of the events a simulator has applied to its books, as
+///        seen by a strategy after the market data latency
+class MarketDataListener {
+public:
+  virtual ~MarketDataListener() {}
+
+  /// @brief callback for an event applied to a book
+  /// @param book the index of the book
+  /// @param event the event
+  virtual void on_market_data(uint32_t book, const EventRecord& event) = 0;
+};
+
+/// @brief discrete event simulator of order entry and market data latency
+///        around one or more order books.  A virtual clock jumps from one
+///        command to the next, so the simulation runs as fast as the books
+///        apply events.  Commands run in time order, and commands for the
+///        same time in the order they were scheduled, so a run is the same
+///        every time.
+///
+///        Historical feeds are merged lazily: only the next event of each
+///        feed is queued, so the queue holds one command per feed, plus the
+///        strategy orders and market data still in flight.
+template <class OrderBook>
+class LatencySimulator {
+public:
+  /// @brief construct a simulator
+  /// @param order_latency time from a strategy's decision to its order
+  ///        reaching the book
+  /// @param market_data_latency time from an event reaching a book to the
+  ///        strategy hearing of it
+  LatencySimulator(Timestamp order_latency, Timestamp market_data_latency);
+
+  /// @brief add a book to simulate
+  /// @return the index of the book
+  uint32_t add_book(OrderBook& order_book);
+
+  /// @brief add a feed of historical events for a book.  The events must
+  ///        be in time order, and outlive the run.
+  /// @param book the index of the book
+  /// @param begin the first event
+  /// @param end one past the last event
+  void add_feed(uint32_t book, const TimedEvent* begin, const TimedEvent* end);
+
+  /// @brief set the listener of market data, such as a strategy
+  void set_market_data_listener(MarketDataListener* listener);
+
+  /// @brief submit a strategy's order event, decided now.  It reaches the
+  ///        book after the order latency.
+  void submit(uint32_t book, const EventRecord& event);
+
+  /// @brief schedule an event to reach a book at a time.  Times already
+  ///        past are taken as now.
+  void schedule(Timestamp time, uint32_t book, const EventRecord& event);
+
+  /// @brief run the next command
+  /// @return false if there was no command to run
+  bool step();
+
+  /// @brief run every command due by a time, then move the clock to it
+  /// @return the number of commands run
+  uint64_t run_until(Timestamp end_time);
+
+  /// @brief run until no command is left
+  /// @return the number of commands run
+  uint64_t run();
+
+  /// @brief get the time on the virtual clock
+  Timestamp now() const;
+
+  /// @brief get the number of commands queued
+  uint32_t pending() const;
+
+  /// @brief get the number of events applied to the books
+  uint64_t events_applied() const;
+
+  /// @brief find the order created for an order ID in a book.  Unlike market
+  ///        data, the order is as it is now, without latency.
+  /// @return the order, or NULL if the ID was never added, or the order is
+  ///         done and has been freed
+  SimpleOrder* find_order(uint32_t book, OrderId order_id);
+
+  /// @brief get the number of orders held for a book.  Orders are freed 
+  ///        once done, so this follows the orders resting in the book, not
+  ///        the length of the run.
+  uint32_t orders_held(uint32_t book) const;
+
+private:
+  enum CommandType {
+    ct_apply,    // apply the event to the book
+    ct_notify    // tell the listener of the event
+  };
+
+  // Feeds are numbered from 1, so 0 means a command of no feed
+  static const uint32_t NO_FEED = 0;
+
+  struct Command {
+    Timestamp time;
+    uint64_t sequence;
+    uint32_t book;
+    uint32_t feed;
+    uint32_t type;
+    EventRecord event;
+  };
+
+  // Orders commands latest first, for a heap with the earliest at the top
+  struct Later {
+    bool operator()(const Command& lhs, const Command& rhs) const
+    {
+      if (lhs.time != rhs.time) {
+        return lhs.time > rhs.time;
+      }
+      return lhs.sequence > rhs.sequence;
+    }
+  };
+
+  struct Feed {
+    uint32_t book;
+    const TimedEvent* next;
+    const TimedEvent* end;
+  };
+
+  typedef std::vector<Command> Commands;
+  typedef std::vector<Feed> Feeds;
+  typedef std::deque<EventReplay<OrderBook> > Replays;
+
+  void push(Timestamp time,
+            uint32_t book,
+            uint32_t feed,
+            uint32_t type,
+            const EventRecord& event);
+  void push_next(uint32_t feed);
+
+  Timestamp order_latency_;
+  Timestamp market_data_latency_;
+  Timestamp now_;
+  uint64_t sequence_;
+  uint64_t events_applied_;
+  MarketDataListener* listener_;
+  // A heap, which keeps its capacity as commands come and go
+  Commands commands_;
+  Feeds feeds_;
+  Replays replays_;
+};
+
+template <class OrderBook>
+LatencySimulator<OrderBook>::LatencySimulator(Timestamp order_latency,
+                                              Timestamp market_data_latency)
+: order_latency_(order_latency),
+  market_data_latency_(market_data_latency),
+  now_(0),
+  sequence_(0),
+  events_applied_(0),
+  listener_(NULL)
+{
+}
+
+template <class OrderBook>
+inline uint32_t
+LatencySimulator<OrderBook>::add_book(OrderBook& order_book)
+{
+  replays_.push_back(EventReplay<OrderBook>(order_book));
+  return replays_.size() - 1;
+}
+
+template <class OrderBook>
+inline void
+LatencySimulator<OrderBook>::add_feed(uint32_t book,
+                                      const TimedEvent* begin,
+                                      const TimedEvent* end)
+{
+  Feed feed;
+  feed.book = book;
+  feed.next = begin;
+  feed.end = end;
+  feeds_.push_back(feed);
+  push_next(feeds_.size());
+}
+
+template <class OrderBook>
+inline void
+LatencySimulator<OrderBook>::set_market_data_listener(
+  MarketDataListener* listener)
+{
+  listener_ = listener;
+}
+
+template <class OrderBook>
+inline void
+LatencySimulator<OrderBook>::submit(uint32_t book, const EventRecord& event)
+{
+  push(now_ + order_latency_, book, NO_FEED, ct_apply, event);
+}
+
+template <class OrderBook>
+inline void
+LatencySimulator<OrderBook>::schedule(Timestamp time,
+                                      uint32_t book,
+                                      const EventRecord& event)
+{
+  push(time, book, NO_FEED, ct_apply, event);
+}
+
+template <class OrderBook>
+inline bool
+LatencySimulator<OrderBook>::step()
+{
+  if (commands_.empty()) {
+    return false;
+  }
+  std::pop_heap(commands_.begin(), commands_.end(), Later());
+  // Copy out, as pushes below may reuse the slot
+  Command command = commands_.back();
+  commands_.pop_back();
+  now_ = command.time;
+
+  if (command.type == ct_notify) {
+    if (listener_) {
+      listener_->on_market_data(command.book, command.event);
+    }
+    return true;
+  }
+  if (command.feed != NO_FEED) {
+    push_next(command.feed);
+  }
+  const EventRecord* event = &command.event;
+  if (replays_[command.book].replay(event, event + 1)) {
+    ++events_applied_;
+    if (listener_) {
+      push(now_ + market_data_latency_, command.book, NO_FEED, ct_notify,
+           command.event);
+    }
+  }
+  return true;
+}
+
+template <class OrderBook>
+inline uint64_t
+LatencySimulator<OrderBook>::run_until(Timestamp end_time)
+{
+  uint64_t run_count = 0;
+  while (!commands_.empty() && commands_.front().time <= end_time) {
+    step();
+    ++run_count;
+  }
+  if (end_time > now_) {
+    now_ = end_time;
+  }
+  return run_count;
+}
+
+template <class OrderBook>
+inline uint64_t
+LatencySimulator<OrderBook>::run()
+{
+  uint64_t run_count = 0;
+  while (step()) {
+    ++run_count;
+  }
+  return run_count;
+}
+
+template <class OrderBook>
+inline Timestamp
+LatencySimulator<OrderBook>::now() const
+{
+  return now_;
+}
+
+template <class OrderBook>
+inline uint32_t
+LatencySimulator<OrderBook>::pending() const
+{
+  return commands_.size();
+}
+
+template <class OrderBook>
+inline uint64_t
+LatencySimulator<OrderBook>::events_applied() const
+{
+  return events_applied_;
+}
+
+template <class OrderBook>
+inline SimpleOrder*
+LatencySimulator<OrderBook>::find_order(uint32_t book, OrderId order_id)
+{
+  return replays_[book].find(order_id);
+}
+
+template <class OrderBook>
+inline uint32_t
+LatencySimulator<OrderBook>::orders_held(uint32_t book) const
+{
+  return replays_[book].held_count();
+}
+
+template <class OrderBook>
+inline void
+LatencySimulator<OrderBook>::push(Timestamp time,
+                                  uint32_t book,
+                                  uint32_t feed,
+                                  uint32_t type,
+                                  const EventRecord& event)
+{
+  Command command;
+  command.time = time < now_ ? now_ : time;
+  command.sequence = sequence_++;
+  command.book = book;
+  command.feed = feed;
+  command.type = type;
+  command.event = event;
+  commands_.push_back(command);
+  std::push_heap(commands_.begin(), commands_.end(), Later());
+}
+
+template <class OrderBook>
+inline void
+LatencySimulator<OrderBook>::push_next(uint32_t feed)
+{
+  Feed& next_feed = feeds_[feed - 1];
+  if (next_feed.next != next_feed.end) {
+    const TimedEvent& next = *next_feed.next++;
+    push(next.time, next_feed.book, feed, ct_apply, next.event);
+  }
+}
+
+} }
+
+#endif
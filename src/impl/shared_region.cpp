@@ -0,0 +1,199 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "shared_region.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace liquibook { namespace impl {
+
+SharedRegion::SharedRegion()
+: mapping_(NULL),
+  mapped_size_(0),
+  read_only_(false)
+#ifdef _WIN32
+  ,
+  file_handle_(INVALID_HANDLE_VALUE),
+  mapping_handle_(NULL)
+#endif
+{
+}
+
+SharedRegion::~SharedRegion()
+{
+  close();
+}
+
+bool
+SharedRegion::create(const char* path, size_t size)
+{
+  close();
+  if (!size) {
+    return false;
+  }
+  mapped_size_ = size;
+#ifdef _WIN32
+  file_handle_ = CreateFileA(path, GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    mapped_size_ = 0;
+    return false;
+  }
+  return map(0);
+#else
+  // Truncating to 0 first zero fills the whole region
+  int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    mapped_size_ = 0;
+    return false;
+  }
+  if (ftruncate(fd, off_t(size)) != 0) {
+    ::close(fd);
+    mapped_size_ = 0;
+    return false;
+  }
+  return map(fd);
+#endif
+}
+
+bool
+SharedRegion::open(const char* path, bool read_only)
+{
+  close();
+  read_only_ = read_only;
+#ifdef _WIN32
+  const DWORD access = read_only ? GENERIC_READ 
+                                 : GENERIC_READ | GENERIC_WRITE;
+  file_handle_ = CreateFileA(path, access,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_TEMPORARY, NULL);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_handle_, &file_size) || !file_size.QuadPart) {
+    close();
+    return false;
+  }
+  mapped_size_ = size_t(file_size.QuadPart);
+  return map(0);
+#else
+  int fd = ::open(path, read_only ? O_RDONLY : O_RDWR);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || !file_stat.st_size) {
+    ::close(fd);
+    return false;
+  }
+  mapped_size_ = size_t(file_stat.st_size);
+  return map(fd);
+#endif
+}
+
+void
+SharedRegion::close()
+{
+#ifdef _WIN32
+  if (mapping_) {
+    UnmapViewOfFile(mapping_);
+  }
+  if (mapping_handle_) {
+    CloseHandle(mapping_handle_);
+    mapping_handle_ = NULL;
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+    file_handle_ = INVALID_HANDLE_VALUE;
+  }
+#else
+  if (mapping_) {
+    munmap(mapping_, mapped_size_);
+  }
+#endif
+  mapping_ = NULL;
+  mapped_size_ = 0;
+  read_only_ = false;
+}
+
+void
+SharedRegion::advise_sequential()
+{
+#ifndef _WIN32
+  if (mapping_) {
+    madvise(mapping_, mapped_size_, MADV_SEQUENTIAL);
+  }
+#endif
+}
+
+void*
+SharedRegion::address() const
+{
+  return mapping_;
+}
+
+size_t
+SharedRegion::size() const
+{
+  return mapped_size_;
+}
+
+#ifdef _WIN32
+bool
+SharedRegion::map(int)
+{
+  const ULONGLONG size = mapped_size_;
+  mapping_handle_ = CreateFileMappingA(file_handle_, NULL, 
+                                       read_only_ ? PAGE_READONLY 
+                                                  : PAGE_READWRITE,
+                                       DWORD(size >> 32), DWORD(size),
+                                       NULL);
+  if (mapping_handle_) {
+    mapping_ = MapViewOfFile(mapping_handle_, 
+                             read_only_ ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS,
+                             0, 0, 0);
+  }
+  if (!mapping_) {
+    close();
+    return false;
+  }
+  return true;
+}
+#else
+bool
+SharedRegion::map(int fd)
+{
+  void* mapping = mmap(NULL, mapped_size_, 
+                       read_only_ ? PROT_READ : PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+  // The mapping holds its own reference to the file
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    mapped_size_ = 0;
+    return false;
+  }
+  mapping_ = mapping;
+  return true;
+}
+#endif
+
+void
+memory_barrier()
+{
+#ifdef _WIN32
+  MemoryBarrier();
+#else
+  __sync_synchronize();
+#endif
+}
+
+} }
@@ -0,0 +1,67 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#ifndef shared_region_h
+#define shared_region_h
+
+#include <stddef.h>
+
+namespace liquibook { namespace impl {
+
+/// @brief memory shared between processes, mapped from a file.  Every
+///        process mapping the file sees the others' writes.  A file on a
+///        memory file system, such as /dev/shm, is never written to disk.
+///        A file may also be mapped read only, to be read in place.
+class SharedRegion {
+public:
+  SharedRegion();
+  ~SharedRegion();
+
+  /// @brief create the file, zero filled, and map it.  Replaces any file at
+  ///        the path.
+  /// @param path the path of the file
+  /// @param size the size of the region
+  /// @return false if the file can not be created or mapped
+  bool create(const char* path, size_t size);
+
+  /// @brief map an existing file, at its size
+  /// @param path the path of the file
+  /// @param read_only map the file for reading only
+  /// @return false if the file can not be mapped
+  bool open(const char* path, bool read_only = false);
+
+  /// @brief hint that the region will be read once, from start to end
+  void advise_sequential();
+
+  /// @brief unmap the file, which is left in place
+  void close();
+
+  /// @brief get the start of the region, or NULL if not mapped
+  void* address() const;
+
+  /// @brief get the size of the region
+  size_t size() const;
+
+private:
+  void* mapping_;
+  size_t mapped_size_;
+  bool read_only_;
+#ifdef _WIN32
+  void* file_handle_;
+  void* mapping_handle_;
+#endif
+
+  /// @brief map the file open in file_handle_ or fd, at mapped_size_
+  bool map(int fd);
+
+  SharedRegion(const SharedRegion&);
+  SharedRegion& operator=(const SharedRegion&);
+};
+
+/// @brief order the loads and stores before the barrier ahead of those
+///        after it, as seen by other processors
+void memory_barrier();
+
+} }
+
+#endif
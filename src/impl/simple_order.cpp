@@ -4,21 +4,51 @@
 #include "simple_order.h"
 
 #include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 namespace liquibook { namespace impl {
 
 uint32_t SimpleOrder::last_order_id_(0);
 
+namespace {
+  // Orders may be created on several threads, each with its own books
+  uint32_t next_order_id(uint32_t& last_order_id)
+  {
+#ifdef _WIN32
+    return InterlockedIncrement(
+        reinterpret_cast<volatile LONG*>(&last_order_id));
+#else
+    return __sync_add_and_fetch(&last_order_id, 1);
+#endif
+  }
+}
+
 SimpleOrder::SimpleOrder(bool is_buy,
                          Price price,
-                         Quantity qty)
+                         Quantity qty,
+                         Price stop_price,
+                         Quantity display_qty,
+                         OwnerId owner,
+                         Timestamp expire_time,
+                         PegType peg_type,
+                         Quantity min_qty)
 : state_(os_new),
   is_buy_(is_buy),
   price_(price),
   order_qty_(qty),
+  stop_price_(stop_price),
+  stop_triggered_(false),
+  display_qty_(display_qty),
+  visible_qty_(0),
+  owner_(owner),
+  expire_time_(expire_time),
+  peg_type_(peg_type),
+  min_qty_(min_qty),
   filled_qty_(0),
   filled_cost_(0),
-  order_id_(++last_order_id_)
+  order_id_(next_order_id(last_order_id_))
 {
 }
 
@@ -46,6 +76,54 @@ SimpleOrder::order_qty() const
   return order_qty_;
 }
 
+Price
+SimpleOrder::stop_price() const
+{
+  return stop_price_;
+}
+
+bool
+SimpleOrder::is_stop_pending() const
+{
+  return stop_price_ && !stop_triggered_;
+}
+
+Quantity
+SimpleOrder::display_qty() const
+{
+  return display_qty_;
+}
+
+Quantity
+SimpleOrder::visible_qty() const
+{
+  return visible_qty_;
+}
+
+OwnerId
+SimpleOrder::owner() const
+{
+  return owner_;
+}
+
+Timestamp
+SimpleOrder::expire_time() const
+{
+  return expire_time_;
+}
+
+PegType
+SimpleOrder::peg_type() const
+{
+  return peg_type_;
+}
+
+Quantity
+SimpleOrder::min_qty() const
+{
+  return min_qty_;
+}
+
 Quantity
 SimpleOrder::open_qty() const
 {
@@ -98,6 +176,18 @@ SimpleOrder::cancel()
   }
 }
 
+void
+SimpleOrder::trigger()
+{
+  stop_triggered_ = true;
+}
+
+void
+SimpleOrder::display(Quantity visible_qty)
+{
+  visible_qty_ = visible_qty;
+}
+
 void
 SimpleOrder::replace(Quantity new_order_qty, Price new_price)
 {
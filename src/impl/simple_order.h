@@ -24,7 +24,13 @@ class SimpleOrder : public Order {
 public:
   SimpleOrder(bool is_buy,
               Price price,
-              Quantity qty);
+              Quantity qty,
+              Price stop_price = 0,
+              Quantity display_qty = 0,
+              OwnerId owner = 0,
+              Timestamp expire_time = 0,
+              PegType peg_type = peg_none,
+              Quantity min_qty = 0);
 
   /// @brief get the order's state
   const OrderState& state() const;
@@ -38,6 +44,30 @@ public:
   /// @brief get the quantity of this order
   virtual Quantity order_qty() const;
 
+  /// @brief get the stop price of this order
+  virtual Price stop_price() const;
+
+  /// @brief is this a stop order which has not been triggered?
+  bool is_stop_pending() const;
+
+  /// @brief get the display quantity of this order
+  virtual Quantity display_qty() const;
+
+  /// @brief get the quantity of this order shown in depth
+  Quantity visible_qty() const;
+
+  /// @brief get the owner of this order
+  virtual OwnerId owner() const;
+
+  /// @brief get the expiry time of this order
+  virtual Timestamp expire_time() const;
+
+  /// @brief get the price this order is pegged to
+  virtual PegType peg_type() const;
+
+  /// @brief get the minimum quantity of this order
+  virtual Quantity min_qty() const;
+
   /// @brief get the open quantity of this order
   virtual Quantity open_qty() const;
 
@@ -59,6 +89,10 @@ public:
   void accept();
   /// @brief exchange cancelled this order
   void cancel();
+  /// @brief exchange triggered this stop order
+  void trigger();
+  /// @brief exchange changed the displayed quantity of this iceberg order
+  void display(Quantity visible_qty);
 
   /// @brief exchange replaced this order
   /// @param new_order_qty the new order quantity
@@ -70,6 +104,14 @@ private:
   bool is_buy_;
   Price    price_;
   Quantity order_qty_;
+  Price    stop_price_;
+  bool stop_triggered_;
+  Quantity display_qty_;
+  Quantity visible_qty_;
+  OwnerId owner_;
+  Timestamp expire_time_;
+  PegType peg_type_;
+  Quantity min_qty_;
   Quantity filled_qty_;
   Cost filled_cost_;
   static uint32_t last_order_id_;
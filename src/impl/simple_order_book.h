@@ -8,15 +8,16 @@
 #include "book/order_book.h"
 #include "book/depth.h"
 #include <iostream>
+#include <map>
 
 namespace liquibook { namespace impl {
 
 /// @brief Implementation of order book child class, for unit and performance 
 ///        testing purposes.  Overrides perform_callback() method to track
 ///        depth aggregated by price.
-template <int SIZE = 5>
+template <int SIZE = 5, class MatchPolicy = book::FifoMatch>
 class SimpleOrderBook : 
-      public book::OrderBook<SimpleOrder*> {
+      public book::OrderBook<SimpleOrder*, MatchPolicy> {
 public:
   typedef typename book::Depth<SIZE> SimpleDepth;
   typedef book::Callback<SimpleOrder*> SimpleCallback;
@@ -28,52 +29,93 @@ public:
   const SimpleDepth& depth() const;
 
 private:
+  // The net change to the orders at a depth level
+  struct LevelChange {
+    LevelChange() : count(0), qty(0) {}
+    int32_t count;
+    int32_t qty;
+  };
+  // Level changes by side and price
+  typedef std::map<std::pair<bool, Price>, LevelChange> LevelChanges;
+
   FillId fill_id_;
   SimpleDepth depth_;
+  LevelChanges level_changes_;
+
+  /// @brief add an order entering the book to the depth
+  void enter_depth(SimpleCallback& cb);
+
+  /// @brief apply a replace to an order and the depth
+  void replace_order(const SimpleCallback& cb);
+
+  /// @brief apply a replace of a mass quote to an order, and note its 
+  ///        change to the depth in level_changes_
+  void quote_order(const SimpleCallback& cb);
+
+  /// @brief note a change to the orders at a depth level
+  void change_level(bool is_buy, Price price, int32_t count, int32_t qty);
 };
 
 
-template <int SIZE>
-SimpleOrderBook<SIZE>::SimpleOrderBook()
+template <int SIZE, class MatchPolicy>
+SimpleOrderBook<SIZE, MatchPolicy>::SimpleOrderBook()
 : fill_id_(0)
 {
 }
 
-template <int SIZE>
+template <int SIZE, class MatchPolicy>
 inline void
-SimpleOrderBook<SIZE>::perform_callback(SimpleCallback& cb)
+SimpleOrderBook<SIZE, MatchPolicy>::perform_callback(SimpleCallback& cb)
 {
   switch(cb.type) {
     case SimpleCallback::cb_order_accept:
       cb.order->accept();
-      // If the order is a limit order
-      if (cb.order->is_limit()) {
-        // If the order is completely filled on acceptance, do not modify 
-        // depth unnecessarily
-        if (cb.match_qty == cb.order->order_qty()) {
-          // Don't tell depth about this order - it's going away immediately.
-          // Instead tell Depth about future fills to ignore
-          depth_.ignore_fill_qty(cb.match_qty, cb.order->is_buy());
-        } else {
-          // Add to bid or ask depth
-          depth_.add_order(cb.order->price(), 
-                           cb.order->order_qty(), 
+      // Stop orders enter the book when triggered, and iceberg orders
+      // enter depth when displayed
+      if (!cb.order->stop_price() && !cb.order->display_qty()) {
+        enter_depth(cb);
+      }
+      break;
+
+    case SimpleCallback::cb_order_trigger:
+      cb.order->trigger();
+      if (!cb.order->display_qty()) {
+        enter_depth(cb);
+      }
+      break;
+
+    case SimpleCallback::cb_order_display: {
+      // Iceberg depth follows the displayed quantity only
+      Quantity current_qty = cb.order->visible_qty();
+      if (!current_qty && cb.visible_qty) {
+        depth_.add_order(cb.order->price(), 
+                         cb.visible_qty, 
+                         cb.order->is_buy());
+      } else if (current_qty && !cb.visible_qty) {
+        depth_.close_order(cb.order->price(), 
+                           current_qty, 
                            cb.order->is_buy());
-        }
+      } else if (current_qty != cb.visible_qty) {
+        depth_.change_qty_order(cb.order->price(), 
+                                int32_t(cb.visible_qty - current_qty),
+                                cb.order->is_buy());
       }
+      cb.order->display(cb.visible_qty);
       break;
+    }
 
     case SimpleCallback::cb_order_fill: {
-      // If the matched order is a limit order
-      if (cb.matched_order->is_limit()) {
+      // If the matched order is a limit order (not an iceberg)
+      if (cb.matched_order->is_limit() && 
+          !cb.matched_order->display_qty()) {
         // Inform the depth
         depth_.fill_order(cb.matched_order->price(), 
                           cb.matched_order->open_qty(),
                           cb.fill_qty,
                           cb.matched_order->is_buy());
       }
-      // If the inbound order is a limit order
-      if (cb.order->is_limit()) {
+      // If the inbound order is a limit order (not an iceberg)
+      if (cb.order->is_limit() && !cb.order->display_qty()) {
         // Inform the depth
         depth_.fill_order(cb.order->price(), 
                           cb.order->open_qty(),
@@ -89,8 +131,16 @@ SimpleOrderBook<SIZE>::perform_callback(SimpleCallback& cb)
       break;
     }
     case SimpleCallback::cb_order_cancel:
-      // If the order is a limit order
-      if (cb.order->is_limit()) {
+      // If the order is an iceberg, remove what is displayed
+      if (cb.order->display_qty()) {
+        if (cb.order->visible_qty()) {
+          depth_.close_order(cb.order->price(), 
+                             cb.order->visible_qty(), 
+                             cb.order->is_buy());
+          cb.order->display(0);
+        }
+      // Else if the order is a limit order in the book
+      } else if (cb.order->is_limit() && !cb.order->is_stop_pending()) {
         // If the close erases a level
         depth_.close_order(cb.order->price(), 
                            cb.order->open_qty(), 
@@ -99,19 +149,75 @@ SimpleOrderBook<SIZE>::perform_callback(SimpleCallback& cb)
       cb.order->cancel();
       break;
 
-    case SimpleCallback::cb_order_replace:
+    case SimpleCallback::cb_mass_cancel:
     {
-      // Remember current values
-      Price current_price = cb.order->price();
-      Quantity current_qty = cb.order->open_qty();
+      SimpleOrder* const* orders = this->mass_cancelled(cb);
+      // Orders come a level at a time - close each level's orders at once
+      uint32_t level_count = 0;
+      Quantity level_qty = 0;
+      for (uint32_t index = 0; index < cb.cancel_count; ++index) {
+        SimpleOrder* order = orders[index];
+        // If the order is a limit order in the book, count it
+        if (order->display_qty()) {
+          if (order->visible_qty()) {
+            ++level_count;
+            level_qty += order->visible_qty();
+            order->display(0);
+          }
+        } else if (order->is_limit() && !order->is_stop_pending()) {
+          ++level_count;
+          level_qty += order->open_qty();
+        }
+        order->cancel();
+        // If this is the last order at this level, close the level's orders
+        const bool last = (index + 1 == cb.cancel_count) ||
+                          (orders[index + 1]->price() != order->price()) ||
+                          (orders[index + 1]->is_buy() != order->is_buy());
+        if (last && level_count) {
+          depth_.close_orders(order->price(), level_count, level_qty,
+                              order->is_buy());
+          level_count = 0;
+          level_qty = 0;
+        }
+      }
+      break;
+    }
 
-      // Modify the order itself
-      cb.order->replace(cb.new_order_qty, cb.new_price);
+    case SimpleCallback::cb_pegged_depth:
+      // Move the pegged orders of a side and type to their new price
+      if (cb.prior_pegged.order_count) {
+        depth_.close_orders(cb.prior_pegged.price, 
+                            cb.prior_pegged.order_count,
+                            cb.prior_pegged.qty, 
+                            cb.pegged_is_buy);
+      }
+      if (cb.pegged.order_count) {
+        depth_.add_orders(cb.pegged.price, 
+                          cb.pegged.order_count,
+                          cb.pegged.qty, 
+                          cb.pegged_is_buy);
+      }
+      break;
 
-      // Notify the depth
-      depth_.replace_order(current_price, cb.new_price, 
-                           current_qty, cb.order->open_qty(),
-                           cb.order->is_buy());
+    case SimpleCallback::cb_order_replace:
+      replace_order(cb);
+      break;
+
+    case SimpleCallback::cb_mass_quote:
+    {
+      // Replace every order, then change each level of the depth once, so 
+      // the quote is seen whole
+      const SimpleCallback* quoted = this->mass_quoted(cb);
+      level_changes_.clear();
+      for (uint32_t index = 0; index < cb.quote_count; ++index) {
+        quote_order(quoted[index]);
+      }
+      typename LevelChanges::const_iterator level;
+      for (level = level_changes_.begin(); level != level_changes_.end(); 
+           ++level) {
+        depth_.change_orders(level->first.second, level->second.count,
+                             level->second.qty, level->first.first);
+      }
       break;
     }
     default:
@@ -120,16 +226,116 @@ SimpleOrderBook<SIZE>::perform_callback(SimpleCallback& cb)
   }
 }
 
-template <int SIZE>
-inline typename SimpleOrderBook<SIZE>::SimpleDepth&
-SimpleOrderBook<SIZE>::depth()
+template <int SIZE, class MatchPolicy>
+inline void
+SimpleOrderBook<SIZE, MatchPolicy>::enter_depth(SimpleCallback& cb)
+{
+  // If the order is a limit order
+  if (cb.order->is_limit()) {
+    // If the order is completely filled on entry, do not modify 
+    // depth unnecessarily
+    if (cb.match_qty == cb.order->order_qty()) {
+      // Don't tell depth about this order - it's going away immediately.
+      // Instead tell Depth about future fills to ignore
+      depth_.ignore_fill_qty(cb.match_qty, cb.order->is_buy());
+    } else {
+      // Add to bid or ask depth
+      depth_.add_order(cb.order->price(), 
+                       cb.order->order_qty(), 
+                       cb.order->is_buy());
+    }
+  }
+}
+
+template <int SIZE, class MatchPolicy>
+inline void
+SimpleOrderBook<SIZE, MatchPolicy>::replace_order(const SimpleCallback& cb)
+{
+  // Remember current values
+  Price current_price = cb.order->price();
+  Quantity current_qty = cb.order->open_qty();
+
+  // An iceberg moving price leaves its displayed quantity behind.  The 
+  // book displays it again at the new price.
+  if (cb.order->display_qty()) {
+    if (cb.order->visible_qty() && (cb.new_price != current_price)) {
+      depth_.close_order(current_price, 
+                         cb.order->visible_qty(), 
+                         cb.order->is_buy());
+      cb.order->display(0);
+    }
+    cb.order->replace(cb.new_order_qty, cb.new_price);
+    return;
+  }
+
+  // Modify the order itself
+  cb.order->replace(cb.new_order_qty, cb.new_price);
+
+  // Notify the depth, if the order is in the book.  Pegged orders are
+  // shown by pegged depth callbacks.
+  if (!cb.order->is_stop_pending() && cb.order->peg_type() == peg_none) {
+    depth_.replace_order(current_price, cb.new_price, 
+                         current_qty, cb.order->open_qty(),
+                         cb.order->is_buy());
+  }
+}
+
+template <int SIZE, class MatchPolicy>
+inline void
+SimpleOrderBook<SIZE, MatchPolicy>::quote_order(const SimpleCallback& cb)
+{
+  SimpleOrder* order = cb.order;
+  const Price current_price = order->price();
+  const Quantity current_qty = order->open_qty();
+
+  // An iceberg moving price leaves its displayed quantity behind, as in
+  // replace_order()
+  if (order->display_qty()) {
+    if (order->visible_qty() && (cb.new_price != current_price)) {
+      change_level(order->is_buy(), current_price, -1, 
+                   -int32_t(order->visible_qty()));
+      order->display(0);
+    }
+    order->replace(cb.new_order_qty, cb.new_price);
+    return;
+  }
+
+  order->replace(cb.new_order_qty, cb.new_price);
+  if (!order->is_stop_pending() && order->peg_type() == peg_none) {
+    if (order->price() == current_price) {
+      change_level(order->is_buy(), current_price, 0, 
+                   int32_t(order->open_qty()) - int32_t(current_qty));
+    } else {
+      change_level(order->is_buy(), order->price(), 1, 
+                   int32_t(order->open_qty()));
+      change_level(order->is_buy(), current_price, -1, 
+                   -int32_t(current_qty));
+    }
+  }
+}
+
+template <int SIZE, class MatchPolicy>
+inline void
+SimpleOrderBook<SIZE, MatchPolicy>::change_level(bool is_buy, 
+                                                 Price price, 
+                                                 int32_t count, 
+                                                 int32_t qty)
+{
+  LevelChange& change = level_changes_[std::make_pair(is_buy, price)];
+  change.count += count;
+  change.qty += qty;
+}
+
+template <int SIZE, class MatchPolicy>
+inline typename SimpleOrderBook<SIZE, MatchPolicy>::SimpleDepth&
+SimpleOrderBook<SIZE, MatchPolicy>::depth()
 {
   return depth_;
 }
 
-template <int SIZE>
-inline const typename SimpleOrderBook<SIZE>::SimpleDepth&
-SimpleOrderBook<SIZE>::depth() const
+template <int SIZE, class MatchPolicy>
+inline const typename SimpleOrderBook<SIZE, MatchPolicy>::SimpleDepth&
+SimpleOrderBook<SIZE, MatchPolicy>::depth() const
 {
   return depth_;
 }
@@ -0,0 +1,88 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "impl/simple_order_book.h"
+#include "book/types.h"
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef impl::SimpleOrderBook<5> FifoOrderBook;
+
+// Rest a deep ask side, then send fill or kill buys each a little larger 
+// than the side can fill, and report the time taken per rejected order
+double run_reject_test(uint32_t levels, 
+                       uint32_t level_orders, 
+                       uint32_t inbound_count,
+                       bool resting_aon)
+{
+  FifoOrderBook order_book;
+  std::vector<impl::SimpleOrder*> orders;
+  Quantity total_qty = 0;
+
+  for (uint32_t level = 0; level < levels; ++level) {
+    for (uint32_t i = 0; i < level_orders; ++i) {
+      // Optionally make every tenth order an all or none order larger than
+      // any inbound order, which its level's smallest all or none rules out
+      if (resting_aon && (i % 10 == 0)) {
+        orders.push_back(new impl::SimpleOrder(false, 1250 + level, 
+                                               100000000));
+        order_book.add(orders.back(), oc_all_or_none);
+      } else {
+        orders.push_back(new impl::SimpleOrder(false, 1250 + level, 100));
+        order_book.add(orders.back());
+        total_qty += 100;
+      }
+      order_book.perform_callbacks();
+    }
+  }
+
+  const size_t first_inbound = orders.size();
+  for (uint32_t i = 0; i < inbound_count; ++i) {
+    orders.push_back(new impl::SimpleOrder(true, 1250 + levels, 
+                                           total_qty + 100));
+  }
+
+  clock_t start = clock();
+  for (size_t i = first_inbound; i < orders.size(); ++i) {
+    order_book.add(orders[i], oc_all_or_none | oc_immediate_or_cancel);
+    order_book.perform_callbacks();
+  }
+  clock_t stop = clock();
+
+  for (size_t i = 0; i < orders.size(); ++i) {
+    delete orders[i];
+  }
+  return double(stop - start) * 1000000 / CLOCKS_PER_SEC / inbound_count;
+}
+
+int main(int argc, const char* argv[])
+{
+  uint32_t inbound_count = 10000;
+  if (argc > 1) {
+    inbound_count = atoi(argv[1]);
+    if (!inbound_count) {
+      inbound_count = 10000;
+    }
+  }
+  std::cout << "performance test of fill or kill rejection, " 
+            << inbound_count << " inbound orders per book" << std::endl;
+
+  const uint32_t levels[] = { 10, 100, 1000 };
+  const uint32_t level_orders = 20;
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i) {
+    double totals_usec = 
+        run_reject_test(levels[i], level_orders, inbound_count, false);
+    double visit_usec = 
+        run_reject_test(levels[i], level_orders, inbound_count, true);
+    std::cout << levels[i] << " levels of " << level_orders << " orders:"
+              << " " << totals_usec << " usec per reject,"
+              << " with resting AON " << visit_usec << " usec per reject"
+              << std::endl;
+  }
+}
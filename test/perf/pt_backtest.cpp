@@ -0,0 +1,132 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "impl/backtest_runner.h"
+#include "impl/simple_order_book.h"
+#include "book/types.h"
+
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef impl::SimpleOrderBook<5> FifoOrderBook;
+typedef impl::ReplayBacktest<FifoOrderBook> FifoBacktest;
+
+const char* const EVENT_PATH = "pt_backtest.lbev";
+
+// Write random adds around the spread, with cancels and replaces of
+// orders added before, keeping the book near a steady size
+bool write_events(uint32_t event_count)
+{
+  impl::EventFileWriter writer;
+  if (!writer.open(EVENT_PATH)) {
+    return false;
+  }
+  std::vector<OrderId> live;
+  OrderId next_id = 1;
+  srand(1);
+  for (uint32_t i = 0; i < event_count; ++i) {
+    int action = rand() % 10;
+    if (live.size() < 1000 || (live.size() < 2000 && action < 5)) {
+      bool is_buy = (rand() % 2) == 0;
+      Price price = is_buy ? 1202 + (rand() % 50) : 1250 + (rand() % 50);
+      writer.write(impl::add_event(next_id, is_buy, price,
+                                   100 * (1 + rand() % 5)));
+      live.push_back(next_id++);
+    } else {
+      size_t index = rand() % live.size();
+      if (action < 8) {
+        writer.write(impl::cancel_event(live[index]));
+        live[index] = live.back();
+        live.pop_back();
+      } else {
+        writer.write(impl::replace_event(live[index],
+                                         -10 * (1 + rand() % 5), 0));
+      }
+    }
+  }
+  return writer.close();
+}
+
+// Wall clock time, as the workers' processor time adds up
+double now_usec()
+{
+#ifdef _WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return double(count.QuadPart) * 1000000 / frequency.QuadPart;
+#else
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return double(now.tv_sec) * 1000000 + now.tv_usec;
+#endif
+}
+
+uint32_t processor_count()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? uint32_t(count) : 1;
+#endif
+}
+
+int main(int argc, const char* argv[])
+{
+  uint32_t event_count = 200000;
+  uint32_t job_count = 32;
+  uint32_t max_workers = processor_count();
+  if (argc > 1 && atoi(argv[1]) > 0) {
+    event_count = atoi(argv[1]);
+  }
+  if (argc > 2 && atoi(argv[2]) > 0) {
+    job_count = atoi(argv[2]);
+  }
+  if (argc > 3 && atoi(argv[3]) > 0) {
+    max_workers = atoi(argv[3]);
+  }
+  std::cout << "performance test of parallel backtest, " << job_count
+            << " replays of " << event_count << " events, "
+            << processor_count() << " processors" << std::endl;
+
+  impl::EventFileReader events;
+  if (!write_events(event_count) || !events.open(EVENT_PATH)) {
+    std::cout << "could not write events" << std::endl;
+    return 1;
+  }
+
+  double single_rate = 0;
+  for (uint32_t workers = 1; workers <= max_workers; workers *= 2) {
+    FifoBacktest backtest(job_count);
+    impl::BacktestRunner runner(workers);
+    double start = now_usec();
+    if (!runner.run(backtest, events, job_count)) {
+      std::cout << "could not start " << workers << " workers" << std::endl;
+      break;
+    }
+    double usec = now_usec() - start;
+    double rate = backtest.total().events_applied * 1000000.0 / usec;
+    if (workers == 1) {
+      single_rate = rate;
+    }
+    std::cout << workers << " workers: " << rate << " events/sec, "
+              << rate / single_rate << "x one worker" << std::endl;
+  }
+  events.close();
+  remove(EVENT_PATH);
+  return 0;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "book/book_fork.h"
+#include "impl/simple_order_book.h"
+#include "book/types.h"
+
+#include <iostream>
+#include <deque>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef impl::SimpleOrderBook<5> FifoOrderBook;
+typedef BookFork<impl::SimpleOrder*> SimpleFork;
+
+// Fill a book with orders on 50 price levels a side
+void fill_book(FifoOrderBook& order_book,
+               uint32_t order_count,
+               std::deque<impl::SimpleOrder>& orders)
+{
+  srand(1);
+  for (uint32_t i = 0; i < order_count; ++i) {
+    bool is_buy = (i % 2) == 0;
+    Price price = is_buy ? 1200 + (rand() % 50) : 1251 + (rand() % 50);
+    orders.push_back(impl::SimpleOrder(is_buy, price,
+                                       100 * (1 + rand() % 5)));
+    order_book.add(&orders.back());
+    order_book.perform_callbacks();
+  }
+}
+
+double usec_since(clock_t start)
+{
+  return double(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+}
+
+int main(int argc, const char* argv[])
+{
+  uint32_t order_count = 10000;
+  uint32_t what_if_count = 10000;
+  if (argc > 1 && atoi(argv[1]) > 0) {
+    order_count = atoi(argv[1]);
+  }
+  if (argc > 2 && atoi(argv[2]) > 0) {
+    what_if_count = atoi(argv[2]);
+  }
+  std::cout << "performance test of book fork, " << order_count
+            << " resting orders, " << what_if_count << " what ifs"
+            << std::endl;
+
+  FifoOrderBook order_book;
+  std::deque<impl::SimpleOrder> orders;
+  fill_book(order_book, order_count, orders);
+  // Sweeps a few levels of the asks
+  impl::SimpleOrder sweep(true, 1254, 2000);
+
+  // Copying the book's sides, before any order is sent
+  clock_t start = clock();
+  size_t copied = 0;
+  for (uint32_t i = 0; i < what_if_count; ++i) {
+    FifoOrderBook::Bids bids(order_book.bids());
+    FifoOrderBook::Asks asks(order_book.asks());
+    copied += bids.size() + asks.size();
+  }
+  double copy_usec = usec_since(start);
+
+  // A fork and the what if order
+  start = clock();
+  size_t filled = 0;
+  for (uint32_t i = 0; i < what_if_count; ++i) {
+    SimpleFork fork(order_book);
+    fork.add(&sweep);
+    filled += fork.fills().size();
+  }
+  double fork_usec = usec_since(start);
+
+  std::cout << "copy of sides: " << copy_usec / what_if_count
+            << " usec each, " << copied / what_if_count << " orders"
+            << std::endl;
+  std::cout << "fork and add: " << fork_usec / what_if_count
+            << " usec each, " << filled / what_if_count << " fills"
+            << std::endl;
+  return 0;
+}
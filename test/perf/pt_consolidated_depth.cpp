@@ -0,0 +1,167 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "book/consolidated_depth.h"
+#include "book/types.h"
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef Depth<5> VenueDepth;
+typedef ConsolidatedDepth<5> SizedConsolidatedDepth;
+
+// An order added to or closed at one venue
+struct Event {
+  uint32_t venue;
+  Price price;
+  bool is_bid;
+  bool close;
+};
+
+// Make events which add orders near the inside of random venues, and close
+// orders added before
+void make_events(uint32_t venue_count,
+                 uint32_t event_count,
+                 std::vector<Event>& events)
+{
+  std::vector<std::vector<Event> > open(venue_count);
+  srand(1);
+  for (uint32_t i = 0; i < event_count; ++i) {
+    Event event;
+    event.venue = rand() % venue_count;
+    std::vector<Event>& venue_open = open[event.venue];
+    if (!venue_open.empty() && (rand() % 2)) {
+      size_t index = rand() % venue_open.size();
+      event = venue_open[index];
+      event.close = true;
+      venue_open[index] = venue_open.back();
+      venue_open.pop_back();
+    } else {
+      event.is_bid = (rand() % 2) == 0;
+      event.price = event.is_bid ? 1250 - (rand() % 12) : 1251 + (rand() % 12);
+      event.close = false;
+      venue_open.push_back(event);
+    }
+    events.push_back(event);
+  }
+}
+
+// Start each venue with several levels on each side
+void fill_venues(std::vector<VenueDepth>& venues)
+{
+  for (size_t venue = 0; venue < venues.size(); ++venue) {
+    for (Price offset = 0; offset < 10; ++offset) {
+      venues[venue].add_order(1250 - offset, 1000, true);
+      venues[venue].add_order(1251 + offset, 1000, false);
+    }
+  }
+}
+
+void apply(VenueDepth& venue, const Event& event)
+{
+  if (event.close) {
+    venue.close_order(event.price, 100, event.is_bid);
+  } else {
+    venue.add_order(event.price, 100, event.is_bid);
+  }
+}
+
+// Merge one side of every venue into the best levels, from scratch
+void merge_side(const std::vector<VenueDepth>& venues,
+                bool is_bid,
+                DepthLevel* merged)
+{
+  for (int index = 0; index < 5; ++index) {
+    merged[index].init(INVALID_LEVEL_PRICE, false);
+  }
+  for (size_t venue = 0; venue < venues.size(); ++venue) {
+    const DepthLevel* level = is_bid ? venues[venue].bids()
+                                     : venues[venue].asks();
+    for (int index = 0; index < 5 && level[index].price(); ++index) {
+      const Price price = level[index].price();
+      int pos = 0;
+      while (pos < 5 && merged[pos].price() != INVALID_LEVEL_PRICE &&
+             merged[pos].price() != price &&
+             (is_bid ? merged[pos].price() > price
+                     : merged[pos].price() < price)) {
+        ++pos;
+      }
+      if (pos == 5) {
+        continue;
+      }
+      if (merged[pos].price() != price) {
+        for (int move = 4; move > pos; --move) {
+          merged[move] = merged[move - 1];
+        }
+        merged[pos].init(price, false);
+      }
+      merged[pos].add_orders(level[index].order_count(),
+                             level[index].aggregate_qty());
+    }
+  }
+}
+
+// Report the time taken per venue event to keep the merged depth current
+double run_test(uint32_t venue_count,
+                const std::vector<Event>& events,
+                bool incremental)
+{
+  std::vector<VenueDepth> venues(venue_count);
+  fill_venues(venues);
+  SizedConsolidatedDepth consolidated;
+  for (size_t venue = 0; venue < venues.size(); ++venue) {
+    consolidated.add_venue(venues[venue]);
+  }
+  DepthLevel merged[10];
+  Quantity best_qty = 0;
+
+  clock_t start = clock();
+  for (size_t i = 0; i < events.size(); ++i) {
+    apply(venues[events[i].venue], events[i]);
+    if (incremental) {
+      consolidated.update(events[i].venue);
+      best_qty += consolidated.bids()->aggregate_qty();
+    } else {
+      merge_side(venues, true, merged);
+      merge_side(venues, false, merged + 5);
+      best_qty += merged[0].aggregate_qty();
+    }
+  }
+  clock_t stop = clock();
+
+  // Use the result, so the merge is not optimized away
+  if (!best_qty) {
+    std::cout << "no best bid" << std::endl;
+  }
+  return double(stop - start) * 1000000 / CLOCKS_PER_SEC / events.size();
+}
+
+int main(int argc, const char* argv[])
+{
+  uint32_t event_count = 1000000;
+  if (argc > 1) {
+    event_count = atoi(argv[1]);
+    if (!event_count) {
+      event_count = 1000000;
+    }
+  }
+  std::cout << "performance test of consolidated depth, "
+            << event_count << " venue events" << std::endl;
+
+  const uint32_t venue_counts[] = { 10, 20, 50 };
+  for (size_t i = 0; i < sizeof(venue_counts) / sizeof(venue_counts[0]); ++i) {
+    std::vector<Event> events;
+    make_events(venue_counts[i], event_count, events);
+    double scratch_usec = run_test(venue_counts[i], events, false);
+    double incremental_usec = run_test(venue_counts[i], events, true);
+    std::cout << venue_counts[i] << " venues:"
+              << " merged from scratch " << scratch_usec << " usec,"
+              << " incrementally " << incremental_usec << " usec per event"
+              << std::endl;
+  }
+}
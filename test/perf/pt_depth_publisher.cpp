@@ -0,0 +1,106 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "impl/depth_publisher.h"
+#include "book/types.h"
+
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef impl::DepthPublisher<5> SizedPublisher;
+typedef impl::DepthReader<5> SizedReader;
+
+const char* const REGION_PATH = "pt_depth_publisher.depth";
+
+int main(int argc, const char* argv[])
+{
+  uint32_t book_count = 5000;
+  if (argc > 1 && atoi(argv[1]) > 0) {
+    book_count = atoi(argv[1]);
+  }
+  const uint32_t change_count = 2000000;
+  std::cout << "performance test of depth publisher, " << book_count
+            << " books" << std::endl;
+
+  SizedPublisher publisher;
+  SizedReader reader;
+  if (!publisher.create(REGION_PATH, book_count)) {
+    std::cout << "could not create " << REGION_PATH << std::endl;
+    return 1;
+  }
+  std::vector<Depth<5> > depths(book_count);
+  for (uint32_t book = 0; book < book_count; ++book) {
+    char symbol[24];
+    sprintf(symbol, "SYM%u", book);
+    publisher.set_symbol(book, symbol);
+  }
+  if (!reader.open(REGION_PATH)) {
+    std::cout << "could not open " << REGION_PATH << std::endl;
+    return 1;
+  }
+
+  // Random adds to random books, each published
+  srand(1);
+  clock_t start = clock();
+  uint32_t written = 0;
+  for (uint32_t i = 0; i < change_count; ++i) {
+    const uint32_t book = rand() % book_count;
+    const bool is_buy = (rand() % 2) == 0;
+    const Price price = is_buy ? 1240 + rand() % 10 : 1251 + rand() % 10;
+    depths[book].add_order(price, 100, is_buy);
+    if (publisher.publish(book, depths[book])) {
+      ++written;
+    }
+  }
+  double usec = double(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+  std::cout << "publish: " << written * 1000000.0 / usec
+            << " books/sec" << std::endl;
+
+  // Copy every book, then read every best bid in place
+  DepthLevel levels[10];
+  ChangeId last_change = 0;
+  Quantity total = 0;
+  start = clock();
+  for (uint32_t round = 0; round < change_count / book_count; ++round) {
+    for (uint32_t book = 0; book < book_count; ++book) {
+      if (reader.read(book, levels, last_change)) {
+        total += levels[0].aggregate_qty();
+      }
+    }
+  }
+  usec = double(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+  std::cout << "read: " << change_count * 1000000.0 / usec
+            << " books/sec" << std::endl;
+
+  start = clock();
+  for (uint32_t round = 0; round < change_count / book_count; ++round) {
+    for (uint32_t book = 0; book < book_count; ++book) {
+      uint32_t sequence;
+      if (reader.begin_read(book, sequence)) {
+        const Quantity best_bid_qty = reader.levels(book)->aggregate_qty();
+        if (reader.end_read(book, sequence)) {
+          total += best_bid_qty;
+        }
+      }
+    }
+  }
+  usec = double(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+  std::cout << "read in place: " << change_count * 1000000.0 / usec
+            << " books/sec (" << total << ")" << std::endl;
+
+  uint32_t book = 0;
+  char symbol[24];
+  sprintf(symbol, "SYM%u", book_count - 1);
+  start = clock();
+  reader.find(symbol, book);
+  usec = double(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+  std::cout << "find last symbol: " << usec << " usec" << std::endl;
+  remove(REGION_PATH);
+  return 0;
+}
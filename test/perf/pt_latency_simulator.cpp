@@ -0,0 +1,122 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "impl/latency_simulator.h"
+#include "impl/simple_order_book.h"
+#include "book/types.h"
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef impl::SimpleOrderBook<5> FifoOrderBook;
+typedef impl::LatencySimulator<FifoOrderBook> FifoSimulator;
+
+// Random adds around the spread, with cancels and replaces of orders added
+// before, a microsecond or so apart
+void generate_events(uint32_t event_count, std::vector<impl::TimedEvent>& events)
+{
+  std::vector<OrderId> live;
+  OrderId next_id = 1;
+  Timestamp time = 0;
+  srand(1);
+  events.resize(event_count);
+  for (uint32_t i = 0; i < event_count; ++i) {
+    impl::TimedEvent& event = events[i];
+    time += rand() % 3;
+    event.time = time;
+    int action = rand() % 10;
+    if (live.size() < 1000 || (live.size() < 2000 && action < 5)) {
+      bool is_buy = (rand() % 2) == 0;
+      Price price = is_buy ? 1202 + (rand() % 50) : 1250 + (rand() % 50);
+      event.event = impl::add_event(next_id, is_buy, price,
+                                    100 * (1 + rand() % 5));
+      live.push_back(next_id++);
+    } else {
+      size_t index = rand() % live.size();
+      if (action < 8) {
+        event.event = impl::cancel_event(live[index]);
+        live[index] = live.back();
+        live.pop_back();
+      } else {
+        event.event = impl::replace_event(live[index],
+                                          -10 * (1 + rand() % 5), 0);
+      }
+    }
+  }
+}
+
+// Joins the price of every tenth add it hears of, cancelling its previous
+// order, and notes the most commands queued
+class JoiningStrategy : public impl::MarketDataListener {
+public:
+  explicit JoiningStrategy(FifoSimulator& simulator)
+  : simulator_(simulator),
+    heard_(0),
+    next_id_(1000000000),
+    max_pending_(0)
+  {
+  }
+
+  virtual void on_market_data(uint32_t book, const impl::EventRecord& event)
+  {
+    if (simulator_.pending() > max_pending_) {
+      max_pending_ = simulator_.pending();
+    }
+    if (event.type != impl::et_add || event.order_id >= 1000000000 ||
+        ++heard_ % 10) {
+      return;
+    }
+    if (next_id_ > 1000000000) {
+      simulator_.submit(book, impl::cancel_event(next_id_ - 1));
+    }
+    simulator_.submit(book, impl::add_event(next_id_++, event.is_buy != 0,
+                                            event.price, 100));
+  }
+
+  uint32_t max_pending() const { return max_pending_; }
+
+private:
+  FifoSimulator& simulator_;
+  uint32_t heard_;
+  OrderId next_id_;
+  uint32_t max_pending_;
+};
+
+int main(int argc, const char* argv[])
+{
+  uint32_t event_count = 1000000;
+  if (argc > 1 && atoi(argv[1]) > 0) {
+    event_count = atoi(argv[1]);
+  }
+  std::cout << "performance test of latency simulator, " << event_count
+            << " historical events" << std::endl;
+  std::vector<impl::TimedEvent> events;
+  generate_events(event_count, events);
+
+  const Timestamp latencies[] = { 0, 5, 50 };
+  for (size_t index = 0; index < 3; ++index) {
+    FifoOrderBook order_book;
+    FifoSimulator simulator(latencies[index], latencies[index]);
+    JoiningStrategy strategy(simulator);
+    simulator.set_market_data_listener(&strategy);
+    uint32_t book = simulator.add_book(order_book);
+    simulator.add_feed(book, &events[0], &events[0] + events.size());
+
+    clock_t start = clock();
+    uint64_t command_count = simulator.run();
+    double usec = double(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+    std::cout << "latency " << latencies[index] << ": "
+              << simulator.events_applied() * 1000000.0 / usec
+              << " events/sec, " << command_count * 1000000.0 / usec
+              << " commands/sec, " << strategy.max_pending()
+              << " commands queued at most, "
+              << simulator.orders_held(book) << " orders held at end, "
+              << simulator.now() << " usec simulated" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "impl/simple_order_book.h"
+#include "book/match_policy.h"
+#include "book/types.h"
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef impl::SimpleOrderBook<5, FifoMatch> FifoOrderBook;
+typedef impl::SimpleOrderBook<5, ProRataMatch> ProRataOrderBook;
+
+// Match inbound orders against a single deep price level, and report the
+// time taken per inbound order
+template <class TypedOrderBook>
+double run_level_test(uint32_t level_orders, uint32_t inbound_count)
+{
+  TypedOrderBook order_book;
+  std::vector<impl::SimpleOrder*> orders;
+  srand(level_orders);
+
+  // Rest the level
+  for (uint32_t i = 0; i < level_orders; ++i) {
+    Quantity qty = ((rand() % 10) + 1) * 1000;
+    orders.push_back(new impl::SimpleOrder(false, 1250, qty));
+    order_book.add(orders.back());
+    order_book.perform_callbacks();
+  }
+
+  // Each inbound order takes a small part of the level
+  Quantity inbound_qty = level_orders * 10;
+  for (uint32_t i = 0; i < inbound_count; ++i) {
+    orders.push_back(new impl::SimpleOrder(true, 1250, inbound_qty));
+  }
+
+  clock_t start = clock();
+  for (uint32_t i = level_orders; i < orders.size(); ++i) {
+    order_book.add(orders[i]);
+    order_book.perform_callbacks();
+  }
+  clock_t stop = clock();
+
+  for (uint32_t i = 0; i < orders.size(); ++i) {
+    delete orders[i];
+  }
+  return double(stop - start) * 1000000 / CLOCKS_PER_SEC / inbound_count;
+}
+
+int main(int argc, const char* argv[])
+{
+  uint32_t inbound_count = 200;
+  if (argc > 1) {
+    inbound_count = atoi(argv[1]);
+    if (!inbound_count) {
+      inbound_count = 200;
+    }
+  }
+  std::cout << "performance test of matching policy, " << inbound_count
+            << " inbound orders per level" << std::endl;
+
+  const uint32_t level_sizes[] = { 10, 100, 250, 500, 1000 };
+  for (size_t i = 0; i < sizeof(level_sizes) / sizeof(level_sizes[0]); ++i) {
+    uint32_t level_orders = level_sizes[i];
+    double fifo_usec =
+        run_level_test<FifoOrderBook>(level_orders, inbound_count);
+    double pro_rata_usec =
+        run_level_test<ProRataOrderBook>(level_orders, inbound_count);
+    std::cout << level_orders << " orders per level:"
+              << " fifo " << fifo_usec << " usec per inbound,"
+              << " pro-rata " << pro_rata_usec << " usec per inbound"
+              << std::endl;
+  }
+}
@@ -0,0 +1,174 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "impl/event_file.h"
+#include "impl/event_replay.h"
+#include "impl/simple_order_book.h"
+#include "book/types.h"
+
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef impl::SimpleOrderBook<5> FifoOrderBook;
+typedef impl::EventReplay<FifoOrderBook> FifoEventReplay;
+
+const char* const CSV_PATH = "pt_replay.csv";
+const char* const EVENT_PATH = "pt_replay.lbev";
+
+// Write random adds around the spread, with cancels and replaces of
+// orders added before
+bool write_csv(uint32_t event_count)
+{
+  FILE* csv = fopen(CSV_PATH, "w");
+  if (!csv) {
+    return false;
+  }
+  std::vector<OrderId> live;
+  OrderId next_id = 1;
+  srand(1);
+  for (uint32_t i = 0; i < event_count; ++i) {
+    // Keep the book near a steady size
+    int action = rand() % 10;
+    if (live.size() < 1000 || (live.size() < 2000 && action < 5)) {
+      bool is_buy = (rand() % 2) == 0;
+      // Mostly rest, sometimes cross
+      Price price = is_buy ? 1202 + (rand() % 50) : 1250 + (rand() % 50);
+      fprintf(csv, "A,%llu,%c,%u,%u\n", (unsigned long long)next_id,
+              is_buy ? 'B' : 'S', price, 100 * (1 + rand() % 5));
+      live.push_back(next_id++);
+    } else {
+      size_t index = rand() % live.size();
+      if (action < 8) {
+        fprintf(csv, "C,%llu\n", (unsigned long long)live[index]);
+        live[index] = live.back();
+        live.pop_back();
+      } else {
+        fprintf(csv, "R,%llu,-%u,0\n", (unsigned long long)live[index],
+                10 * (1 + rand() % 5));
+      }
+    }
+  }
+  return fclose(csv) == 0;
+}
+
+// Replay the text file, parsing each line
+double run_csv_replay(uint32_t& applied)
+{
+  FifoOrderBook order_book;
+  FifoEventReplay replay(order_book);
+  applied = 0;
+  clock_t start = clock();
+  FILE* csv = fopen(CSV_PATH, "r");
+  char line[256];
+  impl::EventRecord record;
+  while (csv && fgets(line, sizeof(line), csv)) {
+    if (impl::parse_csv_event(line, record)) {
+      applied += replay.replay(&record, &record + 1);
+    }
+  }
+  if (csv) {
+    fclose(csv);
+  }
+  clock_t stop = clock();
+  return double(stop - start) * 1000000 / CLOCKS_PER_SEC;
+}
+
+// Replay the mapped event file
+double run_mapped_replay(uint32_t& applied)
+{
+  FifoOrderBook order_book;
+  FifoEventReplay replay(order_book);
+  applied = 0;
+  clock_t start = clock();
+  impl::EventFileReader reader;
+  if (reader.open(EVENT_PATH)) {
+    applied = replay.replay(reader.begin(), reader.end());
+  }
+  clock_t stop = clock();
+  return double(stop - start) * 1000000 / CLOCKS_PER_SEC;
+}
+
+// Read the mapped event file without a book, to show what reading costs
+double run_mapped_read(uint32_t& read)
+{
+  read = 0;
+  uint64_t quantity = 0;
+  clock_t start = clock();
+  impl::EventFileReader reader;
+  if (reader.open(EVENT_PATH)) {
+    for (const impl::EventRecord* event = reader.begin(); 
+         event != reader.end(); ++event) {
+      quantity += event->qty;
+      ++read;
+    }
+  }
+  clock_t stop = clock();
+  // Use the result, so the reads are not optimized away
+  if (!quantity) {
+    std::cout << "no quantity" << std::endl;
+  }
+  return double(stop - start) * 1000000 / CLOCKS_PER_SEC;
+}
+
+int main(int argc, const char* argv[])
+{
+  // Convert a text file of events to an event file
+  if (argc > 1 && !strcmp(argv[1], "-convert")) {
+    if (argc != 4) {
+      std::cout << "usage: pt_replay -convert <csv file> <event file>"
+                << std::endl;
+      return 1;
+    }
+    uint32_t bad_line = 0;
+    if (!impl::convert_csv_events(argv[2], argv[3], bad_line)) {
+      std::cout << "conversion failed";
+      if (bad_line) {
+        std::cout << " at line " << bad_line;
+      }
+      std::cout << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  uint32_t event_count = 2000000;
+  if (argc > 1) {
+    event_count = atoi(argv[1]);
+    if (!event_count) {
+      event_count = 2000000;
+    }
+  }
+  std::cout << "performance test of event replay, "
+            << event_count << " events" << std::endl;
+
+  uint32_t bad_line = 0;
+  if (!write_csv(event_count) ||
+      !impl::convert_csv_events(CSV_PATH, EVENT_PATH, bad_line)) {
+    std::cout << "could not write events" << std::endl;
+    return 1;
+  }
+
+  uint32_t csv_applied = 0;
+  uint32_t mapped_applied = 0;
+  uint32_t mapped_read = 0;
+  double csv_usec = run_csv_replay(csv_applied);
+  double mapped_usec = run_mapped_replay(mapped_applied);
+  double read_usec = run_mapped_read(mapped_read);
+  std::cout << "parsed text: " << csv_applied * 1000000.0 / csv_usec
+            << " events/sec" << std::endl;
+  std::cout << "mapped file: " << mapped_applied * 1000000.0 / mapped_usec
+            << " events/sec" << std::endl;
+  std::cout << "mapped file read only: " 
+            << mapped_read * 1000000.0 / (read_usec ? read_usec : 1)
+            << " events/sec" << std::endl;
+  remove(CSV_PATH);
+  remove(EVENT_PATH);
+  return 0;
+}
@@ -12,10 +12,9 @@ using book::ChangeId;
 
 namespace test {
 
-template <int SIZE = 5>
+template <int SIZE = 5, class SizedDepth = Depth<SIZE> >
 class ChangedChecker {
 public:
-  typedef Depth<SIZE> SizedDepth;
   ChangedChecker(SizedDepth& depth)
   : depth_(depth)
   {
@@ -753,4 +753,139 @@ BOOST_AUTO_TEST_CASE(TestReplaceBidLargerMatchAon)
   BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
 }
 
+BOOST_AUTO_TEST_CASE(TestLevelTotals)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask2(false, 1252, 300);
+  SimpleOrder ask1(false, 1251, 500, 0, 100); // Iceberg
+  SimpleOrder ask0(false, 1251, 200); // AON
+  SimpleOrder bid0(true,  1251, 150);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false, false, AON));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+
+  // Only the displayed part of an iceberg is counted
+  SimpleOrderBook::AskTotals::const_iterator level;
+  level = order_book.ask_totals().find(1251);
+  BOOST_REQUIRE(level != order_book.ask_totals().end());
+  BOOST_REQUIRE_EQUAL(100, level->second.qty);
+  BOOST_REQUIRE_EQUAL(200, level->second.aon_qty);
+
+  // Take the iceberg's slice and part of its refresh
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  level = order_book.ask_totals().find(1251);
+  BOOST_REQUIRE_EQUAL(50, level->second.qty);
+  BOOST_REQUIRE_EQUAL(200, level->second.aon_qty);
+
+  // A level is gone with its orders
+  BOOST_REQUIRE(cancel_and_verify(order_book, &ask0, impl::os_cancelled));
+  BOOST_REQUIRE(cancel_and_verify(order_book, &ask1, impl::os_cancelled));
+  BOOST_REQUIRE_EQUAL(1, order_book.ask_totals().size());
+  BOOST_REQUIRE_EQUAL(300, order_book.ask_totals().begin()->second.qty);
+}
+
+BOOST_AUTO_TEST_CASE(TestFillOrKillPrecheck)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask2(false, 1253, 100);
+  SimpleOrder ask1(false, 1252, 100); // AON
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder bid0(true,  1252, 250);
+  SimpleOrder bid1(true,  1252, 200);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false, false, AON));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+
+  // Not enough at or below 1252, the book is untouched
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false, false, 
+                               oc_all_or_none | oc_immediate_or_cancel));
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid0.state());
+  BOOST_REQUIRE_EQUAL(3, order_book.asks().size());
+
+  // Enough only with the resting AON order
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid1, 200, 1251 * 100 + 1252 * 100);
+    SimpleFillCheck fc1(&ask0, 100, 1251 * 100);
+    SimpleFillCheck fc2(&ask1, 100, 1252 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid1, true, true, 
+                                 oc_all_or_none | oc_immediate_or_cancel));
+  ); }
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.ask_totals().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestSmallestAllOrNone)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask2(false, 1251, 400); // AON
+  SimpleOrder ask1(false, 1251, 200); // AON
+  SimpleOrder ask0(false, 1251, 300); // AON
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false, false, AON));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false, false, AON));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false, false, AON));
+
+  SimpleOrderBook::AskTotals::const_iterator level;
+  level = order_book.ask_totals().find(1251);
+  BOOST_REQUIRE_EQUAL(3, level->second.aon_count);
+  BOOST_REQUIRE_EQUAL(200, level->second.min_aon_qty);
+
+  // The smallest leaves, the next is found
+  BOOST_REQUIRE(cancel_and_verify(order_book, &ask1, impl::os_cancelled));
+  level = order_book.ask_totals().find(1251);
+  BOOST_REQUIRE_EQUAL(2, level->second.aon_count);
+  BOOST_REQUIRE_EQUAL(300, level->second.min_aon_qty);
+
+  // A replace can make a new smallest
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask2, -150));
+  level = order_book.ask_totals().find(1251);
+  BOOST_REQUIRE_EQUAL(250, level->second.min_aon_qty);
+}
+
+BOOST_AUTO_TEST_CASE(TestSkipLargeAllOrNone)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask3(false, 1252, 500); // AON
+  SimpleOrder ask2(false, 1252, 100);
+  SimpleOrder ask1(false, 1251, 600); // AON
+  SimpleOrder ask0(false, 1251, 500); // AON
+  SimpleOrder bid0(true,  1252, 150);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false, false, AON));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false, false, AON));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask3, false, false, AON));
+
+  // The level at 1251 is passed, and the AON order after the last order
+  // which can match at 1252
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1252 * 100);
+    SimpleFillCheck fc1(&ask2, 100, 1252 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, ask0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, ask1.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, ask3.state());
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(3, order_book.asks().size());
+
+  // A fill or kill which only the large AON orders could fill is rejected
+  // from the totals
+  SimpleOrder bid1(true,  1252, 400);
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false, false, 
+                               oc_all_or_none | oc_immediate_or_cancel));
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid1.state());
+
+  // An order large enough matches the smallest AON order
+  SimpleOrder bid2(true,  1251, 500);
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid2, 500, 1251 * 500);
+    SimpleFillCheck fc1(&ask0, 500, 1251 * 500);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid2, true, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+}
+
 } // Namespace
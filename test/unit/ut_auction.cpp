@@ -0,0 +1,324 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_Auction
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+#include "book/price_ladder.h"
+
+namespace liquibook {
+
+using book::IndicativeUncross;
+using book::PriceLadder;
+using impl::SimpleOrder;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+
+// Order book which remembers the last uncross update callback
+class UncrossOrderBook : public SimpleOrderBook {
+public:
+  UncrossOrderBook() : uncross_updates_(0) {}
+
+  virtual void perform_callback(SimpleCallback& cb) {
+    if (cb.type == SimpleCallback::cb_uncross_update) {
+      ++uncross_updates_;
+      last_uncross_ = cb;
+    } else {
+      SimpleOrderBook::perform_callback(cb);
+    }
+  }
+
+  int uncross_updates_;
+  SimpleCallback last_uncross_;
+};
+
+bool verify_uncross(const IndicativeUncross& uncross,
+                    Price price,
+                    Quantity matched_qty,
+                    Quantity buy_surplus,
+                    Quantity sell_surplus)
+{
+  bool matched = true;
+  if (uncross.price != price) {
+    std::cout << "Price " << uncross.price << std::endl;
+    matched = false;
+  }
+  if (uncross.matched_qty != matched_qty) {
+    std::cout << "Matched " << uncross.matched_qty << std::endl;
+    matched = false;
+  }
+  if (uncross.buy_surplus != buy_surplus) {
+    std::cout << "Buy surplus " << uncross.buy_surplus << std::endl;
+    matched = false;
+  }
+  if (uncross.sell_surplus != sell_surplus) {
+    std::cout << "Sell surplus " << uncross.sell_surplus << std::endl;
+    matched = false;
+  }
+  return matched;
+}
+
+BOOST_AUTO_TEST_CASE(TestLadderEmpty)
+{
+  PriceLadder ladder;
+  IndicativeUncross uncross;
+  ladder.indicative_uncross(uncross);
+  BOOST_REQUIRE(verify_uncross(uncross, 0, 0, 0, 0));
+
+  ladder.reset(1240, 1260);
+  ladder.indicative_uncross(uncross);
+  BOOST_REQUIRE(verify_uncross(uncross, 0, 0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestLadderNotCrossed)
+{
+  PriceLadder ladder;
+  IndicativeUncross uncross;
+  ladder.reset(1240, 1260);
+  ladder.change_bid_qty(1250, 100);
+  ladder.change_ask_qty(1251, 100);
+  ladder.indicative_uncross(uncross);
+  BOOST_REQUIRE(verify_uncross(uncross, 0, 0, 0, 0));
+  BOOST_REQUIRE_EQUAL(100, ladder.bid_qty_at_or_above(1250));
+  BOOST_REQUIRE_EQUAL(0, ladder.bid_qty_at_or_above(1251));
+  BOOST_REQUIRE_EQUAL(0, ladder.ask_qty_at_or_below(1250));
+  BOOST_REQUIRE_EQUAL(100, ladder.ask_qty_at_or_below(1251));
+}
+
+BOOST_AUTO_TEST_CASE(TestLadderUncross)
+{
+  PriceLadder ladder;
+  IndicativeUncross uncross;
+  ladder.reset(1240, 1260);
+  ladder.change_bid_qty(1252, 100);
+  ladder.change_bid_qty(1250, 200);
+  ladder.change_ask_qty(1249, 150);
+  ladder.change_ask_qty(1251, 100);
+  ladder.indicative_uncross(uncross);
+  BOOST_REQUIRE(verify_uncross(uncross, 1250, 150, 150, 0));
+
+  // More supply moves the uncross up
+  ladder.change_ask_qty(1250, 150);
+  ladder.indicative_uncross(uncross);
+  BOOST_REQUIRE(verify_uncross(uncross, 1250, 300, 0, 0));
+
+  // Less demand moves the uncross down to the least surplus
+  ladder.change_bid_qty(1250, -200);
+  ladder.indicative_uncross(uncross);
+  BOOST_REQUIRE(verify_uncross(uncross, 1249, 100, 0, 50));
+}
+
+BOOST_AUTO_TEST_CASE(TestLadderOutOfRange)
+{
+  PriceLadder ladder;
+  IndicativeUncross uncross;
+  ladder.reset(1240, 1260);
+  // Market orders fall at the ends of the ladder
+  ladder.change_bid_qty(MARKET_ORDER_BID_SORT_PRICE, 100);
+  ladder.change_ask_qty(MARKET_ORDER_ASK_SORT_PRICE, 300);
+  ladder.change_bid_qty(1255, 200);
+  ladder.indicative_uncross(uncross);
+  BOOST_REQUIRE(verify_uncross(uncross, 1255, 300, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestAuctionNoMatch)
+{
+  UncrossOrderBook order_book;
+  SimpleOrder ask1(false, 1251, 100);
+  SimpleOrder ask0(false, 1249, 200);
+  SimpleOrder bid1(true,  1252, 100);
+  SimpleOrder bid0(true,  1250, 300);
+
+  order_book.begin_auction(1200, 1300);
+  BOOST_REQUIRE(order_book.in_auction());
+
+  // Crossing orders do not match
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(2, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1252, 1, 100));
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 300));
+  BOOST_REQUIRE(dc.verify_ask(1249, 1, 200));
+  BOOST_REQUIRE(dc.verify_ask(1251, 1, 100));
+
+  // One update for the auction start, and one per order
+  BOOST_REQUIRE_EQUAL(5, order_book.uncross_updates_);
+  BOOST_REQUIRE(verify_uncross(order_book.indicative_uncross(),
+                               1250, 200, 200, 0));
+  BOOST_REQUIRE_EQUAL(1250, order_book.last_uncross_.uncross_price);
+  BOOST_REQUIRE_EQUAL(200, order_book.last_uncross_.uncross_qty);
+  BOOST_REQUIRE_EQUAL(200, order_book.last_uncross_.buy_surplus);
+  BOOST_REQUIRE_EQUAL(0, order_book.last_uncross_.sell_surplus);
+}
+
+BOOST_AUTO_TEST_CASE(TestAuctionCancelReplace)
+{
+  UncrossOrderBook order_book;
+  SimpleOrder ask0(false, 1249, 200);
+  SimpleOrder bid1(true,  1252, 100);
+  SimpleOrder bid0(true,  1250, 300);
+
+  order_book.begin_auction(1200, 1300);
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(verify_uncross(order_book.indicative_uncross(),
+                               1250, 200, 200, 0));
+
+  // Cancel the larger bid
+  BOOST_REQUIRE(cancel_and_verify(order_book, &bid0, impl::os_cancelled));
+  BOOST_REQUIRE(verify_uncross(order_book.indicative_uncross(),
+                               1249, 100, 0, 100));
+  BOOST_REQUIRE_EQUAL(5, order_book.uncross_updates_);
+
+  // Increase the ask
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask0, 100));
+  BOOST_REQUIRE(verify_uncross(order_book.indicative_uncross(),
+                               1249, 100, 0, 200));
+
+  // Reprice the bid below the ask
+  BOOST_REQUIRE(replace_and_verify(order_book, &bid1, 0, 1248));
+  BOOST_REQUIRE(verify_uncross(order_book.indicative_uncross(),
+                               0, 0, 0, 0));
+  BOOST_REQUIRE_EQUAL(7, order_book.uncross_updates_);
+}
+
+BOOST_AUTO_TEST_CASE(TestEndAuction)
+{
+  UncrossOrderBook order_book;
+  SimpleOrder ask1(false, 1251, 100);
+  SimpleOrder ask0(false, 1249, 200);
+  SimpleOrder bid1(true,  1252, 100);
+  SimpleOrder bid0(true,  1250, 300);
+  SimpleOrder bid2(true,  1248, 100);
+
+  order_book.begin_auction(1200, 1300);
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Uncross at 1250
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&bid1, 100, 1250 * 100);
+    SimpleFillCheck fc2(&ask0, 200, 1250 * 200);
+    SimpleFillCheck fc3(&ask1, 0, 0);
+    BOOST_REQUIRE(order_book.end_auction());
+    order_book.perform_callbacks();
+  ); }
+  BOOST_REQUIRE(!order_book.in_auction());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 200));
+  BOOST_REQUIRE(dc.verify_bid(1248, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1251, 1, 100));
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(2, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+
+  // Continuous matching resumes
+  SimpleOrder ask2(false, 1250, 100);
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&ask2, 100, 1250 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &ask2, true, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(5 + 1, order_book.uncross_updates_);
+}
+
+BOOST_AUTO_TEST_CASE(TestEndAuctionSkipsAon)
+{
+  UncrossOrderBook order_book;
+  SimpleOrder ask0(false, 1249, 200);
+  SimpleOrder bid1(true,  1250, 100);
+  SimpleOrder bid0(true,  1251, 300); // AON
+
+  order_book.begin_auction(1200, 1300);
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false, false,
+                               oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(verify_uncross(order_book.indicative_uncross(),
+                               1249, 100, 0, 100));
+
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 0, 0);
+    SimpleFillCheck fc1(&bid1, 100, 1249 * 100);
+    SimpleFillCheck fc2(&ask0, 100, 1249 * 100);
+    BOOST_REQUIRE(order_book.end_auction());
+    order_book.perform_callbacks();
+  ); }
+}
+
+BOOST_AUTO_TEST_CASE(TestEndAuctionPartlyHitIceberg)
+{
+  UncrossOrderBook order_book;
+  SimpleOrder ask0(false, 100, 100, 0, 50); // Iceberg
+  SimpleOrder ask1(false, 101, 10);
+  SimpleOrder bid0(true,  105, 10);
+  SimpleOrder bid1(true,  105, 10);
+
+  order_book.begin_auction(90, 110);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE_EQUAL(100, order_book.indicative_uncross().price);
+  BOOST_REQUIRE_EQUAL(20, order_book.indicative_uncross().matched_qty);
+
+  // The iceberg still shows quantity after the first bid, so both fill
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 10, 100 * 10);
+    SimpleFillCheck fc1(&bid1, 10, 100 * 10);
+    SimpleFillCheck fc2(&ask0, 20, 100 * 20);
+    SimpleFillCheck fc3(&ask1, 0, 0);
+    BOOST_REQUIRE(order_book.end_auction());
+    order_book.perform_callbacks();
+  ); }
+
+  // Verify the book is not left crossed
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_ask(100, 1, 30));
+  BOOST_REQUIRE(dc.verify_ask(101, 1, 10));
+}
+
+BOOST_AUTO_TEST_CASE(TestEndAuctionIcebergShowsSlice)
+{
+  UncrossOrderBook order_book;
+  SimpleOrder bid0(true,  100, 100, 0, 10); // Iceberg
+  SimpleOrder bid1(true,  100, 50);
+  SimpleOrder ask0(false, 100, 60);
+
+  order_book.begin_auction(90, 110);
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  // The iceberg fills its slice, then its refresh goes behind bid1
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 10, 100 * 10);
+    SimpleFillCheck fc1(&bid1, 50, 100 * 50);
+    SimpleFillCheck fc2(&ask0, 60, 100 * 60);
+    BOOST_REQUIRE(order_book.end_auction());
+    order_book.perform_callbacks();
+  ); }
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(100, 1, 10));
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+}
+
+} // namespace
@@ -0,0 +1,111 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_BacktestRunner
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+#include "impl/backtest_runner.h"
+#include <stdio.h>
+
+namespace liquibook {
+
+using impl::BacktestResult;
+using impl::BacktestRunner;
+using impl::EventFileReader;
+using impl::EventFileWriter;
+using impl::EventRecord;
+typedef impl::ReplayBacktest<SimpleOrderBook> SimpleReplayBacktest;
+
+const char* const EVENT_PATH = "ut_backtest_runner.lbev";
+
+// Write a day of crossing orders
+bool write_events()
+{
+  EventFileWriter writer;
+  bool written = writer.open(EVENT_PATH);
+  for (OrderId id = 1; written && id <= 200; id += 2) {
+    written = writer.write(impl::add_event(id, false, 1251, 100)) &&
+              writer.write(impl::add_event(id + 1, true, 1251, 60)) &&
+              writer.write(impl::cancel_event(id));
+  }
+  return writer.close() && written;
+}
+
+// Counts the jobs run, and trades only in even jobs
+class CountingBacktest : public SimpleReplayBacktest {
+public:
+  explicit CountingBacktest(uint32_t job_count)
+  : SimpleReplayBacktest(job_count),
+    prepared_(job_count, 0)
+  {
+  }
+
+  uint32_t prepared(uint32_t job) const { return prepared_[job]; }
+
+protected:
+  virtual void prepare(uint32_t job, SimpleOrderBook& order_book)
+  {
+    ++prepared_[job];
+    // Odd jobs replay the day as an auction, which never matches
+    if (job % 2) {
+      order_book.begin_auction(1200, 1300);
+    }
+  }
+
+private:
+  std::vector<uint32_t> prepared_;
+};
+
+BOOST_AUTO_TEST_CASE(TestRunJobs)
+{
+  BOOST_REQUIRE(write_events());
+  EventFileReader events;
+  BOOST_REQUIRE(events.open(EVENT_PATH));
+
+  // More jobs than workers, and not a multiple of them
+  const uint32_t job_count = 7;
+  CountingBacktest backtest(job_count);
+  BacktestRunner runner(3);
+  BOOST_REQUIRE_EQUAL(3, runner.worker_count());
+  BOOST_REQUIRE(runner.run(backtest, events, job_count));
+
+  for (uint32_t job = 0; job < job_count; ++job) {
+    BOOST_REQUIRE_EQUAL(1, backtest.prepared(job));
+    const BacktestResult& result = backtest.result(job);
+    BOOST_REQUIRE_EQUAL(300, result.events_applied);
+    BOOST_REQUIRE_EQUAL(200, result.orders_added);
+    BOOST_REQUIRE_EQUAL(job % 2 ? 0 : 6000, result.traded_qty);
+  }
+  BacktestResult total = backtest.total();
+  BOOST_REQUIRE_EQUAL(2100, total.events_applied);
+  BOOST_REQUIRE_EQUAL(4 * 6000, total.traded_qty);
+  events.close();
+  remove(EVENT_PATH);
+}
+
+BOOST_AUTO_TEST_CASE(TestSameResultAnyWorkers)
+{
+  BOOST_REQUIRE(write_events());
+  EventFileReader events;
+  BOOST_REQUIRE(events.open(EVENT_PATH));
+
+  SimpleReplayBacktest serial(4);
+  BOOST_REQUIRE(BacktestRunner(1).run(serial, events, 4));
+  SimpleReplayBacktest parallel(4);
+  BOOST_REQUIRE(BacktestRunner(4).run(parallel, events, 4));
+  // No workers means one
+  SimpleReplayBacktest none(4);
+  BOOST_REQUIRE(BacktestRunner(0).run(none, events, 4));
+
+  for (uint32_t job = 0; job < 4; ++job) {
+    BOOST_REQUIRE_EQUAL(serial.result(job).traded_qty,
+                        parallel.result(job).traded_qty);
+    BOOST_REQUIRE_EQUAL(serial.result(job).traded_qty,
+                        none.result(job).traded_qty);
+  }
+  events.close();
+  remove(EVENT_PATH);
+}
+
+} // namespace
@@ -0,0 +1,287 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_BookFork
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+#include "book/book_fork.h"
+
+namespace liquibook {
+
+using impl::SimpleOrder;
+typedef book::BookFork<SimpleOrder*> SimpleFork;
+typedef book::OrderBook<SimpleOrder*, book::ProRataMatch> ProRataOrderBook;
+typedef book::BookFork<SimpleOrder*, book::ProRataMatch> ProRataFork;
+
+BOOST_AUTO_TEST_CASE(TestForkLeavesParent)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder bid0(true, 1249, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+
+  SimpleFork fork(order_book);
+  BOOST_REQUIRE_EQUAL(1249, fork.best_bid());
+  BOOST_REQUIRE_EQUAL(1251, fork.best_ask());
+
+  // Sweep through the first ask into the second
+  SimpleOrder bid1(true, 1252, 150);
+  BOOST_REQUIRE(fork.add(&bid1));
+  BOOST_REQUIRE_EQUAL(2, fork.fills().size());
+  BOOST_REQUIRE(fork.fills()[0].resting_order == &ask0);
+  BOOST_REQUIRE_EQUAL(1251, fork.fills()[0].price);
+  BOOST_REQUIRE_EQUAL(100, fork.fills()[0].qty);
+  BOOST_REQUIRE(fork.fills()[1].resting_order == &ask1);
+  BOOST_REQUIRE_EQUAL(1252, fork.fills()[1].price);
+  BOOST_REQUIRE_EQUAL(50, fork.fills()[1].qty);
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&ask0));
+  BOOST_REQUIRE_EQUAL(50, fork.open_qty(&ask1));
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&bid1));
+  BOOST_REQUIRE_EQUAL(1252, fork.best_ask());
+
+  // The parent and its orders are as they were
+  BOOST_REQUIRE_EQUAL(100, ask0.open_qty());
+  BOOST_REQUIRE_EQUAL(0, ask0.filled_qty());
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(1251, order_book.depth().asks()->price());
+  BOOST_REQUIRE_EQUAL(100, order_book.depth().asks()->aggregate_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestForkCancel)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  SimpleFork fork(order_book);
+  BOOST_REQUIRE(fork.cancel(&ask0));
+  BOOST_REQUIRE(!fork.cancel(&ask0));
+  BOOST_REQUIRE_EQUAL(0, fork.best_ask());
+
+  // Nothing to match, so the bid rests in the fork
+  SimpleOrder bid0(true, 1251, 100);
+  BOOST_REQUIRE(!fork.add(&bid0));
+  BOOST_REQUIRE_EQUAL(1251, fork.best_bid());
+  BOOST_REQUIRE_EQUAL(100, fork.open_qty(&bid0));
+  BOOST_REQUIRE(fork.cancel(&bid0));
+  BOOST_REQUIRE_EQUAL(0, fork.best_bid());
+
+  BOOST_REQUIRE(order_book.find_resting(&ask0) != NULL);
+  BOOST_REQUIRE(order_book.find_resting(&bid0) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(TestForkOfFork)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  SimpleFork fork(order_book);
+  SimpleOrder bid0(true, 1251, 60);
+  BOOST_REQUIRE(fork.add(&bid0));
+
+  SimpleFork second_fork(fork);
+  SimpleOrder bid1(true, 1251, 60);
+  BOOST_REQUIRE(second_fork.add(&bid1));
+  BOOST_REQUIRE_EQUAL(0, second_fork.open_qty(&ask0));
+  BOOST_REQUIRE_EQUAL(20, second_fork.open_qty(&bid1));
+  BOOST_REQUIRE_EQUAL(1251, second_fork.best_bid());
+
+  // The first fork is as it was
+  BOOST_REQUIRE_EQUAL(40, fork.open_qty(&ask0));
+  BOOST_REQUIRE_EQUAL(1, fork.fills().size());
+  BOOST_REQUIRE_EQUAL(0, fork.best_bid());
+  BOOST_REQUIRE_EQUAL(100, ask0.open_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestForkOrdersAfterParent)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  SimpleFork fork(order_book);
+  // A better ask in the fork matches first, one at the same price last
+  SimpleOrder ask1(false, 1251, 100);
+  SimpleOrder ask2(false, 1250, 10);
+  BOOST_REQUIRE(!fork.add(&ask1));
+  BOOST_REQUIRE(!fork.add(&ask2));
+  BOOST_REQUIRE_EQUAL(1250, fork.best_ask());
+
+  SimpleOrder bid0(true, 1251, 150);
+  BOOST_REQUIRE(fork.add(&bid0));
+  BOOST_REQUIRE_EQUAL(3, fork.fills().size());
+  BOOST_REQUIRE(fork.fills()[0].resting_order == &ask2);
+  BOOST_REQUIRE(fork.fills()[1].resting_order == &ask0);
+  BOOST_REQUIRE(fork.fills()[2].resting_order == &ask1);
+  BOOST_REQUIRE_EQUAL(40, fork.fills()[2].qty);
+  BOOST_REQUIRE_EQUAL(60, fork.open_qty(&ask1));
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&ask2));
+}
+
+BOOST_AUTO_TEST_CASE(TestForkConditions)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1250, 200);
+  SimpleOrder ask1(false, 1251, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false, false,
+                               book::oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  SimpleFork fork(order_book);
+  // Too little for the all or none ask, so it is passed over
+  SimpleOrder bid0(true, 1251, 100);
+  BOOST_REQUIRE(fork.add(&bid0));
+  BOOST_REQUIRE_EQUAL(1, fork.fills().size());
+  BOOST_REQUIRE(fork.fills()[0].resting_order == &ask1);
+  BOOST_REQUIRE_EQUAL(200, fork.open_qty(&ask0));
+
+  // Too little to fill an all or none bid, which rests
+  SimpleOrder bid1(true, 1251, 300);
+  BOOST_REQUIRE(!fork.add(&bid1, book::oc_all_or_none));
+  BOOST_REQUIRE_EQUAL(300, fork.open_qty(&bid1));
+
+  // Immediate or cancel does not rest
+  SimpleOrder bid2(true, 1249, 100);
+  BOOST_REQUIRE(!fork.add(&bid2, book::oc_immediate_or_cancel));
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&bid2));
+
+  // A market order fills the all or none ask completely
+  SimpleOrder bid3(true, 0, 200);
+  BOOST_REQUIRE(fork.add(&bid3));
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&ask0));
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&bid3));
+  BOOST_REQUIRE_EQUAL(0, fork.best_ask());
+}
+
+BOOST_AUTO_TEST_CASE(TestForkProRata)
+{
+  ProRataOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder ask1(false, 1251, 300);
+  BOOST_REQUIRE(!order_book.add(&ask0));
+  BOOST_REQUIRE(!order_book.add(&ask1));
+
+  // The fork allocates across the level as its parent would
+  ProRataFork fork(order_book);
+  SimpleOrder bid0(true, 1251, 100);
+  BOOST_REQUIRE(fork.add(&bid0));
+  BOOST_REQUIRE_EQUAL(2, fork.fills().size());
+  BOOST_REQUIRE(fork.fills()[0].resting_order == &ask0);
+  BOOST_REQUIRE_EQUAL(25, fork.fills()[0].qty);
+  BOOST_REQUIRE(fork.fills()[1].resting_order == &ask1);
+  BOOST_REQUIRE_EQUAL(75, fork.fills()[1].qty);
+  BOOST_REQUIRE_EQUAL(75, fork.open_qty(&ask0));
+  BOOST_REQUIRE_EQUAL(225, fork.open_qty(&ask1));
+  BOOST_REQUIRE_EQUAL(100, ask0.open_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestForkSelfTrade)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100, 0, 0, 1);
+  SimpleOrder ask1(false, 1252, 100, 0, 0, 2);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // The inbound order of the same owner is cancelled, as in the parent
+  SimpleFork fork(order_book);
+  SimpleOrder bid0(true, 1252, 100, 0, 0, 1);
+  BOOST_REQUIRE(!fork.add(&bid0));
+  BOOST_REQUIRE(fork.fills().empty());
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&bid0));
+  BOOST_REQUIRE_EQUAL(100, fork.open_qty(&ask0));
+
+  // Cancelling the oldest makes way for the fill
+  order_book.set_self_trade_prevention(book::stp_cancel_oldest);
+  SimpleFork oldest_fork(order_book);
+  BOOST_REQUIRE(oldest_fork.add(&bid0));
+  BOOST_REQUIRE_EQUAL(1, oldest_fork.fills().size());
+  BOOST_REQUIRE(oldest_fork.fills()[0].resting_order == &ask1);
+  BOOST_REQUIRE_EQUAL(0, oldest_fork.open_qty(&ask0));
+  BOOST_REQUIRE_EQUAL(0, oldest_fork.open_qty(&bid0));
+  BOOST_REQUIRE_EQUAL(0, oldest_fork.best_ask());
+  BOOST_REQUIRE(order_book.find_resting(&ask0) != NULL);
+}
+
+BOOST_AUTO_TEST_CASE(TestForkPegsAndIcebergs)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid0(true, 1250, 100);
+  SimpleOrder bid1(true, 0, 100, 0, 0, 0, 0, book::peg_primary);
+  SimpleOrder ask0(false, 1252, 300, 0, 100);
+  SimpleOrder ask1(false, 1252, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // A sell reaches the pegged bid after the bid at its price
+  SimpleFork fork(order_book);
+  SimpleOrder ask2(false, 1250, 200);
+  BOOST_REQUIRE(fork.add(&ask2));
+  BOOST_REQUIRE_EQUAL(2, fork.fills().size());
+  BOOST_REQUIRE(fork.fills()[0].resting_order == &bid0);
+  BOOST_REQUIRE(fork.fills()[1].resting_order == &bid1);
+  BOOST_REQUIRE_EQUAL(1250, fork.fills()[1].price);
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&bid1));
+  BOOST_REQUIRE_EQUAL(100, order_book.find_resting(&bid1)->open_qty());
+
+  // The reserve of an iceberg goes behind the orders at its price
+  SimpleOrder bid2(true, 1252, 200);
+  BOOST_REQUIRE(fork.add(&bid2));
+  BOOST_REQUIRE_EQUAL(4, fork.fills().size());
+  BOOST_REQUIRE(fork.fills()[2].resting_order == &ask0);
+  BOOST_REQUIRE_EQUAL(100, fork.fills()[2].qty);
+  BOOST_REQUIRE(fork.fills()[3].resting_order == &ask1);
+  BOOST_REQUIRE_EQUAL(100, fork.fills()[3].qty);
+  BOOST_REQUIRE_EQUAL(200, fork.open_qty(&ask0));
+}
+
+BOOST_AUTO_TEST_CASE(TestForkTriggersStops)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid0(true, 1250, 100);
+  SimpleOrder bid1(true, 1249, 100);
+  SimpleOrder ask0(false, 1249, 100, 1250);
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE_EQUAL(1, order_book.stop_asks().size());
+
+  // The trade triggers the parent's stop, in the fork only
+  SimpleFork fork(order_book);
+  SimpleOrder ask1(false, 1250, 100);
+  BOOST_REQUIRE(fork.add(&ask1));
+  BOOST_REQUIRE_EQUAL(2, fork.fills().size());
+  BOOST_REQUIRE(fork.fills()[0].resting_order == &bid0);
+  BOOST_REQUIRE(fork.fills()[1].inbound_order == &ask0);
+  BOOST_REQUIRE(fork.fills()[1].resting_order == &bid1);
+  BOOST_REQUIRE_EQUAL(1249, fork.fills()[1].price);
+  BOOST_REQUIRE_EQUAL(0, fork.best_bid());
+  BOOST_REQUIRE_EQUAL(1, order_book.stop_asks().size());
+  BOOST_REQUIRE_EQUAL(100, order_book.find_resting(&bid1)->open_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestForkCrossesMarketOrder)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 0, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+
+  // A resting market order fills at the inbound order's price
+  SimpleFork fork(order_book);
+  SimpleOrder bid0(true, 1250, 100);
+  BOOST_REQUIRE(fork.add(&bid0));
+  BOOST_REQUIRE_EQUAL(1, fork.fills().size());
+  BOOST_REQUIRE(fork.fills()[0].resting_order == &ask0);
+  BOOST_REQUIRE_EQUAL(1250, fork.fills()[0].price);
+  BOOST_REQUIRE_EQUAL(0, fork.open_qty(&ask0));
+}
+
+} // namespace
@@ -0,0 +1,206 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_BookReplica
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+#include "impl/book_replica.h"
+#include <vector>
+#include <stdio.h>
+#ifndef _WIN32
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace liquibook {
+
+using impl::CommandRing;
+using impl::EventRecord;
+typedef impl::BookReplica<SimpleOrderBook> SimpleReplica;
+
+const char* const RING_PATH = "ut_book_replica.ring";
+
+// Crossing adds, with cancels and replaces of orders added before and not
+// yet filled, every one of which the book applies
+void make_commands(uint32_t count, std::vector<EventRecord>& commands)
+{
+  // Finds the orders filled by the commands so far
+  SimpleOrderBook order_book;
+  SimpleReplica replica(order_book);
+  std::vector<OrderId> live;
+  OrderId next_id = 1;
+  uint32_t random = 1;
+  while (commands.size() < count) {
+    random = random * 1103515245 + 12345;
+    const uint32_t action = (random >> 16) % 10;
+    if (live.size() < 50 || action < 6) {
+      const bool is_buy = (action % 2) == 0;
+      const Price price = 1245 + (random >> 20) % 10;
+      commands.push_back(impl::add_event(next_id, is_buy, price,
+                                         100 * (1 + action % 3)));
+      live.push_back(next_id++);
+    } else {
+      const size_t index = (random >> 8) % live.size();
+      const OrderId order_id = live[index];
+      // A filled order is done, and may have been freed
+      const impl::SimpleOrder* order = replica.find(order_id);
+      const bool filled = !order || order->state() == impl::os_complete;
+      if (filled || action < 8) {
+        live[index] = live.back();
+        live.pop_back();
+      }
+      if (filled) {
+        continue;
+      } else if (action < 8) {
+        commands.push_back(impl::cancel_event(order_id));
+      } else {
+        commands.push_back(impl::replace_event(order_id, 50, 0));
+      }
+    }
+    replica.apply(commands.back());
+  }
+}
+
+bool same_books(SimpleOrderBook& lhs, SimpleOrderBook& rhs)
+{
+  if (lhs.book_hash() != rhs.book_hash() ||
+      lhs.trans_id() != rhs.trans_id() ||
+      lhs.bids().size() != rhs.bids().size() ||
+      lhs.asks().size() != rhs.asks().size()) {
+    return false;
+  }
+  const DepthLevel* lhs_level = lhs.depth().bids();
+  const DepthLevel* rhs_level = rhs.depth().bids();
+  // Bids, then asks
+  for (int index = 0; index < 10; ++index, ++lhs_level, ++rhs_level) {
+    if (lhs_level->price() != rhs_level->price() ||
+        lhs_level->aggregate_qty() != rhs_level->aggregate_qty() ||
+        lhs_level->order_count() != rhs_level->order_count()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BOOST_AUTO_TEST_CASE(TestBackupFollowsPrimary)
+{
+  std::vector<EventRecord> commands;
+  make_commands(2000, commands);
+  CommandRing primary_ring, backup_ring;
+  BOOST_REQUIRE(primary_ring.create(RING_PATH, 50));
+  BOOST_REQUIRE_EQUAL(64, primary_ring.capacity());
+  BOOST_REQUIRE(backup_ring.open(RING_PATH));
+  BOOST_REQUIRE_EQUAL(64, backup_ring.capacity());
+
+  SimpleOrderBook primary_book, backup_book;
+  SimpleReplica primary(primary_book), backup(backup_book);
+  size_t next = 0;
+  while (next < commands.size()) {
+    // The primary runs ahead until the ring is full
+    while (next < commands.size() &&
+           primary.publish(commands[next], primary_ring)) {
+      ++next;
+    }
+    BOOST_REQUIRE(backup.follow(backup_ring));
+  }
+  BOOST_REQUIRE_EQUAL(2000, primary.sequence());
+  BOOST_REQUIRE_EQUAL(2000, backup.sequence());
+  BOOST_REQUIRE_EQUAL(2000, backup_ring.read_count());
+  BOOST_REQUIRE(!backup.diverged());
+  BOOST_REQUIRE(same_books(primary_book, backup_book));
+  BOOST_REQUIRE(primary_book.book_hash() != 0);
+  remove(RING_PATH);
+}
+
+BOOST_AUTO_TEST_CASE(TestBackupFindsDivergence)
+{
+  CommandRing ring;
+  BOOST_REQUIRE(ring.create(RING_PATH, 16));
+  SimpleOrderBook primary_book, backup_book;
+  SimpleReplica primary(primary_book), backup(backup_book);
+
+  BOOST_REQUIRE(primary.publish(impl::add_event(1, true, 1250, 100), ring));
+  BOOST_REQUIRE_EQUAL(1, backup.follow(ring));
+  BOOST_REQUIRE(!backup.diverged());
+
+  // An order the primary does not have
+  impl::SimpleOrder bid(true, 1249, 100);
+  BOOST_REQUIRE(add_and_verify(backup_book, &bid, false));
+  BOOST_REQUIRE(primary.publish(impl::add_event(2, false, 1251, 100), ring));
+  BOOST_REQUIRE_EQUAL(1, backup.follow(ring));
+  BOOST_REQUIRE(backup.diverged());
+  remove(RING_PATH);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(TestBackupTakesOverFromKilledPrimary)
+{
+  const uint32_t command_count = 20000;
+  std::vector<EventRecord> commands;
+  make_commands(command_count, commands);
+  CommandRing ring;
+  BOOST_REQUIRE(ring.create(RING_PATH, 256));
+
+  pid_t primary_pid = fork();
+  BOOST_REQUIRE(primary_pid >= 0);
+  if (primary_pid == 0) {
+    // The primary publishes every command, then waits to be killed
+    CommandRing primary_ring;
+    if (!primary_ring.open(RING_PATH)) {
+      _exit(1);
+    }
+    SimpleOrderBook primary_book;
+    SimpleReplica primary(primary_book);
+    for (size_t next = 0; next < commands.size(); ) {
+      if (primary.publish(commands[next], primary_ring)) {
+        ++next;
+      } else {
+        sched_yield();
+      }
+    }
+    for (;;) {
+      pause();
+    }
+  }
+
+  // Follow until half way, then kill the primary
+  SimpleOrderBook backup_book;
+  SimpleReplica backup(backup_book);
+  while (backup.sequence() < command_count / 2) {
+    if (!backup.follow(ring)) {
+      sched_yield();
+    }
+  }
+  BOOST_REQUIRE_EQUAL(0, kill(primary_pid, SIGKILL));
+  int status = 0;
+  BOOST_REQUIRE_EQUAL(primary_pid, waitpid(primary_pid, &status, 0));
+  BOOST_REQUIRE(WIFSIGNALED(status));
+
+  // Apply what the primary left in the ring
+  backup.follow(ring);
+  const uint64_t taken_over = backup.sequence();
+  BOOST_REQUIRE_EQUAL(ring.write_count(), taken_over);
+  BOOST_REQUIRE(!backup.diverged());
+
+  // The backup's book is the primary's, as rebuilt from the commands
+  SimpleOrderBook reference_book;
+  SimpleReplica reference(reference_book);
+  for (uint64_t next = 0; next < taken_over; ++next) {
+    BOOST_REQUIRE(reference.apply(commands[next]));
+  }
+  BOOST_REQUIRE(same_books(reference_book, backup_book));
+
+  // The backup carries on where the primary stopped
+  for (uint64_t next = taken_over; next < command_count; ++next) {
+    BOOST_REQUIRE(backup.apply(commands[next]));
+    BOOST_REQUIRE(reference.apply(commands[next]));
+  }
+  BOOST_REQUIRE(same_books(reference_book, backup_book));
+  remove(RING_PATH);
+}
+#endif
+
+} // namespace
@@ -0,0 +1,151 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_ConsolidatedDepth
+#include <boost/test/unit_test.hpp>
+#include "book/consolidated_depth.h"
+#include "changed_checker.h"
+#include <iostream>
+
+namespace liquibook {
+
+using book::Depth;
+using book::DepthLevel;
+typedef Depth<5> SizedDepth;
+typedef book::ConsolidatedDepth<5> SizedConsolidatedDepth;
+typedef test::ChangedChecker<5, SizedConsolidatedDepth> ChangedChecker;
+
+bool verify_level(const DepthLevel*& level,
+                  book::Price price,
+                  uint32_t order_count,
+                  book::Quantity aggregate_qty)
+{
+  bool matched = true;
+  if (price != level->price()) {
+    std::cout << "Level price " << level->price() << std::endl;
+    matched = false;
+  }
+  if (order_count != level->order_count()) {
+    std::cout << "Level order count " << level->order_count() << std::endl;
+    matched = false;
+  }
+  if (aggregate_qty != level->aggregate_qty()) {
+    std::cout << "Level aggregate qty " << level->aggregate_qty() << std::endl;
+    matched = false;
+  }
+  ++level;
+  return matched;
+}
+
+BOOST_AUTO_TEST_CASE(TestMergeVenues)
+{
+  SizedDepth venue0;
+  SizedDepth venue1;
+  venue0.add_order(1250, 100, true);
+  venue0.add_order(1252, 200, false);
+  venue1.add_order(1250, 300, true);
+  venue1.add_order(1249, 400, true);
+  venue1.add_order(1251, 500, false);
+
+  SizedConsolidatedDepth depth;
+  depth.add_venue(venue0);
+  depth.add_venue(venue1);
+  BOOST_REQUIRE_EQUAL(2, depth.venue_count());
+  BOOST_REQUIRE(depth.changed());
+
+  const DepthLevel* bid = depth.bids();
+  BOOST_REQUIRE(verify_level(bid, 1250, 2, 400));
+  BOOST_REQUIRE(verify_level(bid, 1249, 1, 400));
+  BOOST_REQUIRE(verify_level(bid, 0, 0, 0));
+  const DepthLevel* ask = depth.asks();
+  BOOST_REQUIRE(verify_level(ask, 1251, 1, 500));
+  BOOST_REQUIRE(verify_level(ask, 1252, 1, 200));
+  BOOST_REQUIRE(verify_level(ask, 0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestUpdateChangedLevels)
+{
+  SizedDepth venue0;
+  SizedDepth venue1;
+  venue0.add_order(1250, 100, true);
+  venue0.add_order(1248, 100, true);
+  venue1.add_order(1249, 300, true);
+
+  SizedConsolidatedDepth depth;
+  depth.add_venue(venue0);
+  depth.add_venue(venue1);
+  ChangedChecker cc(depth);
+  cc.reset();
+
+  // Nothing new
+  BOOST_REQUIRE(!depth.update());
+  BOOST_REQUIRE(cc.verify_bid_changed(0, 0, 0, 0, 0));
+
+  // A quantity change touches one merged level
+  venue1.change_qty_order(1249, 50, true);
+  BOOST_REQUIRE(depth.update());
+  BOOST_REQUIRE(cc.verify_bid_changed(0, 1, 0, 0, 0));
+  cc.reset();
+
+  // A new best level shifts the rest
+  venue1.add_order(1251, 200, true);
+  BOOST_REQUIRE(depth.update(1));
+  const DepthLevel* bid = depth.bids();
+  BOOST_REQUIRE(verify_level(bid, 1251, 1, 200));
+  BOOST_REQUIRE(verify_level(bid, 1250, 1, 100));
+  BOOST_REQUIRE(verify_level(bid, 1249, 1, 350));
+  BOOST_REQUIRE(verify_level(bid, 1248, 1, 100));
+  BOOST_REQUIRE(cc.verify_bid_changed(1, 1, 1, 1, 0));
+  cc.reset();
+
+  // Venue levels which shift, but merge to the same totals, change nothing
+  venue1.close_order(1249, 350, true);
+  venue0.add_order(1249, 350, true);
+  BOOST_REQUIRE(!depth.update());
+  BOOST_REQUIRE(cc.verify_bid_changed(0, 0, 0, 0, 0));
+
+  // Closing a level a venue shares leaves the other's orders
+  venue0.close_order(1250, 100, true);
+  BOOST_REQUIRE(depth.update());
+  bid = depth.bids();
+  BOOST_REQUIRE(verify_level(bid, 1251, 1, 200));
+  BOOST_REQUIRE(verify_level(bid, 1249, 1, 350));
+  BOOST_REQUIRE(verify_level(bid, 1248, 1, 100));
+  BOOST_REQUIRE(verify_level(bid, 0, 0, 0));
+  BOOST_REQUIRE(cc.verify_bid_changed(0, 1, 1, 1, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestVenueExcessLevels)
+{
+  SizedDepth venue0;
+  SizedDepth venue1;
+  // Venue 0 has more ask levels than its depth shows
+  for (book::Price price = 1251; price < 1258; ++price) {
+    venue0.add_order(price, 100, false);
+  }
+  venue1.add_order(1253, 50, false);
+
+  SizedConsolidatedDepth depth;
+  depth.add_venue(venue0);
+  depth.add_venue(venue1);
+  const DepthLevel* ask = depth.asks();
+  BOOST_REQUIRE(verify_level(ask, 1251, 1, 100));
+  BOOST_REQUIRE(verify_level(ask, 1252, 1, 100));
+  BOOST_REQUIRE(verify_level(ask, 1253, 2, 150));
+  BOOST_REQUIRE(verify_level(ask, 1254, 1, 100));
+  BOOST_REQUIRE(verify_level(ask, 1255, 1, 100));
+
+  // Levels restored from the venue's excess come into view
+  venue0.close_order(1251, 100, false);
+  venue0.close_order(1252, 100, false);
+  BOOST_REQUIRE(depth.update());
+  ask = depth.asks();
+  BOOST_REQUIRE(verify_level(ask, 1253, 2, 150));
+  BOOST_REQUIRE(verify_level(ask, 1254, 1, 100));
+  BOOST_REQUIRE(verify_level(ask, 1255, 1, 100));
+  BOOST_REQUIRE(verify_level(ask, 1256, 1, 100));
+  BOOST_REQUIRE(verify_level(ask, 1257, 1, 100));
+}
+
+} // namespace
@@ -207,6 +207,27 @@ BOOST_AUTO_TEST_CASE(TestCloseEraseBid)
   BOOST_REQUIRE(verify_level(bid, 1233, 1, 200));
 }
 
+BOOST_AUTO_TEST_CASE(TestCloseOrdersBid)
+{
+  SizedDepth depth;
+  ChangedChecker cc(depth);
+  depth.add_order(1235, 300, true);
+  depth.add_order(1235, 400, true);
+  depth.add_order(1235, 100, true);
+  depth.add_order(1234, 500, true);
+  depth.add_order(1234, 200, true);
+  cc.reset();
+  BOOST_REQUIRE(!depth.close_orders(1235, 2, 700, true)); // Does not erase
+  BOOST_REQUIRE(cc.verify_bid_changed(1, 0, 0, 0, 0)); cc.reset();
+  BOOST_REQUIRE(depth.close_orders(1235, 1, 100, true)); // Erase
+  BOOST_REQUIRE(cc.verify_bid_changed(1, 1, 0, 0, 0)); cc.reset();
+  const DepthLevel* bid = depth.bids();
+  BOOST_REQUIRE(verify_level(bid, 1234, 2, 700));
+  BOOST_REQUIRE(depth.close_orders(1234, 2, 700, true)); // Erase
+  bid = depth.bids();
+  BOOST_REQUIRE(verify_level(bid, 0, 0, 0));
+}
+
 BOOST_AUTO_TEST_CASE(TestAddCloseAddBid)
 {
   SizedDepth depth;
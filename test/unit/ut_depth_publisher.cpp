@@ -0,0 +1,195 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_DepthPublisher
+#include <boost/test/unit_test.hpp>
+#include "impl/depth_publisher.h"
+#include <stdio.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace liquibook {
+
+using book::DepthLevel;
+using book::ChangeId;
+using book::Price;
+using book::Quantity;
+typedef book::Depth<5> SizedDepth;
+typedef impl::DepthPublisher<5> SizedPublisher;
+typedef impl::DepthReader<5> SizedReader;
+
+const char* const REGION_PATH = "ut_depth_publisher.depth";
+
+BOOST_AUTO_TEST_CASE(TestPublishAndRead)
+{
+  SizedPublisher publisher;
+  BOOST_REQUIRE(publisher.create(REGION_PATH, 3));
+  publisher.set_symbol(0, "AAA");
+  publisher.set_symbol(1, "BBB");
+
+  SizedReader reader;
+  BOOST_REQUIRE(reader.open(REGION_PATH));
+  BOOST_REQUIRE_EQUAL(3, reader.book_count());
+  uint32_t book = 0;
+  BOOST_REQUIRE(reader.find("BBB", book));
+  BOOST_REQUIRE_EQUAL(1, book);
+  BOOST_REQUIRE(!reader.find("CCC", book));
+
+  // Nothing to read until published
+  DepthLevel levels[10];
+  ChangeId last_change = 0;
+  BOOST_REQUIRE(!reader.read(1, levels, last_change));
+
+  SizedDepth depth;
+  depth.add_order(1250, 100, true);
+  depth.add_order(1249, 200, true);
+  depth.add_order(1251, 300, false);
+  BOOST_REQUIRE(publisher.publish(1, depth));
+  // Unchanged, so not written again
+  BOOST_REQUIRE(!publisher.publish(1, depth));
+
+  BOOST_REQUIRE(reader.read(1, levels, last_change));
+  BOOST_REQUIRE_EQUAL(depth.last_change(), last_change);
+  BOOST_REQUIRE_EQUAL(1250, levels[0].price());
+  BOOST_REQUIRE_EQUAL(100, levels[0].aggregate_qty());
+  BOOST_REQUIRE_EQUAL(1249, levels[1].price());
+  BOOST_REQUIRE_EQUAL(0, levels[2].price());
+  BOOST_REQUIRE_EQUAL(1251, levels[5].price());
+  BOOST_REQUIRE_EQUAL(300, levels[5].aggregate_qty());
+  BOOST_REQUIRE(!reader.read(0, levels, last_change));
+
+  // Read in place
+  depth.close_order(1250, 100, true);
+  BOOST_REQUIRE(publisher.publish(1, depth));
+  uint32_t sequence = 0;
+  BOOST_REQUIRE(reader.begin_read(1, sequence));
+  const Quantity best_bid_qty = reader.levels(1)->aggregate_qty();
+  BOOST_REQUIRE(reader.end_read(1, sequence));
+  BOOST_REQUIRE_EQUAL(200, best_bid_qty);
+
+  // A read overlapped by a write is seen
+  uint32_t overlapped = 0;
+  BOOST_REQUIRE(reader.begin_read(1, overlapped));
+  depth.add_order(1252, 100, false);
+  BOOST_REQUIRE(publisher.publish(1, depth));
+  BOOST_REQUIRE(!reader.end_read(1, overlapped));
+
+  // Readers of another depth size are refused
+  impl::DepthReader<3> small_reader;
+  BOOST_REQUIRE(!small_reader.open(REGION_PATH));
+  remove(REGION_PATH);
+}
+
+BOOST_AUTO_TEST_CASE(TestSequenceWraps)
+{
+  SizedPublisher publisher;
+  BOOST_REQUIRE(publisher.create(REGION_PATH, 1));
+  SizedReader reader;
+  BOOST_REQUIRE(reader.open(REGION_PATH));
+  SizedDepth depth;
+  depth.add_order(1250, 100, true);
+  BOOST_REQUIRE(publisher.publish(0, depth));
+
+  // Bring the sequence to the last even value before it wraps
+  impl::DepthRegion region;
+  BOOST_REQUIRE(region.open(REGION_PATH, 5));
+  region.slot(0)->sequence = 0xFFFFFFFE;
+  depth.add_order(1250, 50, true);
+  BOOST_REQUIRE(publisher.publish(0, depth));
+  BOOST_REQUIRE_EQUAL(0, region.slot(0)->sequence);
+
+  // Still published, so read, and not written again while unchanged
+  DepthLevel levels[10];
+  ChangeId last_change = 0;
+  BOOST_REQUIRE(reader.read(0, levels, last_change));
+  BOOST_REQUIRE_EQUAL(150, levels[0].aggregate_qty());
+  uint32_t sequence = 1;
+  BOOST_REQUIRE(reader.begin_read(0, sequence));
+  BOOST_REQUIRE_EQUAL(0, sequence);
+  BOOST_REQUIRE(reader.end_read(0, sequence));
+  BOOST_REQUIRE(!publisher.publish(0, depth));
+  remove(REGION_PATH);
+}
+
+BOOST_AUTO_TEST_CASE(TestLongSymbolIsCut)
+{
+  SizedPublisher publisher;
+  BOOST_REQUIRE(publisher.create(REGION_PATH, 2));
+  publisher.set_symbol(0, "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+  publisher.set_symbol(1, "SHORT");
+  SizedReader reader;
+  BOOST_REQUIRE(reader.open(REGION_PATH));
+  uint32_t book = 1;
+  BOOST_REQUIRE(reader.find("ABCDEFGHIJKLMNOPQRSTUVW", book));
+  BOOST_REQUIRE_EQUAL(0, book);
+  BOOST_REQUIRE(reader.find("SHORT", book));
+  BOOST_REQUIRE_EQUAL(1, book);
+  remove(REGION_PATH);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(TestReadsAreConsistent)
+{
+  const Quantity round_count = 100000;
+  SizedPublisher publisher;
+  BOOST_REQUIRE(publisher.create(REGION_PATH, 1));
+
+  pid_t publisher_pid = fork();
+  BOOST_REQUIRE(publisher_pid >= 0);
+  if (publisher_pid == 0) {
+    // Each round adds an order of 1 to every level, then publishes
+    SizedDepth depth;
+    for (Quantity round = 1; round <= round_count; ++round) {
+      for (Price price = 1; price <= 5; ++price) {
+        depth.add_order(1250 - price, 1, true);
+        depth.add_order(1250 + price, 1, false);
+      }
+      publisher.publish(0, depth);
+    }
+    _exit(0);
+  }
+
+  // Every read sees one round, whole
+  SizedReader reader;
+  BOOST_REQUIRE(reader.open(REGION_PATH));
+  DepthLevel levels[10];
+  ChangeId last_change = 0;
+  Quantity last_round = 0;
+  uint32_t read_count = 0;
+  int status = 0;
+  bool exited = false;
+  while (last_round < round_count) {
+    // Once the publisher is gone, its last round must be there to read
+    if (!exited) {
+      exited = waitpid(publisher_pid, &status, WNOHANG) == publisher_pid;
+    } else {
+      BOOST_REQUIRE(WIFEXITED(status));
+      BOOST_REQUIRE(reader.read(0, levels, last_change));
+      BOOST_REQUIRE_EQUAL(round_count, levels[0].aggregate_qty());
+    }
+    if (!reader.read(0, levels, last_change)) {
+      continue;
+    }
+    ++read_count;
+    const Quantity round = levels[0].aggregate_qty();
+    BOOST_REQUIRE(round >= last_round);
+    for (int index = 0; index < 10; ++index) {
+      BOOST_REQUIRE_EQUAL(round, levels[index].aggregate_qty());
+      BOOST_REQUIRE_EQUAL(round, levels[index].order_count());
+    }
+    last_round = round;
+  }
+  if (!exited) {
+    BOOST_REQUIRE_EQUAL(publisher_pid, waitpid(publisher_pid, &status, 0));
+  }
+  BOOST_REQUIRE(WIFEXITED(status));
+  BOOST_REQUIRE(read_count > 0);
+  remove(REGION_PATH);
+}
+#endif
+
+} // namespace
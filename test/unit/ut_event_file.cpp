@@ -0,0 +1,177 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_EventFile
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+#include "impl/event_file.h"
+#include "impl/event_replay.h"
+#include <stdio.h>
+
+namespace liquibook {
+
+using impl::EventFileReader;
+using impl::EventFileWriter;
+using impl::EventRecord;
+using impl::SimpleOrder;
+typedef impl::EventReplay<SimpleOrderBook> SimpleEventReplay;
+
+const char* const EVENT_PATH = "ut_event_file.lbev";
+const char* const CSV_PATH = "ut_event_file.csv";
+
+BOOST_AUTO_TEST_CASE(TestWriteAndMap)
+{
+  EventFileWriter writer;
+  BOOST_REQUIRE(writer.open(EVENT_PATH));
+  BOOST_REQUIRE(writer.write(impl::add_event(11, true, 1250, 100)));
+  BOOST_REQUIRE(writer.write(impl::add_event(12, false, 1251, 200,
+                                             oc_all_or_none)));
+  BOOST_REQUIRE(writer.write(impl::replace_event(11, -50, 1249)));
+  BOOST_REQUIRE(writer.write(impl::cancel_event(12)));
+  BOOST_REQUIRE_EQUAL(4, writer.record_count());
+  BOOST_REQUIRE(writer.close());
+
+  EventFileReader reader;
+  BOOST_REQUIRE(reader.open(EVENT_PATH));
+  BOOST_REQUIRE_EQUAL(4, reader.record_count());
+  BOOST_REQUIRE_EQUAL(2, reader.add_count());
+  BOOST_REQUIRE_EQUAL(4, reader.end() - reader.begin());
+
+  const EventRecord* event = reader.begin();
+  BOOST_REQUIRE_EQUAL(impl::et_add, event->type);
+  BOOST_REQUIRE_EQUAL(11, event->order_id);
+  BOOST_REQUIRE_EQUAL(1, event->is_buy);
+  BOOST_REQUIRE_EQUAL(1250, event->price);
+  BOOST_REQUIRE_EQUAL(100, event->qty);
+  ++event;
+  BOOST_REQUIRE_EQUAL(0, event->is_buy);
+  BOOST_REQUIRE_EQUAL(oc_all_or_none, event->conditions);
+  ++event;
+  BOOST_REQUIRE_EQUAL(impl::et_replace, event->type);
+  BOOST_REQUIRE_EQUAL(-50, event->size_delta);
+  BOOST_REQUIRE_EQUAL(1249, event->price);
+  ++event;
+  BOOST_REQUIRE_EQUAL(impl::et_cancel, event->type);
+  BOOST_REQUIRE_EQUAL(12, event->order_id);
+  reader.close();
+  BOOST_REQUIRE_EQUAL(0, reader.record_count());
+  remove(EVENT_PATH);
+}
+
+BOOST_AUTO_TEST_CASE(TestMapNotEventFile)
+{
+  FILE* file = fopen(EVENT_PATH, "w");
+  BOOST_REQUIRE(file);
+  fputs("A,1,B,1250,100\nA,2,S,1251,100\nA,3,S,1251,100\n", file);
+  fclose(file);
+  EventFileReader reader;
+  BOOST_REQUIRE(!reader.open(EVENT_PATH));
+  BOOST_REQUIRE(reader.begin() == reader.end());
+  remove(EVENT_PATH);
+  BOOST_REQUIRE(!reader.open(EVENT_PATH));
+}
+
+BOOST_AUTO_TEST_CASE(TestParseCsv)
+{
+  EventRecord record;
+  BOOST_REQUIRE(impl::parse_csv_event("A,7,S,1251,300,1\n", record));
+  BOOST_REQUIRE_EQUAL(impl::et_add, record.type);
+  BOOST_REQUIRE_EQUAL(7, record.order_id);
+  BOOST_REQUIRE_EQUAL(0, record.is_buy);
+  BOOST_REQUIRE_EQUAL(1251, record.price);
+  BOOST_REQUIRE_EQUAL(300, record.qty);
+  BOOST_REQUIRE_EQUAL(oc_all_or_none, record.conditions);
+  BOOST_REQUIRE(impl::parse_csv_event("R,7,-100,0\r\n", record));
+  BOOST_REQUIRE_EQUAL(impl::et_replace, record.type);
+  BOOST_REQUIRE_EQUAL(-100, record.size_delta);
+  BOOST_REQUIRE_EQUAL(PRICE_UNCHANGED, record.price);
+  BOOST_REQUIRE(impl::parse_csv_event("C,7", record));
+  BOOST_REQUIRE_EQUAL(impl::et_cancel, record.type);
+
+  BOOST_REQUIRE(!impl::parse_csv_event("A,7,X,1251,300", record));
+  BOOST_REQUIRE(!impl::parse_csv_event("A,7,B,1251", record));
+  BOOST_REQUIRE(!impl::parse_csv_event("C,7,8", record));
+  BOOST_REQUIRE(!impl::parse_csv_event("X,7", record));
+  BOOST_REQUIRE(!impl::parse_csv_event("", record));
+}
+
+BOOST_AUTO_TEST_CASE(TestConvertAndReplay)
+{
+  FILE* csv = fopen(CSV_PATH, "w");
+  BOOST_REQUIRE(csv);
+  fputs("# id, side, price, qty\n"
+        "A,1,S,1252,100\n"
+        "A,2,S,1251,200\n"
+        "\n"
+        "A,3,B,1250,300\n"
+        "R,3,0,1251\n"
+        "C,1\n"
+        "C,99\n", csv);
+  fclose(csv);
+  uint32_t bad_line = 0;
+  BOOST_REQUIRE(impl::convert_csv_events(CSV_PATH, EVENT_PATH, bad_line));
+  BOOST_REQUIRE_EQUAL(0, bad_line);
+
+  EventFileReader reader;
+  BOOST_REQUIRE(reader.open(EVENT_PATH));
+  BOOST_REQUIRE_EQUAL(6, reader.record_count());
+
+  SimpleOrderBook order_book;
+  SimpleEventReplay replay(order_book);
+  // The cancel of an unknown order is skipped
+  BOOST_REQUIRE_EQUAL(5, replay.replay(reader.begin(), reader.end()));
+
+  // The replace crossed the spread
+  SimpleOrder* ask1 = replay.find(1);
+  SimpleOrder* ask2 = replay.find(2);
+  SimpleOrder* bid3 = replay.find(3);
+  BOOST_REQUIRE(ask1 && ask2 && bid3);
+  BOOST_REQUIRE(!replay.find(99));
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask1->state());
+  BOOST_REQUIRE_EQUAL(impl::os_complete, ask2->state());
+  BOOST_REQUIRE_EQUAL(100, bid3->open_qty());
+  BOOST_REQUIRE(verify_depth(order_book.depth().bids()[0], 1251, 1, 100));
+  BOOST_REQUIRE(order_book.asks().empty());
+  reader.close();
+
+  // A line not understood stops the conversion
+  csv = fopen(CSV_PATH, "w");
+  BOOST_REQUIRE(csv);
+  fputs("A,1,S,1252,100\nA,2,S\n", csv);
+  fclose(csv);
+  BOOST_REQUIRE(!impl::convert_csv_events(CSV_PATH, EVENT_PATH, bad_line));
+  BOOST_REQUIRE_EQUAL(2, bad_line);
+  remove(CSV_PATH);
+  remove(EVENT_PATH);
+}
+
+BOOST_AUTO_TEST_CASE(TestReplayFreesDoneOrders)
+{
+  // Pairs of orders which fill each other, then one which rests
+  std::vector<EventRecord> events;
+  for (OrderId order_id = 1; order_id <= 20000; order_id += 2) {
+    events.push_back(impl::add_event(order_id, false, 1251, 100));
+    events.push_back(impl::add_event(order_id + 1, true, 1251, 100));
+  }
+  events.push_back(impl::add_event(30000, true, 1250, 100));
+
+  SimpleOrderBook order_book;
+  SimpleEventReplay replay(order_book);
+  BOOST_REQUIRE_EQUAL(20001, replay.replay(&events[0], 
+                                           &events[0] + events.size()));
+  BOOST_REQUIRE_EQUAL(20001, replay.order_count());
+  BOOST_REQUIRE_EQUAL(10000 * 100, replay.traded_qty());
+  // The filled orders are freed as the replay goes
+  BOOST_REQUIRE(replay.held_count() <= 1024);
+  BOOST_REQUIRE(!replay.find(1));
+  BOOST_REQUIRE_EQUAL(100, replay.find(30000)->open_qty());
+
+  // A freed ID may be added again
+  EventRecord again = impl::add_event(1, false, 1250, 40);
+  BOOST_REQUIRE_EQUAL(1, replay.replay(&again, &again + 1));
+  BOOST_REQUIRE_EQUAL(40, replay.find(1)->filled_qty());
+  BOOST_REQUIRE_EQUAL(60, replay.find(30000)->open_qty());
+}
+
+} // namespace
@@ -0,0 +1,219 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_Expiry
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+#include "book/timer_wheel.h"
+
+namespace liquibook {
+
+using impl::SimpleOrder;
+using book::TimerWheel;
+using book::TimerId;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+
+BOOST_AUTO_TEST_CASE(TestTimerWheelLevels)
+{
+  TimerWheel<int> wheel;
+  std::vector<int> expired;
+  // One entry at each of the lowest five levels
+  wheel.schedule(10, 0);
+  wheel.schedule(1000, 1);
+  wheel.schedule(100000, 2);
+  wheel.schedule(10000000, 3);
+  wheel.schedule(5000000000ULL, 4);
+  BOOST_REQUIRE_EQUAL(5, wheel.size());
+
+  wheel.advance(9, expired);
+  BOOST_REQUIRE_EQUAL(0, expired.size());
+  wheel.advance(999, expired);
+  BOOST_REQUIRE_EQUAL(1, expired.size());
+  BOOST_REQUIRE_EQUAL(0, expired[0]);
+  wheel.advance(1000, expired);
+  BOOST_REQUIRE_EQUAL(2, expired.size());
+  BOOST_REQUIRE_EQUAL(1, expired[1]);
+  wheel.advance(99999, expired);
+  BOOST_REQUIRE_EQUAL(2, expired.size());
+  wheel.advance(9999999, expired);
+  BOOST_REQUIRE_EQUAL(3, expired.size());
+  BOOST_REQUIRE_EQUAL(2, expired[2]);
+  wheel.advance(4999999999ULL, expired);
+  BOOST_REQUIRE_EQUAL(4, expired.size());
+  BOOST_REQUIRE_EQUAL(3, expired[3]);
+  wheel.advance(5000000000ULL, expired);
+  BOOST_REQUIRE_EQUAL(5, expired.size());
+  BOOST_REQUIRE_EQUAL(4, expired[4]);
+  BOOST_REQUIRE_EQUAL(0, wheel.size());
+}
+
+BOOST_AUTO_TEST_CASE(TestTimerWheelFarExpiry)
+{
+  // Times in nanoseconds, as far out as a Timestamp reaches
+  TimerWheel<int> wheel;
+  std::vector<int> expired;
+  const Timestamp start = 1700000000000000000ULL;
+  const Timestamp last = 0xFFFFFFFFFFFFFFFFULL;
+  wheel.advance(start, expired);
+  wheel.schedule(start + 86400000000000ULL, 0);
+  wheel.schedule(last - 1, 1);
+  wheel.schedule(last, 2);
+
+  // Step through many times the range of the lower levels
+  for (Timestamp now = start; now < start + 86400000000000ULL; 
+       now += 1000000000ULL) {
+    wheel.advance(now, expired);
+  }
+  BOOST_REQUIRE_EQUAL(0, expired.size());
+  wheel.advance(start + 86400000000000ULL, expired);
+  BOOST_REQUIRE_EQUAL(1, expired.size());
+  BOOST_REQUIRE_EQUAL(0, expired[0]);
+  wheel.advance(last - 2, expired);
+  BOOST_REQUIRE_EQUAL(1, expired.size());
+  wheel.advance(last - 1, expired);
+  BOOST_REQUIRE_EQUAL(2, expired.size());
+  BOOST_REQUIRE_EQUAL(1, expired[1]);
+  wheel.advance(last, expired);
+  BOOST_REQUIRE_EQUAL(3, expired.size());
+  BOOST_REQUIRE_EQUAL(2, expired[2]);
+  BOOST_REQUIRE_EQUAL(0, wheel.size());
+}
+
+BOOST_AUTO_TEST_CASE(TestTimerWheelCancel)
+{
+  TimerWheel<int> wheel;
+  std::vector<int> expired;
+  TimerId timer0 = wheel.schedule(100, 0);
+  wheel.schedule(100, 1);
+  TimerId timer2 = wheel.schedule(70000, 2);
+  wheel.cancel(timer0);
+  wheel.cancel(timer0); // No effect
+  BOOST_REQUIRE_EQUAL(2, wheel.size());
+
+  // Cancel after the entry has moved down a level
+  wheel.advance(65536, expired);
+  wheel.cancel(timer2);
+  wheel.advance(100000, expired);
+  BOOST_REQUIRE_EQUAL(1, expired.size());
+  BOOST_REQUIRE_EQUAL(1, expired[0]);
+  BOOST_REQUIRE_EQUAL(0, wheel.size());
+}
+
+BOOST_AUTO_TEST_CASE(TestTimerWheelStep)
+{
+  // Advance a tick at a time across slot and level boundaries
+  TimerWheel<int> wheel;
+  std::vector<int> expired;
+  for (int entry = 0; entry < 5000; entry += 7) {
+    wheel.schedule(entry + 1, entry);
+  }
+  for (Timestamp now = 1; now <= 5000; ++now) {
+    size_t before = expired.size();
+    wheel.advance(now, expired);
+    if ((now - 1) % 7 == 0) {
+      BOOST_REQUIRE_EQUAL(before + 1, expired.size());
+      BOOST_REQUIRE_EQUAL(int(now - 1), expired.back());
+    } else {
+      BOOST_REQUIRE_EQUAL(before, expired.size());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestExpireRestingOrders)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1252, 100, 0, 0, 0, 2000);
+  SimpleOrder ask0(false, 1251, 100, 0, 0, 0, 1000);
+  SimpleOrder bid1(true,  1250, 100, 0, 0, 0, 1000);
+  SimpleOrder bid0(true,  1250, 200);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+
+  // Nothing is due yet
+  BOOST_REQUIRE_EQUAL(0, order_book.advance_time(999));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(999, order_book.current_time());
+
+  // Expire ask0 and bid1
+  BOOST_REQUIRE_EQUAL(2, order_book.advance_time(1500));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid1.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, ask1.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, bid0.state());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 200));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+
+  // Expire ask1
+  BOOST_REQUIRE_EQUAL(1, order_book.advance_time(2000));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask1.state());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestFilledOrderDoesNotExpire)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1251, 100, 0, 0, 0, 1000);
+  SimpleOrder ask0(false, 1251, 100, 0, 0, 0, 1000);
+  SimpleOrder bid0(true,  1251, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1251 * 100);
+    SimpleFillCheck fc1(&ask0, 100, 1251 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+
+  // Only the resting order expires
+  BOOST_REQUIRE_EQUAL(1, order_book.advance_time(1000));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_complete, ask0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask1.state());
+}
+
+BOOST_AUTO_TEST_CASE(TestExpireStopAndIceberg)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid1(true,  1250, 100, 1260, 0, 0, 500); // Stop
+  SimpleOrder bid0(true,  1250, 500, 0, 100, 0, 500);  // Iceberg
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE_EQUAL(1, order_book.stop_bids().size());
+
+  BOOST_REQUIRE_EQUAL(2, order_book.advance_time(500));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid1.state());
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.stop_bids().size());
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestRejectExpired)
+{
+  SimpleOrderBook order_book;
+  order_book.advance_time(1000);
+  SimpleOrder bid0(true, 1250, 100, 0, 0, 0, 1000);
+
+  BOOST_REQUIRE(!order_book.add(&bid0));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_new, bid0.state());
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+}
+
+} // namespace
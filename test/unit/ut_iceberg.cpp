@@ -0,0 +1,157 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_Iceberg
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+
+namespace liquibook {
+
+using impl::SimpleOrder;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+
+BOOST_AUTO_TEST_CASE(TestIcebergRests)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1250, 1000, 0, 100); // Iceberg
+  SimpleOrder bid0(true,  1249, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+
+  // Verify depth shows only the display quantity
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1249, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 100));
+  BOOST_REQUIRE_EQUAL(100, ask0.visible_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestIcebergRefresh)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1250, 100);
+  SimpleOrder ask0(false, 1250, 300, 0, 100); // Iceberg
+  SimpleOrder bid0(true,  1250, 150);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_ask(1250, 2, 200));
+
+  // Match - the displayed slice trades, the refreshed slice goes behind ask1
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 150, 1250 * 150);
+    SimpleFillCheck fc1(&ask0, 100, 1250 * 100);
+    SimpleFillCheck fc2(&ask1, 50, 1250 * 50);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+
+  // Verify depth
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_ask(1250, 2, 150));
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+
+  // Match - ask1 first, then the iceberg through a second refresh
+  SimpleOrder bid1(true,  1250, 200);
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid1, 200, 1250 * 200);
+    SimpleFillCheck fc1(&ask0, 150, 1250 * 150);
+    SimpleFillCheck fc2(&ask1, 50, 1250 * 50);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid1, true, true));
+  ); }
+
+  // Verify depth
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 50));
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(50, ask0.open_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestIcebergInbound)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1251, 100);
+  SimpleOrder ask0(false, 1250, 150);
+  SimpleOrder bid0(true,  1251, 500, 0, 100); // Iceberg
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Match - inbound iceberg trades beyond its display quantity
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 250, 1250 * 150 + 1251 * 100);
+    SimpleFillCheck fc1(&ask0, 150, 1250 * 150);
+    SimpleFillCheck fc2(&ask1, 100, 1251 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true));
+  ); }
+
+  // Verify depth shows one slice of the remainder
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1251, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+  BOOST_REQUIRE_EQUAL(250, bid0.open_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestCancelIceberg)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid1(true,  1250, 100);
+  SimpleOrder bid0(true,  1250, 400, 0, 100); // Iceberg
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 2, 200));
+
+  BOOST_REQUIRE(cancel_and_verify(order_book, &bid0, impl::os_cancelled));
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestReplaceIceberg)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1250, 300, 0, 100); // Iceberg
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  // Increase goes to the reserve
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask0, 200));
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 100));
+
+  // Decrease comes from the reserve first
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask0, -400));
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 100));
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask0, -40));
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 60));
+
+  // Reprice moves the displayed quantity
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask0, 0, 1251));
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_ask(1251, 1, 60));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestIcebergAonRejected)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid0(true,  1250, 400, 0, 100); // Iceberg
+
+  BOOST_REQUIRE(!order_book.add(&bid0, oc_all_or_none));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_new, bid0.state());
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+}
+
+} // namespace
@@ -0,0 +1,149 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_LatencySimulator
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+#include "impl/latency_simulator.h"
+#include <vector>
+
+namespace liquibook {
+
+using impl::EventRecord;
+using impl::MarketDataListener;
+using impl::TimedEvent;
+typedef impl::LatencySimulator<SimpleOrderBook> SimpleSimulator;
+
+TimedEvent timed(book::Timestamp time, const EventRecord& event)
+{
+  TimedEvent timed_event;
+  timed_event.time = time;
+  timed_event.event = event;
+  return timed_event;
+}
+
+// Lifts every sell order it hears of, and notes when it heard
+class LiftingStrategy : public MarketDataListener {
+public:
+  explicit LiftingStrategy(SimpleSimulator& simulator)
+  : simulator_(simulator)
+  {
+  }
+
+  virtual void on_market_data(uint32_t book, const EventRecord& event)
+  {
+    heard_.push_back(simulator_.now());
+    if (event.type == impl::et_add && !event.is_buy) {
+      simulator_.submit(book, impl::add_event(event.order_id + 1000, true,
+                                              event.price, event.qty));
+    }
+  }
+
+  const std::vector<book::Timestamp>& heard() const { return heard_; }
+
+private:
+  SimpleSimulator& simulator_;
+  std::vector<book::Timestamp> heard_;
+};
+
+// An ask at 0 which is cancelled at 12
+const TimedEvent FEED[] = {
+  timed(0, impl::add_event(1, false, 1251, 100)),
+  timed(12, impl::cancel_event(1))
+};
+const TimedEvent* const FEED_END = FEED + sizeof(FEED) / sizeof(FEED[0]);
+
+BOOST_AUTO_TEST_CASE(TestOrderBeatsCancel)
+{
+  SimpleOrderBook order_book;
+  // Heard at 5, reaches the book at 10
+  SimpleSimulator simulator(5, 5);
+  LiftingStrategy strategy(simulator);
+  simulator.set_market_data_listener(&strategy);
+  uint32_t book = simulator.add_book(order_book);
+  simulator.add_feed(book, FEED, FEED_END);
+  BOOST_REQUIRE_EQUAL(1, simulator.pending());
+
+  simulator.run();
+  BOOST_REQUIRE_EQUAL(0, simulator.pending());
+  // The cancel arrives after the fill, so is skipped
+  BOOST_REQUIRE_EQUAL(2, simulator.events_applied());
+  BOOST_REQUIRE_EQUAL(15, simulator.now());
+  BOOST_REQUIRE_EQUAL(100, simulator.find_order(book, 1001)->filled_qty());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(2, strategy.heard().size());
+  BOOST_REQUIRE_EQUAL(5, strategy.heard()[0]);
+  BOOST_REQUIRE_EQUAL(15, strategy.heard()[1]);
+}
+
+BOOST_AUTO_TEST_CASE(TestCancelBeatsOrder)
+{
+  SimpleOrderBook order_book;
+  // Heard at 5, reaches the book at 15
+  SimpleSimulator simulator(10, 5);
+  LiftingStrategy strategy(simulator);
+  simulator.set_market_data_listener(&strategy);
+  uint32_t book = simulator.add_book(order_book);
+  simulator.add_feed(book, FEED, FEED_END);
+
+  // Before the order arrives
+  BOOST_REQUIRE_EQUAL(3, simulator.run_until(12));
+  BOOST_REQUIRE_EQUAL(12, simulator.now());
+  BOOST_REQUIRE(simulator.find_order(book, 1001) == NULL);
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+
+  simulator.run();
+  BOOST_REQUIRE_EQUAL(20, simulator.now());
+  impl::SimpleOrder* order = simulator.find_order(book, 1001);
+  BOOST_REQUIRE_EQUAL(0, order->filled_qty());
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(5, strategy.heard()[0]);
+  BOOST_REQUIRE_EQUAL(17, strategy.heard()[1]);
+  BOOST_REQUIRE_EQUAL(20, strategy.heard()[2]);
+}
+
+BOOST_AUTO_TEST_CASE(TestSameTimeInScheduleOrder)
+{
+  SimpleOrderBook order_book;
+  SimpleSimulator simulator(0, 0);
+  uint32_t book = simulator.add_book(order_book);
+  // Both bids reach the book at once, the first scheduled first in queue
+  simulator.schedule(7, book, impl::add_event(2, true, 1250, 100));
+  simulator.schedule(7, book, impl::add_event(3, true, 1250, 100));
+  simulator.schedule(9, book, impl::add_event(4, false, 1250, 100));
+  // Scheduled in the past, so it runs first
+  simulator.run_until(3);
+  simulator.schedule(1, book, impl::add_event(1, true, 1249, 100));
+  BOOST_REQUIRE_EQUAL(4, simulator.run());
+
+  BOOST_REQUIRE_EQUAL(100, simulator.find_order(book, 2)->filled_qty());
+  BOOST_REQUIRE_EQUAL(0, simulator.find_order(book, 3)->filled_qty());
+  BOOST_REQUIRE_EQUAL(0, simulator.find_order(book, 1)->filled_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestFeedsOfManyBooks)
+{
+  SimpleOrderBook first_book, second_book;
+  SimpleSimulator simulator(3, 2);
+  LiftingStrategy strategy(simulator);
+  simulator.set_market_data_listener(&strategy);
+  uint32_t first = simulator.add_book(first_book);
+  uint32_t second = simulator.add_book(second_book);
+  // The second book's ask is cancelled before the strategy's order arrives
+  const TimedEvent second_feed[] = {
+    timed(1, impl::add_event(1, false, 1300, 50)),
+    timed(4, impl::cancel_event(1))
+  };
+  simulator.add_feed(first, FEED, FEED_END);
+  simulator.add_feed(second, second_feed, second_feed + 2);
+  BOOST_REQUIRE_EQUAL(2, simulator.pending());
+
+  simulator.run();
+  BOOST_REQUIRE_EQUAL(100, simulator.find_order(first, 1001)->filled_qty());
+  BOOST_REQUIRE_EQUAL(0, simulator.find_order(second, 1001)->filled_qty());
+  // The first book's cancel arrives after the fill, so is skipped
+  BOOST_REQUIRE_EQUAL(5, simulator.events_applied());
+}
+
+} // namespace
@@ -0,0 +1,133 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_MassCancel
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+
+namespace liquibook {
+
+using impl::SimpleOrder;
+
+// Order book which counts mass cancel callbacks
+class MassCancelOrderBook : public SimpleOrderBook {
+public:
+  MassCancelOrderBook() : mass_cancels_(0), orders_cancelled_(0) {}
+
+  virtual void perform_callback(SimpleCallback& cb) {
+    if (cb.type == SimpleCallback::cb_mass_cancel) {
+      ++mass_cancels_;
+      orders_cancelled_ += cb.cancel_count;
+    }
+    SimpleOrderBook::perform_callback(cb);
+  }
+
+  int mass_cancels_;
+  uint32_t orders_cancelled_;
+};
+
+BOOST_AUTO_TEST_CASE(TestMassCancelOwner)
+{
+  MassCancelOrderBook order_book;
+  SimpleOrder ask1(false, 1252, 100, 0, 0, 2);
+  SimpleOrder ask0(false, 1251, 100, 0, 0, 1);
+  SimpleOrder bid2(true,  1250, 300, 0, 0, 1);
+  SimpleOrder bid1(true,  1250, 200, 0, 0, 2);
+  SimpleOrder bid0(true,  1250, 100, 0, 0, 1);
+  SimpleOrder bid3(true,  1249, 100, 1252, 0, 1); // Stop
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid3, false));
+
+  // Cancel all orders of owner 1
+  BOOST_REQUIRE_EQUAL(4, order_book.mass_cancel(1));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(1, order_book.mass_cancels_);
+  BOOST_REQUIRE_EQUAL(4, order_book.orders_cancelled_);
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid2.state());
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid3.state());
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, bid1.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, ask1.state());
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.stop_bids().size());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 200));
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+
+  // Nothing left to cancel
+  BOOST_REQUIRE_EQUAL(0, order_book.mass_cancel(1));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(1, order_book.mass_cancels_);
+}
+
+BOOST_AUTO_TEST_CASE(TestMassCancelSideAndRange)
+{
+  MassCancelOrderBook order_book;
+  SimpleOrder ask0(false, 1252, 100);
+  SimpleOrder bid3(true,  1250, 100);
+  SimpleOrder bid2(true,  1249, 100);
+  SimpleOrder bid1(true,  1248, 100);
+  SimpleOrder bid0(true,  1247, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid3, false));
+
+  // Cancel bids from 1248 to 1249
+  BOOST_REQUIRE_EQUAL(2, order_book.mass_cancel(0, true, true, 1248, 1249));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid1.state());
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid2.state());
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+  BOOST_REQUIRE(dc.verify_bid(1247, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+
+  // Cancel all asks
+  BOOST_REQUIRE_EQUAL(1, order_book.mass_cancel(0, false, true));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(2, order_book.mass_cancels_);
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(2, order_book.bids().size());
+
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+  BOOST_REQUIRE(dc.verify_bid(1247, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestMassCancelIceberg)
+{
+  MassCancelOrderBook order_book;
+  SimpleOrder bid1(true,  1250, 100);
+  SimpleOrder bid0(true,  1250, 500, 0, 100); // Iceberg
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+
+  BOOST_REQUIRE_EQUAL(2, order_book.mass_cancel());
+  order_book.perform_callbacks();
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+}
+
+} // namespace
@@ -0,0 +1,179 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_MassQuote
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+
+namespace liquibook {
+
+using impl::SimpleOrder;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+typedef SimpleOrderBook::TypedQuote SimpleQuote;
+
+// Order book which counts mass quote and replace callbacks
+class MassQuoteOrderBook : public SimpleOrderBook {
+public:
+  MassQuoteOrderBook() : mass_quotes_(0), orders_quoted_(0), replaces_(0) {}
+
+  virtual void perform_callback(SimpleCallback& cb) {
+    if (cb.type == SimpleCallback::cb_mass_quote) {
+      ++mass_quotes_;
+      orders_quoted_ += cb.quote_count;
+    } else if (cb.type == SimpleCallback::cb_order_replace) {
+      ++replaces_;
+    }
+    SimpleOrderBook::perform_callback(cb);
+  }
+
+  int mass_quotes_;
+  uint32_t orders_quoted_;
+  int replaces_;
+};
+
+BOOST_AUTO_TEST_CASE(TestQuotePair)
+{
+  MassQuoteOrderBook order_book;
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder ask0(false, 1251, 300, 0, 0, 1);
+  SimpleOrder bid1(true,  1250, 100);
+  SimpleOrder bid0(true,  1250, 300, 0, 0, 1);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Move the ask out and size down the bid, in one callback
+  SimpleQuote quotes[] = { SimpleQuote(&bid0, -100), 
+                           SimpleQuote(&ask0, 0, 1253) };
+  BOOST_REQUIRE(!order_book.mass_quote(quotes, 2));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(1, order_book.mass_quotes_);
+  BOOST_REQUIRE_EQUAL(2, order_book.orders_quoted_);
+  BOOST_REQUIRE_EQUAL(0, order_book.replaces_);
+  BOOST_REQUIRE_EQUAL(200, bid0.order_qty());
+  BOOST_REQUIRE_EQUAL(1253, ask0.price());
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 2, 300));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1253, 1, 300));
+
+  // The sized down bid kept its place ahead of bid1
+  SimpleOrder ask2(false, 1250, 200);
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 200, 1250 * 200);
+    SimpleFillCheck fc1(&bid1, 0, 0);
+    SimpleFillCheck fc2(&ask2, 200, 1250 * 200);
+    BOOST_REQUIRE(add_and_verify(order_book, &ask2, true, true));
+  ); }
+}
+
+BOOST_AUTO_TEST_CASE(TestQuoteCrosses)
+{
+  MassQuoteOrderBook order_book;
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Raise the bid through the ask, and size up the other ask.  The 
+  // replaces are performed before the fill.
+  SimpleQuote quotes[] = { SimpleQuote(&bid0, 50, 1251), 
+                           SimpleQuote(&ask1, 100) };
+  BOOST_REQUIRE(order_book.mass_quote(quotes, 2));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(1, order_book.mass_quotes_);
+  BOOST_REQUIRE_EQUAL(impl::os_complete, ask0.state());
+  BOOST_REQUIRE_EQUAL(150, bid0.order_qty());
+  BOOST_REQUIRE_EQUAL(100, bid0.filled_qty());
+  BOOST_REQUIRE_EQUAL(1251 * 100, bid0.filled_cost());
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1251, 1, 50));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 200));
+}
+
+BOOST_AUTO_TEST_CASE(TestQuoteChangesDepthOnce)
+{
+  MassQuoteOrderBook order_book;
+  SimpleOrder ask2(false, 1253, 100);
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+  order_book.perform_callbacks();
+  order_book.depth().published();
+  book::ChangeId last_change = order_book.depth().last_change();
+
+  // Swap the prices of the first two asks.  Taken one replace at a time, 
+  // this would erase and insert levels; taken whole, the depth is as it 
+  // was.
+  SimpleQuote swap[] = { SimpleQuote(&ask0, 0, 1252), 
+                         SimpleQuote(&ask1, 0, 1251) };
+  BOOST_REQUIRE(!order_book.mass_quote(swap, 2));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(1252, ask0.price());
+  BOOST_REQUIRE_EQUAL(1251, ask1.price());
+  BOOST_REQUIRE(!order_book.depth().changed());
+  BOOST_REQUIRE_EQUAL(last_change, order_book.depth().last_change());
+
+  // Move the best ask out behind the third, and size up the third.  Each
+  // touched level is changed once.
+  SimpleQuote quotes[] = { SimpleQuote(&ask1, 0, 1253), 
+                           SimpleQuote(&ask2, 50) };
+  BOOST_REQUIRE(!order_book.mass_quote(quotes, 2));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE(order_book.depth().changed());
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1253, 2, 250));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+  BOOST_REQUIRE_EQUAL(last_change + 2, order_book.depth().last_change());
+}
+
+BOOST_AUTO_TEST_CASE(TestQuoteRejectAndCancel)
+{
+  MassQuoteOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder bid1(true,  1249, 100);
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  // bid1 is not in the book, and ask0 is sized down to nothing
+  SimpleQuote quotes[] = { SimpleQuote(&bid1, -50), 
+                           SimpleQuote(&ask0, -100),
+                           SimpleQuote(&bid0, -200) };
+  BOOST_REQUIRE(!order_book.mass_quote(quotes, 3));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(1, order_book.mass_quotes_);
+  BOOST_REQUIRE_EQUAL(1, order_book.orders_quoted_);
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, bid0.state());
+  BOOST_REQUIRE_EQUAL(100, bid0.open_qty());
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+
+  // No replace accepted, no mass quote callback
+  SimpleQuote missing(&bid1, -50);
+  BOOST_REQUIRE(!order_book.mass_quote(&missing, 1));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(1, order_book.mass_quotes_);
+}
+
+} // namespace
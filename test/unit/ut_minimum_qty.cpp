@@ -0,0 +1,175 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_MinimumQty
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+
+namespace liquibook {
+
+using book::ProRataMatch;
+using impl::SimpleOrder;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+typedef impl::SimpleOrderBook<5, ProRataMatch> ProRataOrderBook;
+
+BOOST_AUTO_TEST_CASE(TestMinimumNotMet)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder bid0(true,  1251, 300, 0, 0, 0, 0, peg_none, 200);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Only 100 at or below 1251, the bid rests without matching
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 0, 0);
+    SimpleFillCheck fc1(&ask0, 0, 0);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, false, false, 
+                                 oc_minimum_qty));
+  ); }
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1251, 1, 300));
+  BOOST_REQUIRE(dc.verify_ask(1251, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+}
+
+BOOST_AUTO_TEST_CASE(TestMinimumMet)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder bid0(true,  1252, 300, 0, 0, 0, 0, peg_none, 200);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Both asks fill, and the rest of the bid rests as a plain order
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 200, 1251 * 100 + 1252 * 100);
+    SimpleFillCheck fc1(&ask0, 100, 1251 * 100);
+    SimpleFillCheck fc2(&ask1, 100, 1252 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, false, 
+                                 oc_minimum_qty));
+  ); }
+
+  // A later ask smaller than the minimum matches the resting bid
+  SimpleOrder ask2(false, 1252, 50);
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 50, 1252 * 50);
+    SimpleFillCheck fc1(&ask2, 50, 1252 * 50);
+    BOOST_REQUIRE(add_and_verify(order_book, &ask2, true, true));
+  ); }
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1252, 1, 50));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestMinimumImmediateOrCancel)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1251, 200); // AON
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder bid0(true,  1251, 250, 0, 0, 0, 0, peg_none, 150);
+  SimpleOrder bid1(true,  1251, 300, 0, 0, 0, 0, peg_none, 300);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false, false, 
+                               oc_all_or_none));
+
+  // The AON ask is too large for what remains of the bid, so only 100 
+  // can fill
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false, false, 
+                               oc_minimum_qty | oc_immediate_or_cancel));
+  BOOST_REQUIRE_EQUAL(0, bid0.filled_qty());
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+
+  // A bid for both fills both
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid1, 300, 1251 * 300);
+    SimpleFillCheck fc1(&ask0, 100, 1251 * 100);
+    SimpleFillCheck fc2(&ask1, 200, 1251 * 200);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid1, true, true, 
+                                 oc_minimum_qty | oc_immediate_or_cancel));
+  ); }
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestMinimumSelfTrade)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1251, 100, 0, 0, 2);
+  SimpleOrder ask0(false, 1251, 100, 0, 0, 1);
+  SimpleOrder bid0(true,  1251, 200, 0, 0, 1, 0, peg_none, 150);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // The same-owner ask cancels the bid before the minimum is met
+  BOOST_REQUIRE(!order_book.add(&bid0, oc_minimum_qty));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid0.state());
+  BOOST_REQUIRE_EQUAL(0, ask1.filled_qty());
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestMinimumReject)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid0(true,  1251, 100);
+  SimpleOrder bid1(true,  1251, 100, 0, 0, 0, 0, peg_none, 200);
+
+  BOOST_REQUIRE(!order_book.add(&bid0, oc_minimum_qty));
+  BOOST_REQUIRE(!order_book.add(&bid1, oc_minimum_qty));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_new, bid0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_new, bid1.state());
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestMinimumProRata)
+{
+  ProRataOrderBook order_book;
+  SimpleOrder ask1(false, 1251, 60);
+  SimpleOrder ask0(false, 1251, 50); // AON
+  SimpleOrder bid0(true,  1251, 100, 0, 0, 0, 0, peg_none, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false, false,
+                               oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // The AON ask is ahead in time, but pro-rata fills it from what is left
+  // after the other ask, so only 60 could fill.  The bid rests unmatched.
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 0, 0);
+    SimpleFillCheck fc1(&ask0, 0, 0);
+    SimpleFillCheck fc2(&ask1, 0, 0);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, false, false, 
+                                 oc_minimum_qty));
+  ); }
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1251, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1251, 2, 110));
+
+  // An AON ask which fits what is left lets the minimum be met
+  ProRataOrderBook order_book2;
+  SimpleOrder ask3(false, 1251, 60);
+  SimpleOrder ask2(false, 1251, 40); // AON
+  SimpleOrder bid1(true,  1251, 100, 0, 0, 0, 0, peg_none, 100);
+  BOOST_REQUIRE(add_and_verify(order_book2, &ask2, false, false,
+                               oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book2, &ask3, false));
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid1, 100, 1251 * 100);
+    SimpleFillCheck fc1(&ask2, 40, 1251 * 40);
+    SimpleFillCheck fc2(&ask3, 60, 1251 * 60);
+    BOOST_REQUIRE(add_and_verify(order_book2, &bid1, true, true, 
+                                 oc_minimum_qty));
+  ); }
+  BOOST_REQUIRE_EQUAL(0, order_book2.asks().size());
+}
+
+} // Namespace
@@ -0,0 +1,198 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_MirrorBook
+#include <boost/test/unit_test.hpp>
+#include "book/mirror_book.h"
+#include <iostream>
+
+namespace liquibook {
+
+using book::DepthLevel;
+using book::MirrorOrder;
+using book::OrderIdIndex;
+typedef book::MirrorBook<5> MirrorBook;
+
+bool verify_level(const DepthLevel* level,
+                  book::Price price,
+                  uint32_t order_count,
+                  book::Quantity aggregate_qty)
+{
+  bool matched = true;
+  if (price != level->price()) {
+    std::cout << "Level price " << level->price() << std::endl;
+    matched = false;
+  }
+  if (order_count != level->order_count()) {
+    std::cout << "Level order count " << level->order_count() << std::endl;
+    matched = false;
+  }
+  if (aggregate_qty != level->aggregate_qty()) {
+    std::cout << "Level aggregate qty " << level->aggregate_qty() << std::endl;
+    matched = false;
+  }
+  return matched;
+}
+
+BOOST_AUTO_TEST_CASE(TestOrderIdIndex)
+{
+  OrderIdIndex index;
+  uint32_t value = 0;
+  for (uint32_t id = 1; id <= 1000; ++id) {
+    BOOST_REQUIRE(index.insert(id * 7919, id));
+  }
+  BOOST_REQUIRE(!index.insert(7919, 5));
+  BOOST_REQUIRE_EQUAL(1000, index.size());
+
+  // Erase every other entry, and the rest are still found
+  for (uint32_t id = 1; id <= 1000; id += 2) {
+    BOOST_REQUIRE(index.erase(id * 7919));
+  }
+  BOOST_REQUIRE(!index.erase(7919));
+  BOOST_REQUIRE_EQUAL(500, index.size());
+  for (uint32_t id = 1; id <= 1000; ++id) {
+    BOOST_REQUIRE_EQUAL(id % 2 == 0, index.find(id * 7919, value));
+    if (id % 2 == 0) {
+      BOOST_REQUIRE_EQUAL(id, value);
+    }
+  }
+
+  index.clear();
+  BOOST_REQUIRE_EQUAL(0, index.size());
+  BOOST_REQUIRE(!index.find(2 * 7919, value));
+  BOOST_REQUIRE(index.insert(0, 3));
+  BOOST_REQUIRE(index.find(0, value));
+  BOOST_REQUIRE_EQUAL(3, value);
+}
+
+BOOST_AUTO_TEST_CASE(TestAddAndRemove)
+{
+  MirrorBook book;
+  BOOST_REQUIRE(book.add(1001, true, 1250, 100));
+  BOOST_REQUIRE(book.add(1002, true, 1250, 200));
+  BOOST_REQUIRE(book.add(1003, true, 1249, 300));
+  BOOST_REQUIRE(book.add(1004, false, 1252, 400));
+  // Orders on opposite sides which cross do not match
+  BOOST_REQUIRE(book.add(1005, false, 1250, 500));
+
+  // Duplicate IDs, no price and no quantity are refused
+  BOOST_REQUIRE(!book.add(1001, false, 1251, 100));
+  BOOST_REQUIRE(!book.add(1006, false, 0, 100));
+  BOOST_REQUIRE(!book.add(1006, false, 1251, 0));
+  BOOST_REQUIRE_EQUAL(5, book.order_count());
+
+  BOOST_REQUIRE(verify_level(book.depth().bids(), 1250, 2, 300));
+  BOOST_REQUIRE(verify_level(book.depth().bids() + 1, 1249, 1, 300));
+  BOOST_REQUIRE(verify_level(book.depth().asks(), 1250, 1, 500));
+  BOOST_REQUIRE(verify_level(book.depth().asks() + 1, 1252, 1, 400));
+
+  const MirrorOrder* order = book.find(1002);
+  BOOST_REQUIRE(order);
+  BOOST_REQUIRE_EQUAL(1250, order->price);
+  BOOST_REQUIRE_EQUAL(200, order->open_qty);
+  BOOST_REQUIRE(order->is_buy);
+
+  BOOST_REQUIRE(book.remove(1005));
+  BOOST_REQUIRE(!book.remove(1005));
+  BOOST_REQUIRE(!book.find(1005));
+  BOOST_REQUIRE(verify_level(book.depth().asks(), 1252, 1, 400));
+  BOOST_REQUIRE_EQUAL(4, book.order_count());
+
+  // The removed order's slot is reused
+  BOOST_REQUIRE(book.add(1005, false, 1253, 600));
+  BOOST_REQUIRE(verify_level(book.depth().asks() + 1, 1253, 1, 600));
+  BOOST_REQUIRE_EQUAL(1250, book.find(1001)->price);
+}
+
+BOOST_AUTO_TEST_CASE(TestExecuteAndReduce)
+{
+  MirrorBook book;
+  BOOST_REQUIRE(book.add(1, false, 1252, 400));
+  BOOST_REQUIRE(book.add(2, false, 1252, 100));
+
+  BOOST_REQUIRE(book.execute(1, 150));
+  BOOST_REQUIRE_EQUAL(250, book.find(1)->open_qty);
+  BOOST_REQUIRE(verify_level(book.depth().asks(), 1252, 2, 350));
+  BOOST_REQUIRE_EQUAL(150, book.executed_qty());
+  BOOST_REQUIRE_EQUAL(1252, book.last_executed_price());
+
+  // More than is open is refused
+  BOOST_REQUIRE(!book.execute(1, 251));
+  BOOST_REQUIRE(!book.reduce(2, 101));
+  BOOST_REQUIRE(!book.execute(3, 1));
+  BOOST_REQUIRE(verify_level(book.depth().asks(), 1252, 2, 350));
+
+  // A partial cancel does not count as executed
+  BOOST_REQUIRE(book.reduce(1, 50));
+  BOOST_REQUIRE_EQUAL(150, book.executed_qty());
+
+  // Executing the rest removes the order
+  BOOST_REQUIRE(book.execute(2, 100));
+  BOOST_REQUIRE(!book.find(2));
+  BOOST_REQUIRE(verify_level(book.depth().asks(), 1252, 1, 200));
+  BOOST_REQUIRE(book.execute(1, 200));
+  BOOST_REQUIRE_EQUAL(0, book.order_count());
+  BOOST_REQUIRE(verify_level(book.depth().asks(), 0, 0, 0));
+  BOOST_REQUIRE_EQUAL(450, book.executed_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestModifyAndReplace)
+{
+  MirrorBook book;
+  BOOST_REQUIRE(book.add(1, true, 1250, 100));
+  BOOST_REQUIRE(book.add(2, true, 1249, 200));
+
+  // In place
+  BOOST_REQUIRE(book.modify(1, 300));
+  BOOST_REQUIRE(verify_level(book.depth().bids(), 1250, 1, 300));
+
+  // To a new price
+  BOOST_REQUIRE(book.modify(1, 300, 1249));
+  BOOST_REQUIRE(verify_level(book.depth().bids(), 1249, 2, 500));
+  BOOST_REQUIRE(verify_level(book.depth().bids() + 1, 0, 0, 0));
+
+  // To a new ID
+  BOOST_REQUIRE(book.replace(2, 3, 50, 1251));
+  BOOST_REQUIRE(!book.find(2));
+  BOOST_REQUIRE_EQUAL(50, book.find(3)->open_qty);
+  BOOST_REQUIRE(book.find(3)->is_buy);
+  BOOST_REQUIRE(verify_level(book.depth().bids(), 1251, 1, 50));
+  BOOST_REQUIRE(verify_level(book.depth().bids() + 1, 1249, 1, 300));
+
+  // Onto an ID in use, or of an unknown order
+  BOOST_REQUIRE(!book.replace(3, 1, 50));
+  BOOST_REQUIRE(!book.replace(2, 4, 50));
+  BOOST_REQUIRE(!book.modify(2, 50));
+
+  // No quantity removes the order
+  BOOST_REQUIRE(book.modify(3, 0));
+  BOOST_REQUIRE_EQUAL(1, book.order_count());
+  BOOST_REQUIRE(verify_level(book.depth().bids(), 1249, 1, 300));
+}
+
+BOOST_AUTO_TEST_CASE(TestFullDepth)
+{
+  MirrorBook book;
+  // More levels than the depth shows
+  for (uint32_t level = 0; level < 8; ++level) {
+    BOOST_REQUIRE(book.add(100 + level, true, 1250 - level, 100 + level));
+  }
+  BOOST_REQUIRE(verify_level(book.depth().last_bid_level(), 1246, 1, 104));
+
+  // Levels beyond the depth come into view as better ones go
+  BOOST_REQUIRE(book.remove(100));
+  BOOST_REQUIRE(book.execute(101, 101));
+  BOOST_REQUIRE(book.reduce(106, 6));
+  BOOST_REQUIRE(verify_level(book.depth().bids(), 1248, 1, 102));
+  BOOST_REQUIRE(verify_level(book.depth().last_bid_level(), 1244, 1, 100));
+
+  book.clear();
+  BOOST_REQUIRE_EQUAL(0, book.order_count());
+  BOOST_REQUIRE(!book.find(102));
+  BOOST_REQUIRE(verify_level(book.depth().bids(), 0, 0, 0));
+  BOOST_REQUIRE(book.add(102, true, 1250, 100));
+  BOOST_REQUIRE(verify_level(book.depth().bids(), 1250, 1, 100));
+}
+
+} // namespace
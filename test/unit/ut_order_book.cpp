@@ -14,6 +14,7 @@
 namespace liquibook {
 
 using book::DepthLevel;
+using book::FillCost;
 using book::OrderBook;
 using book::OrderTracker;
 using impl::SimpleOrder;
@@ -1135,6 +1136,32 @@ BOOST_AUTO_TEST_CASE(TestCancelAskFail)
   BOOST_REQUIRE(dc.verify_bid(   0, 0,   0));
 }
 
+BOOST_AUTO_TEST_CASE(TestCancelFilledAskSharedPrice)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask2(false, 1252, 100);
+  SimpleOrder ask1(false, 1251, 100);
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder bid0(true,  1251, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+
+  // Cancel a filled order at a price other orders still have
+  BOOST_REQUIRE(cancel_and_verify(order_book, &ask0, impl::os_complete));
+
+  // No other order is cancelled
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, ask1.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, ask2.state());
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_ask(1251, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(   0, 0,   0));
+}
+
 BOOST_AUTO_TEST_CASE(TestCancelBidRestore)
 {
   SimpleOrderBook order_book;
@@ -2729,4 +2756,445 @@ BOOST_AUTO_TEST_CASE(TestReplaceAskMatch)
   BOOST_REQUIRE(cc.verify_ask_changed(1, 1, 1, 0, 0));
 }
 
+BOOST_AUTO_TEST_CASE(TestReplaceSizeKeepsPriority)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder ask0(false, 1252, 200);
+  SimpleOrder bid1(true,  1250, 100);
+  SimpleOrder bid0(true,  1250, 200);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // A smaller size at an unchanged price keeps the order's place, a larger
+  // one goes to the back of its level
+  BOOST_REQUIRE(replace_and_verify(order_book, &bid0, -100));
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask0, 100));
+  BOOST_REQUIRE_EQUAL(&bid0, order_book.bids().begin()->second.ptr());
+  BOOST_REQUIRE_EQUAL(&ask1, order_book.asks().begin()->second.ptr());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 2, 200));
+  BOOST_REQUIRE(dc.verify_ask(1252, 2, 400));
+
+  // The first orders at each level match first
+  SimpleOrder ask2(false, 1250, 100);
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&ask2, 100, 1250 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &ask2, true, true));
+  ); }
+  SimpleOrder bid2(true,  1252, 300);
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&ask1, 100, 1252 * 100);
+    SimpleFillCheck fc1(&ask0, 200, 1252 * 200);
+    SimpleFillCheck fc2(&bid2, 300, 1252 * 300);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid2, true, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(&bid1, order_book.bids().begin()->second.ptr());
+  BOOST_REQUIRE_EQUAL(&ask0, order_book.asks().begin()->second.ptr());
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+}
+
+BOOST_AUTO_TEST_CASE(TestReplaceAskLargerMatchAon)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid0(true,  1252, 300); // AON
+  SimpleOrder ask0(false, 1251, 200);
+
+  // The AON bid rests crossed with the smaller ask
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false, false, 
+                               oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  // Growing the ask lets it fill the AON bid
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 300, 1252 * 300);
+    BOOST_REQUIRE(replace_and_verify(order_book, &ask0, 100, PRICE_UNCHANGED,
+                                     impl::os_complete, 300));
+  ); }
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestCostToFill)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask3(false, 1254, 500);
+  SimpleOrder ask2(false, 1253, 300, 0, 100); // Iceberg
+  SimpleOrder ask1(false, 1252, 400); // AON
+  SimpleOrder ask0(false, 1251, 200);
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false, false, 
+                               oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask3, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+
+  // Within the best level
+  FillCost fill = order_book.cost_to_fill(true, 150);
+  BOOST_REQUIRE_EQUAL(150, fill.filled_qty);
+  BOOST_REQUIRE_EQUAL(1251 * 150, fill.cost);
+  BOOST_REQUIRE_EQUAL(1251, fill.worst_price);
+  BOOST_REQUIRE_EQUAL(1, fill.level_count);
+
+  // Past the AON order and the hidden part of the iceberg
+  fill = order_book.cost_to_fill(true, 400);
+  BOOST_REQUIRE_EQUAL(400, fill.filled_qty);
+  BOOST_REQUIRE_EQUAL(1251 * 200 + 1253 * 100 + 1254 * 100, fill.cost);
+  BOOST_REQUIRE_EQUAL(1254, fill.worst_price);
+  BOOST_REQUIRE_EQUAL(3, fill.level_count);
+  BOOST_REQUIRE_CLOSE(double(fill.cost) / 400, fill.vwap(), 0.0001);
+
+  // Limited by price, and by what the side has
+  fill = order_book.cost_to_fill(true, 400, 1253);
+  BOOST_REQUIRE_EQUAL(300, fill.filled_qty);
+  BOOST_REQUIRE_EQUAL(1253, fill.worst_price);
+  fill = order_book.cost_to_fill(false, 400);
+  BOOST_REQUIRE_EQUAL(100, fill.filled_qty);
+  BOOST_REQUIRE_EQUAL(1250 * 100, fill.cost);
+  fill = order_book.cost_to_fill(false, 100, 1251);
+  BOOST_REQUIRE_EQUAL(0, fill.filled_qty);
+  BOOST_REQUIRE_EQUAL(0, fill.level_count);
+  BOOST_REQUIRE_EQUAL(0.0, fill.vwap());
+
+  // The book is unchanged
+  BOOST_REQUIRE_EQUAL(4, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestQueueAhead)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 200);
+  SimpleOrder ask1(false, 1251, 300, 0, 100); // Iceberg
+  SimpleOrder ask2(false, 1251, 400);
+  SimpleOrder ask3(false, 1251, 500);
+  SimpleOrder ask4(false, 1252, 600);
+  SimpleOrder bid0(true,  1251, 150);
+  SimpleOrder bid1(true,  1251, 250);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask3, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask4, false));
+
+  // Only the displayed quantity of an iceberg is ahead
+  Quantity qty_ahead = 0;
+  uint32_t orders_ahead = 0;
+  BOOST_REQUIRE(order_book.queue_ahead(&ask3, qty_ahead, orders_ahead));
+  BOOST_REQUIRE_EQUAL(700, qty_ahead);
+  BOOST_REQUIRE_EQUAL(3, orders_ahead);
+  BOOST_REQUIRE(order_book.queue_ahead(&ask0, qty_ahead, orders_ahead));
+  BOOST_REQUIRE_EQUAL(0, qty_ahead);
+  BOOST_REQUIRE_EQUAL(0, orders_ahead);
+  BOOST_REQUIRE(order_book.queue_ahead(&ask4, qty_ahead, orders_ahead));
+  BOOST_REQUIRE_EQUAL(0, qty_ahead);
+  BOOST_REQUIRE_EQUAL(0, orders_ahead);
+
+  // A fill shrinks the quantity ahead
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  BOOST_REQUIRE(order_book.queue_ahead(&ask3, qty_ahead, orders_ahead));
+  BOOST_REQUIRE_EQUAL(550, qty_ahead);
+  BOOST_REQUIRE_EQUAL(3, orders_ahead);
+
+  // A size reduction keeps its place, and a cancel leaves the queue
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask2, -100));
+  BOOST_REQUIRE(cancel_and_verify(order_book, &ask0, impl::os_cancelled));
+  BOOST_REQUIRE(order_book.queue_ahead(&ask3, qty_ahead, orders_ahead));
+  BOOST_REQUIRE_EQUAL(400, qty_ahead);
+  BOOST_REQUIRE_EQUAL(2, orders_ahead);
+  BOOST_REQUIRE(!order_book.queue_ahead(&ask0, qty_ahead, orders_ahead));
+
+  // A refreshed iceberg goes to the back of the queue
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, true, true));
+  BOOST_REQUIRE(order_book.queue_ahead(&ask1, qty_ahead, orders_ahead));
+  BOOST_REQUIRE_EQUAL(150 + 500, qty_ahead);
+  BOOST_REQUIRE_EQUAL(2, orders_ahead);
+  BOOST_REQUIRE(order_book.queue_ahead(&ask3, qty_ahead, orders_ahead));
+  BOOST_REQUIRE_EQUAL(150, qty_ahead);
+  BOOST_REQUIRE_EQUAL(1, orders_ahead);
+}
+
+BOOST_AUTO_TEST_CASE(TestQueueAheadManyCancels)
+{
+  SimpleOrderBook order_book;
+  std::vector<SimpleOrderPtr> asks;
+  for (int index = 0; index < 100; ++index) {
+    asks.push_back(SimpleOrderPtr(new SimpleOrder(false, 1251, 100 + index)));
+    BOOST_REQUIRE(add_and_verify(order_book, asks.back().get(), false));
+  }
+  // Cancel most orders, so that the level's queue is refilled
+  for (int index = 0; index < 90; ++index) {
+    BOOST_REQUIRE(cancel_and_verify(order_book, asks[index].get(), 
+                                    impl::os_cancelled));
+  }
+  Quantity qty_ahead = 0;
+  uint32_t orders_ahead = 0;
+  Quantity expected_qty = 0;
+  for (int index = 90; index < 100; ++index) {
+    BOOST_REQUIRE(order_book.queue_ahead(asks[index].get(), 
+                                         qty_ahead, orders_ahead));
+    BOOST_REQUIRE_EQUAL(expected_qty, qty_ahead);
+    BOOST_REQUIRE_EQUAL(uint32_t(index - 90), orders_ahead);
+    expected_qty += 100 + index;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestBookHashReplicas)
+{
+  // Primary and backup books are given the same transactions
+  SimpleOrderBook primary, backup;
+  BOOST_REQUIRE_EQUAL(0, primary.book_hash());
+  SimpleOrder primary_ask0(false, 1251, 100);
+  SimpleOrder primary_ask1(false, 1252, 300, 0, 100);
+  SimpleOrder primary_bid0(true, 1251, 40);
+  SimpleOrder backup_ask0(false, 1251, 100);
+  SimpleOrder backup_ask1(false, 1252, 300, 0, 100);
+  SimpleOrder backup_bid0(true, 1251, 40);
+
+  BOOST_REQUIRE(add_and_verify(primary, &primary_ask0, false));
+  BOOST_REQUIRE(add_and_verify(backup, &backup_ask0, false));
+  BOOST_REQUIRE(primary.book_hash() != 0);
+  BOOST_REQUIRE_EQUAL(primary.book_hash(), backup.book_hash());
+  BOOST_REQUIRE(add_and_verify(primary, &primary_ask1, false));
+  BOOST_REQUIRE(add_and_verify(backup, &backup_ask1, false));
+  BOOST_REQUIRE_EQUAL(primary.book_hash(), backup.book_hash());
+  BOOST_REQUIRE_EQUAL(primary.trans_id(), backup.trans_id());
+
+  // A fill changes the hash
+  uint64_t prior_hash = primary.book_hash();
+  BOOST_REQUIRE(add_and_verify(primary, &primary_bid0, true, true));
+  BOOST_REQUIRE(prior_hash != primary.book_hash());
+  BOOST_REQUIRE(add_and_verify(backup, &backup_bid0, true, true));
+  BOOST_REQUIRE_EQUAL(primary.book_hash(), backup.book_hash());
+
+  // So does a change to the reserve of an iceberg only
+  prior_hash = primary.book_hash();
+  BOOST_REQUIRE(replace_and_verify(primary, &primary_ask1, -100));
+  BOOST_REQUIRE_EQUAL(100, primary.depth().asks()[1].aggregate_qty());
+  BOOST_REQUIRE(prior_hash != primary.book_hash());
+
+  // The books differ until the backup has the replace too
+  BOOST_REQUIRE(primary.book_hash() != backup.book_hash());
+  BOOST_REQUIRE(replace_and_verify(backup, &backup_ask1, -100));
+  BOOST_REQUIRE_EQUAL(primary.book_hash(), backup.book_hash());
+
+  // An order added and cancelled leaves no trace
+  prior_hash = primary.book_hash();
+  SimpleOrder bid1(true, 1200, 100);
+  BOOST_REQUIRE(add_and_verify(primary, &bid1, false));
+  BOOST_REQUIRE(prior_hash != primary.book_hash());
+  BOOST_REQUIRE(cancel_and_verify(primary, &bid1, impl::os_cancelled));
+  BOOST_REQUIRE_EQUAL(prior_hash, primary.book_hash());
+
+  // An empty book hashes to 0
+  BOOST_REQUIRE(cancel_and_verify(primary, &primary_ask0, impl::os_cancelled));
+  BOOST_REQUIRE(cancel_and_verify(primary, &primary_ask1, impl::os_cancelled));
+  BOOST_REQUIRE_EQUAL(0, primary.book_hash());
+}
+
+BOOST_AUTO_TEST_CASE(TestBookHashPriceChange)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1252, 100);
+  SimpleOrder ask1(false, 1253, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  const uint64_t prior_hash = order_book.book_hash();
+
+  // Moving an order away and back leaves the hash as it was
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask0, 0, 1254));
+  BOOST_REQUIRE(prior_hash != order_book.book_hash());
+  BOOST_REQUIRE(replace_and_verify(order_book, &ask0, 0, 1252));
+  BOOST_REQUIRE_EQUAL(prior_hash, order_book.book_hash());
+
+  // Sweeping both asks empties the book
+  SimpleOrder bid0(true, 1253, 200);
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  BOOST_REQUIRE_EQUAL(0, order_book.book_hash());
+}
+
+BOOST_AUTO_TEST_CASE(TestBookHashPegs)
+{
+  // The books differ only by a pegged order
+  SimpleOrderBook primary, backup;
+  SimpleOrder primary_bid0(true, 1250, 100);
+  SimpleOrder backup_bid0(true, 1250, 100);
+  SimpleOrder primary_bid1(true, 0, 100, 0, 0, 0, 0, book::peg_primary);
+  SimpleOrder backup_bid1(true, 0, 100, 0, 0, 0, 0, book::peg_primary);
+  BOOST_REQUIRE(add_and_verify(primary, &primary_bid0, false));
+  BOOST_REQUIRE(add_and_verify(backup, &backup_bid0, false));
+  const uint64_t prior_hash = primary.book_hash();
+
+  BOOST_REQUIRE(add_and_verify(primary, &primary_bid1, false));
+  BOOST_REQUIRE(prior_hash != primary.book_hash());
+  BOOST_REQUIRE(primary.book_hash() != backup.book_hash());
+  BOOST_REQUIRE(add_and_verify(backup, &backup_bid1, false));
+  BOOST_REQUIRE_EQUAL(primary.book_hash(), backup.book_hash());
+
+  // A pegged order differs from a resting order at the peg's price
+  SimpleOrderBook resting;
+  SimpleOrder resting_bid0(true, 1250, 100);
+  SimpleOrder resting_bid1(true, 1250, 100);
+  BOOST_REQUIRE(add_and_verify(resting, &resting_bid0, false));
+  BOOST_REQUIRE(add_and_verify(resting, &resting_bid1, false));
+  BOOST_REQUIRE(primary.book_hash() != resting.book_hash());
+
+  // So does a change to the pegged order's size
+  BOOST_REQUIRE(replace_and_verify(primary, &primary_bid1, -50));
+  BOOST_REQUIRE(primary.book_hash() != backup.book_hash());
+  BOOST_REQUIRE(replace_and_verify(backup, &backup_bid1, -50));
+  BOOST_REQUIRE_EQUAL(primary.book_hash(), backup.book_hash());
+
+  // A pegged order filled or cancelled leaves no trace
+  SimpleOrder ask0(false, 0, 150);
+  BOOST_REQUIRE(add_and_verify(primary, &ask0, true, true));
+  BOOST_REQUIRE_EQUAL(impl::os_complete, primary_bid1.state());
+  BOOST_REQUIRE_EQUAL(0, primary.book_hash());
+  BOOST_REQUIRE(cancel_and_verify(backup, &backup_bid1, impl::os_cancelled));
+  BOOST_REQUIRE_EQUAL(prior_hash, backup.book_hash());
+}
+
+BOOST_AUTO_TEST_CASE(TestBookHashStops)
+{
+  // The books differ only by an untriggered stop
+  SimpleOrderBook primary, backup;
+  SimpleOrder primary_ask0(false, 1252, 100);
+  SimpleOrder backup_ask0(false, 1252, 100);
+  SimpleOrder primary_ask1(false, 1240, 100, 1245);
+  SimpleOrder backup_ask1(false, 1240, 100, 1245);
+  BOOST_REQUIRE(add_and_verify(primary, &primary_ask0, false));
+  BOOST_REQUIRE(add_and_verify(backup, &backup_ask0, false));
+  const uint64_t prior_hash = primary.book_hash();
+
+  BOOST_REQUIRE(add_and_verify(primary, &primary_ask1, false));
+  BOOST_REQUIRE_EQUAL(1, primary.stop_asks().size());
+  BOOST_REQUIRE(prior_hash != primary.book_hash());
+  BOOST_REQUIRE(primary.book_hash() != backup.book_hash());
+  BOOST_REQUIRE(add_and_verify(backup, &backup_ask1, false));
+  BOOST_REQUIRE_EQUAL(primary.book_hash(), backup.book_hash());
+
+  // A change to the stop's limit price changes the hash
+  BOOST_REQUIRE(replace_and_verify(primary, &primary_ask1, 0, 1241));
+  BOOST_REQUIRE(primary.book_hash() != backup.book_hash());
+  BOOST_REQUIRE(replace_and_verify(backup, &backup_ask1, 0, 1241));
+  BOOST_REQUIRE_EQUAL(primary.book_hash(), backup.book_hash());
+
+  // A triggered stop is counted as resting in the book
+  SimpleOrder bid0(true, 1252, 100);
+  SimpleOrder bid1(true, 1245, 50);
+  SimpleOrder ask2(false, 1245, 50);
+  BOOST_REQUIRE(add_and_verify(primary, &bid0, true, true));
+  BOOST_REQUIRE(add_and_verify(primary, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(primary, &ask2, true, true));
+  BOOST_REQUIRE(primary.stop_asks().empty());
+  BOOST_REQUIRE_EQUAL(1, primary.asks().size());
+  BOOST_REQUIRE(primary.book_hash() != 0);
+  BOOST_REQUIRE(cancel_and_verify(primary, &primary_ask1, impl::os_cancelled));
+  BOOST_REQUIRE_EQUAL(0, primary.book_hash());
+
+  // A stop cancelled leaves no trace
+  BOOST_REQUIRE(cancel_and_verify(backup, &backup_ask1, impl::os_cancelled));
+  BOOST_REQUIRE_EQUAL(prior_hash, backup.book_hash());
+}
+
+BOOST_AUTO_TEST_CASE(TestTrackerCachesOrder)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1252, 100);
+  SimpleOrder bid0(true, 1250, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  const SimpleOrderBook::Tracker& ask_tracker = 
+      order_book.asks().begin()->second;
+  BOOST_REQUIRE_EQUAL(1252, ask_tracker.price());
+  BOOST_REQUIRE(!ask_tracker.is_buy());
+  BOOST_REQUIRE(order_book.bids().begin()->second.is_buy());
+
+  // A replace at a new price is matched at that price
+  BOOST_REQUIRE(replace_and_verify(order_book, &bid0, 0, 1251));
+  BOOST_REQUIRE_EQUAL(1251, order_book.bids().begin()->second.price());
+  SimpleOrder ask1(false, 0, 100);
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, true, true));
+  BOOST_REQUIRE_EQUAL(1251, order_book.last_trade_price());
+  BOOST_REQUIRE(order_book.bids().empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestTrackerDetail)
+{
+  typedef SimpleOrderBook::Tracker Tracker;
+  SimpleOrder ask0(false, 1252, 100);
+  SimpleOrder ask1(false, 1252, 300, 0, 100);
+  Tracker plain(&ask0, book::oc_all_or_none);
+  BOOST_REQUIRE(!plain.is_buy());
+  BOOST_REQUIRE_EQUAL(book::oc_all_or_none, plain.conditions());
+  BOOST_REQUIRE_EQUAL(0, plain.reserve_qty());
+  BOOST_REQUIRE_EQUAL(100, plain.visible_qty());
+  BOOST_REQUIRE_EQUAL(0, plain.timer());
+  plain.set_timer(3);
+  BOOST_REQUIRE_EQUAL(3, plain.timer());
+
+  // A copy of an iceberg keeps a reserve of its own
+  Tracker iceberg(&ask1);
+  iceberg.refresh();
+  BOOST_REQUIRE(iceberg.iceberg());
+  BOOST_REQUIRE_EQUAL(200, iceberg.reserve_qty());
+  Tracker copy(iceberg);
+  copy.fill(250);
+  BOOST_REQUIRE_EQUAL(50, copy.reserve_qty());
+  BOOST_REQUIRE_EQUAL(200, iceberg.reserve_qty());
+  copy = plain;
+  BOOST_REQUIRE(!copy.iceberg());
+  BOOST_REQUIRE_EQUAL(3, copy.timer());
+  BOOST_REQUIRE_EQUAL(100, iceberg.visible_qty());
+}
+
+// Order which implements only what every order must
+class PlainOrder : public book::Order {
+public:
+  PlainOrder(bool is_buy, Price price, Quantity qty)
+  : is_buy_(is_buy), price_(price), qty_(qty) {}
+  virtual bool is_buy() const { return is_buy_; }
+  virtual Price price() const { return price_; }
+  virtual Quantity order_qty() const { return qty_; }
+  Quantity open_qty() const { return qty_; }
+private:
+  bool is_buy_;
+  Price price_;
+  Quantity qty_;
+};
+
+BOOST_AUTO_TEST_CASE(TestPlainOrder)
+{
+  OrderBook<PlainOrder*> order_book;
+  PlainOrder bid0(true,  1250, 100);
+  PlainOrder ask0(false, 1251, 100);
+  PlainOrder ask1(false, 1250, 50);
+
+  BOOST_REQUIRE(!order_book.add(&bid0));
+  BOOST_REQUIRE(!order_book.add(&ask0));
+  BOOST_REQUIRE(order_book.add(&ask1));
+  order_book.perform_callbacks();
+
+  // The optional features default to unused
+  BOOST_REQUIRE_EQUAL(0, bid0.stop_price());
+  BOOST_REQUIRE_EQUAL(book::peg_none, bid0.peg_type());
+  const OrderBook<PlainOrder*>::Tracker* tracker = 
+      order_book.find_resting(&bid0);
+  BOOST_REQUIRE(tracker);
+  BOOST_REQUIRE(!tracker->iceberg());
+  BOOST_REQUIRE_EQUAL(0, tracker->owner());
+  BOOST_REQUIRE_EQUAL(50, tracker->open_qty());
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+}
+
 } // namespace
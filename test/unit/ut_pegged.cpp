@@ -0,0 +1,258 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_Pegged
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+
+namespace liquibook {
+
+using impl::SimpleOrder;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+
+BOOST_AUTO_TEST_CASE(TestPeggedPrice)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1253, 100);
+  SimpleOrder bid0(true,  1250, 100);
+  SimpleOrder bid1(true,  0, 100, 0, 0, 0, 0, peg_primary);
+
+  // Nothing to peg to yet
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE_EQUAL(0, order_book.pegged_price(true, peg_primary));
+  BOOST_REQUIRE_EQUAL(1, order_book.pegged_orders(true, peg_primary).size());
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE_EQUAL(1250, order_book.pegged_price(true, peg_primary));
+  BOOST_REQUIRE_EQUAL(1253, order_book.pegged_price(false, peg_primary));
+  // Midpoints round toward their own side
+  BOOST_REQUIRE_EQUAL(1251, order_book.pegged_price(true, peg_midpoint));
+  BOOST_REQUIRE_EQUAL(1252, order_book.pegged_price(false, peg_midpoint));
+
+  // Pegged orders are not in depth by default
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestPrimaryPegMatchesAfterLevel)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1260, 100);
+  SimpleOrder bid2(true,  1249, 100);
+  SimpleOrder bid1(true,  0, 100, 0, 0, 0, 0, peg_primary);
+  SimpleOrder bid0(true,  1250, 100);
+  SimpleOrder ask1(false, 1249, 250);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+
+  // The peg trades at 1250, after bid0 and before bid2
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&bid1, 100, 1250 * 100);
+    SimpleFillCheck fc2(&bid2, 50, 1249 * 50);
+    SimpleFillCheck fc3(&ask1, 250, 1250 * 200 + 1249 * 50);
+    BOOST_REQUIRE(add_and_verify(order_book, &ask1, true, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(0, order_book.pegged_orders(true, peg_primary).size());
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1249, 1, 50));
+  BOOST_REQUIRE(dc.verify_ask(1260, 1, 100));
+}
+
+BOOST_AUTO_TEST_CASE(TestMidpointPegMatchesFirst)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1254, 100);
+  SimpleOrder ask0(false, 0, 100, 0, 0, 0, 0, peg_midpoint);
+  SimpleOrder bid0(true,  1250, 100);
+  SimpleOrder bid1(true,  1254, 150);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE_EQUAL(1252, order_book.pegged_price(false, peg_midpoint));
+
+  // The midpoint ask is priced better than the book
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&ask0, 100, 1252 * 100);
+    SimpleFillCheck fc1(&ask1, 50, 1254 * 50);
+    SimpleFillCheck fc2(&bid1, 150, 1252 * 100 + 1254 * 50);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid1, true, true));
+  ); }
+}
+
+BOOST_AUTO_TEST_CASE(TestMidpointPegsCross)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1253, 100);
+  SimpleOrder bid1(true,  1250, 100);
+  SimpleOrder ask0(false, 0, 100, 0, 0, 0, 0, peg_midpoint);
+  SimpleOrder bid0(true,  0, 60, 0, 0, 0, 0, peg_midpoint);
+  SimpleOrder bid2(true,  1251, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  // An odd spread keeps the midpoints apart
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+
+  // Evening the spread brings them together
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 60, 1252 * 60);
+    SimpleFillCheck fc1(&ask0, 60, 1252 * 60);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+  ); }
+  BOOST_REQUIRE_EQUAL(0, order_book.pegged_orders(true, peg_midpoint).size());
+  BOOST_REQUIRE_EQUAL(1, order_book.pegged_orders(false, peg_midpoint).size());
+}
+
+BOOST_AUTO_TEST_CASE(TestMidpointPegsSelfTrade)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1253, 100);
+  SimpleOrder bid1(true,  1250, 100);
+  SimpleOrder ask0(false, 0, 100, 0, 0, 1, 0, peg_midpoint);
+  SimpleOrder bid0(true,  0, 60, 0, 0, 1, 0, peg_midpoint);
+  SimpleOrder bid3(true,  0, 50, 0, 0, 2, 0, peg_midpoint);
+  SimpleOrder bid2(true,  1251, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid3, false));
+
+  // The front pegs share an owner, so the newest is cancelled and the peg
+  // behind it crosses
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid3, 50, 1252 * 50);
+    SimpleFillCheck fc1(&ask0, 50, 1252 * 50);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+  ); }
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid0.state());
+  BOOST_REQUIRE_EQUAL(0, bid0.filled_qty());
+  BOOST_REQUIRE_EQUAL(impl::os_complete, bid3.state());
+  BOOST_REQUIRE_EQUAL(0, order_book.pegged_orders(true, peg_midpoint).size());
+  BOOST_REQUIRE_EQUAL(50, order_book.find_resting(&ask0)->open_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestPegCrossesMarketOrderAtPegPrice)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 0, 500); // AON
+  SimpleOrder bid0(true,  1250, 100);
+  SimpleOrder bid1(true,  0, 600, 0, 0, 0, 0, peg_primary);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false, false, 
+                               oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+
+  // The market order is priced by the peg, not at 0
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid1, 500, 1250 * 500);
+    SimpleFillCheck fc1(&ask0, 500, 1250 * 500);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid1, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(1250, order_book.last_trade_price());
+  const SimpleOrderBook::Tracker* pegged = order_book.find_resting(&bid1);
+  BOOST_REQUIRE(pegged);
+  BOOST_REQUIRE_EQUAL(100, pegged->open_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestPeggedDepth)
+{
+  SimpleOrderBook order_book;
+  order_book.set_pegged_depth(true);
+  SimpleOrder ask0(false, 1253, 100);
+  SimpleOrder bid0(true,  1250, 100);
+  SimpleOrder bid1(true,  0, 200, 0, 0, 0, 0, peg_primary);
+  SimpleOrder bid2(true,  0, 300, 0, 0, 0, 0, peg_primary);
+  SimpleOrder bid3(true,  1251, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 3, 600));
+
+  // The pegs move with the best bid
+  BOOST_REQUIRE(add_and_verify(order_book, &bid3, false));
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_bid(1251, 3, 600));
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+
+  // And follow it back
+  BOOST_REQUIRE(cancel_and_verify(order_book, &bid3, impl::os_cancelled));
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_bid(1250, 3, 600));
+
+  // Cancel and replace change the pegged quantity
+  BOOST_REQUIRE(cancel_and_verify(order_book, &bid1, impl::os_cancelled));
+  BOOST_REQUIRE(replace_and_verify(order_book, &bid2, -100));
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_bid(1250, 2, 300));
+  BOOST_REQUIRE_EQUAL(200, bid2.order_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestRejectPeggedWithPrice)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid0(true, 1250, 100, 0, 0, 0, 0, peg_primary);
+  SimpleOrder bid1(true, 0, 100, 0, 0, 0, 0, peg_midpoint);
+
+  BOOST_REQUIRE(!order_book.add(&bid0));
+  BOOST_REQUIRE(!order_book.add(&bid1, oc_all_or_none));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_new, bid0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_new, bid1.state());
+  BOOST_REQUIRE_EQUAL(0, order_book.pegged_orders(true, peg_primary).size());
+}
+
+BOOST_AUTO_TEST_CASE(TestCancelAndReplacePegs)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid0(true,  0, 100, 0, 0, 0, 0, peg_primary);
+  SimpleOrder bid1(true,  0, 200, 0, 0, 0, 0, peg_primary);
+  SimpleOrder bid2(true,  0, 300, 0, 0, 0, 0, peg_primary);
+  SimpleOrder bid3(true,  0, 400, 0, 0, 0, 0, peg_midpoint);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid3, false));
+
+  // Cancel from the middle of the queue, and replace at its back
+  BOOST_REQUIRE(cancel_and_verify(order_book, &bid1, impl::os_cancelled));
+  BOOST_REQUIRE(replace_and_verify(order_book, &bid2, -50));
+  BOOST_REQUIRE(!order_book.find_resting(&bid1));
+  BOOST_REQUIRE_EQUAL(100, order_book.find_resting(&bid0)->open_qty());
+  BOOST_REQUIRE_EQUAL(250, order_book.find_resting(&bid2)->open_qty());
+  BOOST_REQUIRE_EQUAL(400, order_book.find_resting(&bid3)->open_qty());
+  BOOST_REQUIRE_EQUAL(2, order_book.pegged_orders(true, peg_primary).size());
+
+  // A larger size sends a peg to the back of its queue
+  BOOST_REQUIRE(replace_and_verify(order_book, &bid0, 50));
+  BOOST_REQUIRE_EQUAL(&bid2, 
+      order_book.pegged_orders(true, peg_primary).front().ptr());
+  BOOST_REQUIRE_EQUAL(&bid0, 
+      order_book.pegged_orders(true, peg_primary).back().ptr());
+
+  // A copy of the book finds the pegs of its own queues
+  SimpleOrderBook copy(order_book);
+  BOOST_REQUIRE(cancel_and_verify(copy, &bid2, impl::os_cancelled));
+  BOOST_REQUIRE(!copy.find_resting(&bid2));
+  BOOST_REQUIRE_EQUAL(250, order_book.find_resting(&bid2)->open_qty());
+  BOOST_REQUIRE_EQUAL(1, copy.pegged_orders(true, peg_primary).size());
+  BOOST_REQUIRE_EQUAL(2, order_book.pegged_orders(true, peg_primary).size());
+}
+
+} // namespace
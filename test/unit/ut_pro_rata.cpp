@@ -0,0 +1,203 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_ProRata
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+
+namespace liquibook {
+
+using book::ProRataMatch;
+using impl::SimpleOrder;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+typedef impl::SimpleOrderBook<5, ProRataMatch> ProRataOrderBook;
+
+BOOST_AUTO_TEST_CASE(TestAllocateProportional)
+{
+  std::vector<Quantity> qtys;
+  std::vector<Quantity> allocations;
+  qtys.push_back(100);
+  qtys.push_back(300);
+  qtys.push_back(600);
+  ProRataMatch::allocate(500, qtys, 1000, allocations);
+  BOOST_REQUIRE_EQUAL(3, allocations.size());
+  BOOST_REQUIRE_EQUAL(50, allocations[0]);
+  BOOST_REQUIRE_EQUAL(150, allocations[1]);
+  BOOST_REQUIRE_EQUAL(300, allocations[2]);
+
+  // Whole level
+  ProRataMatch::allocate(1200, qtys, 1000, allocations);
+  BOOST_REQUIRE_EQUAL(100, allocations[0]);
+  BOOST_REQUIRE_EQUAL(300, allocations[1]);
+  BOOST_REQUIRE_EQUAL(600, allocations[2]);
+}
+
+BOOST_AUTO_TEST_CASE(TestAllocateRemainder)
+{
+  std::vector<Quantity> qtys;
+  std::vector<Quantity> allocations;
+  qtys.push_back(100);
+  qtys.push_back(300);
+  qtys.push_back(600);
+  // Shares of 0.7, 2.1 and 4.2 round down to 6, first in time gets the last
+  ProRataMatch::allocate(7, qtys, 1000, allocations);
+  BOOST_REQUIRE_EQUAL(1, allocations[0]);
+  BOOST_REQUIRE_EQUAL(2, allocations[1]);
+  BOOST_REQUIRE_EQUAL(4, allocations[2]);
+
+  qtys.assign(3, 1);
+  ProRataMatch::allocate(2, qtys, 3, allocations);
+  BOOST_REQUIRE_EQUAL(1, allocations[0]);
+  BOOST_REQUIRE_EQUAL(1, allocations[1]);
+  BOOST_REQUIRE_EQUAL(0, allocations[2]);
+}
+
+BOOST_AUTO_TEST_CASE(TestProRataLevel)
+{
+  ProRataOrderBook order_book;
+  SimpleOrder ask2(false, 1250, 600);
+  SimpleOrder ask1(false, 1250, 300);
+  SimpleOrder ask0(false, 1250, 100);
+  SimpleOrder bid0(true,  1250, 500);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+
+  // Match - split in proportion to size, not time
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 500, 1250 * 500);
+    SimpleFillCheck fc1(&ask0, 50, 1250 * 50);
+    SimpleFillCheck fc2(&ask1, 150, 1250 * 150);
+    SimpleFillCheck fc3(&ask2, 300, 1250 * 300);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_ask(1250, 3, 500));
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestProRataSweep)
+{
+  ProRataOrderBook order_book;
+  SimpleOrder ask3(false, 1251, 200);
+  SimpleOrder ask2(false, 1251, 200);
+  SimpleOrder ask1(false, 1250, 100);
+  SimpleOrder ask0(false, 1250, 100);
+  SimpleOrder bid0(true,  1251, 300);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask3, false));
+
+  // Match - the best level is taken whole, the next is prorated
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 300, 1250 * 200 + 1251 * 100);
+    SimpleFillCheck fc1(&ask0, 100, 1250 * 100);
+    SimpleFillCheck fc2(&ask1, 100, 1250 * 100);
+    SimpleFillCheck fc3(&ask2, 50, 1251 * 50);
+    SimpleFillCheck fc4(&ask3, 50, 1251 * 50);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_ask(1251, 2, 300));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestProRataAllOrNoneLast)
+{
+  ProRataOrderBook order_book;
+  SimpleOrder ask1(false, 1250, 100);
+  SimpleOrder ask0(false, 1250, 100); // AON
+  SimpleOrder bid0(true,  1250, 200);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false, false,
+                               oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Match - the AON order takes what is left after allocation
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 200, 1250 * 200);
+    SimpleFillCheck fc1(&ask0, 100, 1250 * 100);
+    SimpleFillCheck fc2(&ask1, 100, 1250 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestProRataIceberg)
+{
+  ProRataOrderBook order_book;
+  SimpleOrder ask1(false, 1250, 100);
+  SimpleOrder ask0(false, 1250, 400, 0, 100); // Iceberg
+  SimpleOrder bid0(true,  1250, 300);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Match - the level is taken whole, then the refreshed slice
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 300, 1250 * 300);
+    SimpleFillCheck fc1(&ask0, 200, 1250 * 200);
+    SimpleFillCheck fc2(&ask1, 100, 1250 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 100));
+  BOOST_REQUIRE_EQUAL(200, ask0.open_qty());
+}
+
+BOOST_AUTO_TEST_CASE(TestProRataAllOrNoneInbound)
+{
+  ProRataOrderBook order_book;
+  SimpleOrder ask1(false, 1250, 60);
+  SimpleOrder ask0(false, 1250, 50); // AON
+  SimpleOrder bid0(true,  1250, 100); // AON
+  SimpleOrder bid1(true,  1250, 100); // AON
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false, false,
+                               oc_all_or_none));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Match - an AON inbound order fills in time priority, so takes the AON
+  // order first
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&ask0, 50, 1250 * 50);
+    SimpleFillCheck fc2(&ask1, 50, 1250 * 50);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true, 
+                                 oc_all_or_none));
+  ); }
+
+  // No match - the AON order is too large for what is left after the
+  // order ahead of it
+  SimpleOrder ask2(false, 1250, 80); // AON
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false, false,
+                               oc_all_or_none));
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid1, 0, 0);
+    SimpleFillCheck fc1(&ask1, 0, 0);
+    SimpleFillCheck fc2(&ask2, 0, 0);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid1, false, false, 
+                                 oc_all_or_none));
+  ); }
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1250, 2, 90));
+}
+
+} // namespace
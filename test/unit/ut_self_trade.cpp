@@ -0,0 +1,157 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_SelfTrade
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+
+namespace liquibook {
+
+using impl::SimpleOrder;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+
+BOOST_AUTO_TEST_CASE(TestNoOwnerMatches)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1250, 100);
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&ask0, 100, 1250 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+}
+
+BOOST_AUTO_TEST_CASE(TestCancelNewest)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1250, 100, 0, 0, 1);
+  SimpleOrder ask0(false, 1250, 100, 0, 0, 2);
+  SimpleOrder bid0(true,  1250, 150, 0, 0, 1);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Match ask0, then cancel the rest of bid0 rather than match ask1
+  BOOST_REQUIRE(order_book.add(&bid0));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid0.state());
+  BOOST_REQUIRE_EQUAL(100, bid0.filled_qty());
+  BOOST_REQUIRE_EQUAL(impl::os_complete, ask0.state());
+  BOOST_REQUIRE_EQUAL(0, ask1.filled_qty());
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 100));
+}
+
+BOOST_AUTO_TEST_CASE(TestCancelOldest)
+{
+  SimpleOrderBook order_book;
+  order_book.set_self_trade_prevention(stp_cancel_oldest);
+  SimpleOrder ask1(false, 1250, 100, 0, 0, 2);
+  SimpleOrder ask0(false, 1250, 100, 0, 0, 1);
+  SimpleOrder bid0(true,  1250, 100, 0, 0, 1);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Cancel ask0, and match ask1
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&ask1, 100, 1250 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask0.state());
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestDecrementBoth)
+{
+  SimpleOrderBook order_book;
+  order_book.set_self_trade_prevention(stp_decrement_both);
+  SimpleOrder ask1(false, 1250, 100, 0, 0, 2);
+  SimpleOrder ask0(false, 1250, 100, 0, 0, 1);
+  SimpleOrder bid0(true,  1250, 150, 0, 0, 1);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+
+  // Decrement bid0 and ask0 by 100, then match 50 with ask1
+  BOOST_REQUIRE(order_book.add(&bid0));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask0.state());
+  BOOST_REQUIRE_EQUAL(0, ask0.filled_qty());
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid0.state());
+  BOOST_REQUIRE_EQUAL(50, bid0.filled_qty());
+  BOOST_REQUIRE_EQUAL(50, ask1.filled_qty());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 50));
+}
+
+BOOST_AUTO_TEST_CASE(TestDecrementResting)
+{
+  SimpleOrderBook order_book;
+  order_book.set_self_trade_prevention(stp_decrement_both);
+  SimpleOrder ask0(false, 1250, 100, 0, 0, 1);
+  SimpleOrder bid0(true,  1250, 60, 0, 0, 1);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  // Inbound is cancelled, resting is reduced
+  BOOST_REQUIRE(!order_book.add(&bid0));
+  order_book.perform_callbacks();
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, bid0.state());
+  BOOST_REQUIRE_EQUAL(impl::os_accepted, ask0.state());
+  BOOST_REQUIRE_EQUAL(40, ask0.order_qty());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(1250, 1, 40));
+}
+
+BOOST_AUTO_TEST_CASE(TestDecrementInbound)
+{
+  SimpleOrderBook order_book;
+  order_book.set_self_trade_prevention(stp_decrement_both);
+  SimpleOrder ask0(false, 1250, 50, 0, 0, 1);
+  SimpleOrder bid0(true,  1250, 100, 0, 0, 1);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  // Resting is cancelled, inbound is reduced and rests
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE_EQUAL(impl::os_cancelled, ask0.state());
+  BOOST_REQUIRE_EQUAL(50, bid0.order_qty());
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 50));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+} // namespace
@@ -0,0 +1,200 @@
+// Copyright (c) 2012, 2013 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE liquibook_StopOrder
+#include <boost/test/unit_test.hpp>
+#include "ut_utils.h"
+
+namespace liquibook {
+
+using impl::SimpleOrder;
+typedef FillCheck<SimpleOrder*> SimpleFillCheck;
+
+BOOST_AUTO_TEST_CASE(TestStopBidTriggered)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1253, 100);
+  SimpleOrder ask0(false, 1252, 100);
+  SimpleOrder bid1(true,  1253, 100, 1252); // Stop limit
+  SimpleOrder bid0(true,  1252, 100);
+
+  // No match
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(2, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.stop_bids().size());
+
+  // Verify depth - stop is not in the book
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+  BOOST_REQUIRE(dc.verify_ask(1253, 1, 100));
+
+  // Match - trade at 1252 triggers the stop, which matches at 1253
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1252 * 100);
+    SimpleFillCheck fc1(&ask0, 100, 1252 * 100);
+    SimpleFillCheck fc2(&bid1, 100, 1253 * 100);
+    SimpleFillCheck fc3(&ask1, 100, 1253 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(1253, order_book.last_trade_price());
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.stop_bids().size());
+
+  // Verify depth
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestStopAskNotTriggeredBeforeTrade)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100, 1250); // Stop limit
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.stop_asks().size());
+}
+
+BOOST_AUTO_TEST_CASE(TestStopAskCascade)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask2(false,    0, 100, 1249); // Stop
+  SimpleOrder ask1(false,    0, 100, 1250); // Stop
+  SimpleOrder ask0(false, 1250, 100);
+  SimpleOrder bid2(true,  1248, 100);
+  SimpleOrder bid1(true,  1249, 100);
+  SimpleOrder bid0(true,  1250, 100);
+
+  // No match
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid2, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask2, false));
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(3, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(2, order_book.stop_asks().size());
+
+  // Match - each trade triggers the next stop
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&ask0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc2(&ask1, 100, 1249 * 100);
+    SimpleFillCheck fc3(&bid1, 100, 1249 * 100);
+    SimpleFillCheck fc4(&ask2, 100, 1248 * 100);
+    SimpleFillCheck fc5(&bid2, 100, 1248 * 100);
+    BOOST_REQUIRE(add_and_verify(order_book, &ask0, true, true));
+  ); }
+  BOOST_REQUIRE_EQUAL(1248, order_book.last_trade_price());
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(0, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.stop_asks().size());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestStopTriggeredOnArrival)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder ask0(false, 1250, 100);
+  SimpleOrder bid1(true,  1251, 200, 1249); // Stop limit
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+
+  // Last trade is above the stop, stop enters the book
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+
+  // Verify sizes
+  BOOST_REQUIRE_EQUAL(1, order_book.bids().size());
+  BOOST_REQUIRE_EQUAL(1, order_book.asks().size());
+  BOOST_REQUIRE_EQUAL(0, order_book.stop_bids().size());
+
+  // Verify depth
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1251, 1, 200));
+  BOOST_REQUIRE(dc.verify_ask(1252, 1, 100));
+}
+
+BOOST_AUTO_TEST_CASE(TestCancelStop)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1250, 100);
+  SimpleOrder bid1(true,  1250, 100, 1251); // Stop limit
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &bid0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+  BOOST_REQUIRE_EQUAL(1, order_book.stop_bids().size());
+
+  // Cancel the stop
+  BOOST_REQUIRE(cancel_and_verify(order_book, &bid1, impl::os_cancelled));
+  BOOST_REQUIRE_EQUAL(0, order_book.stop_bids().size());
+  BOOST_REQUIRE(cancel_and_verify(order_book, &bid1, impl::os_cancelled));
+
+  // Verify depth is unaffected
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(1250, 1, 100));
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+}
+
+BOOST_AUTO_TEST_CASE(TestReplaceStop)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask1(false, 1251, 300);
+  SimpleOrder ask0(false, 1250, 100);
+  SimpleOrder bid1(true,  1251, 100, 1250); // Stop limit
+  SimpleOrder bid0(true,  1250, 100);
+
+  BOOST_REQUIRE(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &ask1, false));
+  BOOST_REQUIRE(add_and_verify(order_book, &bid1, false));
+
+  // Increase the stop, which is still not in the book
+  BOOST_REQUIRE(replace_and_verify(order_book, &bid1, 100));
+  BOOST_REQUIRE_EQUAL(1, order_book.stop_bids().size());
+  DepthCheck dc(order_book.depth());
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+
+  // Trigger the stop
+  { BOOST_REQUIRE_NO_THROW(
+    SimpleFillCheck fc0(&bid0, 100, 1250 * 100);
+    SimpleFillCheck fc1(&ask0, 100, 1250 * 100);
+    SimpleFillCheck fc2(&bid1, 200, 1251 * 200);
+    SimpleFillCheck fc3(&ask1, 200, 1251 * 200);
+    BOOST_REQUIRE(add_and_verify(order_book, &bid0, true, true));
+  ); }
+
+  // Verify depth
+  dc.reset();
+  BOOST_REQUIRE(dc.verify_bid(0, 0, 0));
+  BOOST_REQUIRE(dc.verify_ask(1251, 1, 100));
+}
+
+} // namespace